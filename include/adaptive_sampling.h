@@ -0,0 +1,57 @@
+// include/adaptive_sampling.h
+#ifndef ADAPTIVE_SAMPLING_H
+#define ADAPTIVE_SAMPLING_H
+
+#include <Arduino.h>
+#include "sensor_history.h"
+
+// ============================
+// Muestreo adaptativo por canal
+// ============================
+// Cada canal tiene un intervalo entre minIntervalMs y maxIntervalMs (config.h).
+// Si la velocidad de cambio o la desviación respecto a la media superan su
+// umbral, el canal pasa a "activo" y se muestrea al intervalo mínimo; mientras
+// la señal esté plana el intervalo se duplica hasta el máximo.
+// La velocidad sale de la media suavizada al cerrar cada ventana de
+// rateWindowMs (no de dos lecturas seguidas, que con el intervalo mínimo
+// convertirían el ruido del ADC en actividad y el canal no volvería a bajar).
+// Todo en enteros, en las unidades del canal (sensor_history.h).
+
+struct SamplingBounds {
+    uint32_t minIntervalMs;
+    uint32_t maxIntervalMs;
+    uint32_t rateWindowMs;         // Ventana de la velocidad de cambio
+    uint16_t rateThreshold;        // Unidades por segundo
+    uint16_t deviationThreshold;   // Desviación media absoluta (unidades)
+};
+
+struct ChannelSample {
+    int16_t value;                 // Unidades del canal
+    uint16_t raw;                  // Cuentas ADC
+    uint32_t timestampMs;          // 0 = aún sin muestras
+    uint32_t intervalMs;           // Intervalo de muestreo actual
+    uint16_t rate;                 // Unidades por segundo (última ventana cerrada)
+    uint16_t deviation;
+    bool active;
+    uint32_t samples;
+};
+
+// Carga los límites de config.h (llamar en setup antes de crear las tareas)
+void adaptive_sampling_init();
+
+// ¿Toca muestrear el canal?
+bool adaptive_sampling_due(SensorChannel channel, uint32_t nowMs);
+
+// Incorpora una muestra y recalcula el intervalo. Devuelve el nuevo intervalo.
+uint32_t adaptive_sampling_update(SensorChannel channel, uint32_t nowMs, int16_t value, uint16_t raw);
+
+// ms hasta que algún canal necesite muestra
+uint32_t adaptive_sampling_next_due_in(uint32_t nowMs);
+
+// Última muestra y estado del canal
+ChannelSample adaptive_sampling_get(SensorChannel channel);
+
+// Tarea a despertar (notificación) cuando el canal pasa a activo
+void adaptive_sampling_set_reporter(SensorChannel channel, TaskHandle_t task);
+
+#endif // ADAPTIVE_SAMPLING_H
@@ -0,0 +1,32 @@
+// include/alloc_guard.h
+#ifndef ALLOC_GUARD_H
+#define ALLOC_GUARD_H
+
+#include <Arduino.h>
+
+// ============================
+// Vigilancia de reservas de heap tras el arranque
+// ============================
+// Con STATIC_ALLOCATION_MODE = 1 y el enlazador envolviendo malloc/calloc/realloc
+// (-Wl,--wrap=..., ver env:esp32dev_static en platformio.ini) se cuentan las
+// reservas que hacen las tareas de la aplicación (las del plan de tareas)
+// después de alloc_guard_arm(). No se cuentan las que reservan por diseño: la
+// pila WiFi/LwIP, el bucle de Arduino (que escribe en el socket) y las tareas
+// con heapAllowed en la tabla de task_plan.cpp (NVS, SPIFFS, mbedTLS, WiFi).
+// Las tareas vigiladas escriben trazas con serial_printf (sin heap).
+// Sin el modo estático todas las funciones son vacías y los contadores valen 0.
+
+struct AllocGuardStats {
+    bool armed;
+    uint32_t allocations;      // Reservas desde alloc_guard_arm()
+    uint32_t bytes;            // Bytes pedidos en esas reservas
+    char firstTask[16];        // Tarea de la primera reserva detectada
+    uint32_t firstSize;
+};
+
+// Empieza a vigilar (al final de setup())
+void alloc_guard_arm();
+
+AllocGuardStats alloc_guard_get_stats();
+
+#endif // ALLOC_GUARD_H
@@ -0,0 +1,46 @@
+// include/audit_log.h
+#ifndef AUDIT_LOG_H
+#define AUDIT_LOG_H
+
+#include <Arduino.h>
+
+// ============================
+// Registro de actuaciones en flash (solo anexar)
+// ============================
+// Cada cambio de un relé deja un registro fijo de 16 bytes: hora, origen,
+// destino y nuevo estado. Los registros se acumulan en RAM y una tarea de baja
+// prioridad los escribe por lotes en segmentos de SPIFFS; al llenarse el último
+// segmento se abre otro y se borra el más antiguo.
+// La hora es monótona en todo el registro (nunca retrocede), así que una
+// consulta por rango localiza el primer registro con búsqueda binaria dentro
+// del segmento en lugar de recorrerlo entero.
+
+// Quién pidió el cambio
+enum ActuationSource : uint8_t {
+    ACTUATION_MQTT = 0,     // Comando recibido (JSON, binario o transacción)
+    ACTUATION_AUTOMATION,   // Automatización por temperatura / LDR
+    ACTUATION_SCENE,        // Escenario predefinido
+    ACTUATION_BOOT,         // Estado restaurado al arrancar
+    ACTUATION_SOURCE_COUNT
+};
+
+// Destino: zonas 1-4 y ventilador
+#define AUDIT_TARGET_FAN        5
+#define AUDIT_TARGET_FAN_AUTO   6   // Modo automático del ventilador
+
+// Nombre del origen en JSON ("mqtt", "automation", "scene", "boot")
+const char* actuation_source_name(ActuationSource source);
+
+// Monta el sistema de ficheros, reconstruye el índice de segmentos y arranca
+// la tarea de escritura. Los registros anotados antes se conservan en RAM.
+void audit_log_start();
+
+// Anota un cambio (O(1), sin tocar la flash; seguro desde cualquier tarea)
+void audit_log_record(ActuationSource source, uint8_t target, bool state);
+
+// Maneja una consulta recibida en system/audit/get y responde por trozos en
+// system/audit/data. La lectura la hace la tarea del registro, no la de red.
+// Payload: {"id": "q1", "from": 1718000000, "to": 1718003600, "limit": 200}
+void handle_audit_query(const uint8_t* payload, unsigned int length);
+
+#endif // AUDIT_LOG_H
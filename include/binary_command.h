@@ -0,0 +1,67 @@
+// include/binary_command.h
+#ifndef BINARY_COMMAND_H
+#define BINARY_COMMAND_H
+
+#include <Arduino.h>
+
+// ============================
+// Protocolo binario de comandos (alternativa compacta al JSON)
+// ============================
+// Trama fija de 8 bytes, enteros en little-endian:
+//   [0]    magic      0xA5
+//   [1]    opcode     BinaryOpcode
+//   [2]    zone mask  bit i = zona i+1 (solo bits 0-3)
+//   [3]    fan        BinaryFanSetpoint
+//   [4..7] seq        número de secuencia (uint32)
+// La respuesta en bin/state usa el mismo formato con opcode BIN_OP_STATE,
+// la máscara y el ventilador actuales y el seq del comando confirmado. Si un
+// urgente posterior anuló la trama (o sus zonas), el opcode es BIN_OP_PREEMPTED:
+// lo que no se anuló (el ventilador) sí se aplicó y el estado es el actual.
+
+#define BINARY_COMMAND_SIZE   8
+#define BINARY_COMMAND_MAGIC  0xA5
+
+enum BinaryOpcode : uint8_t {
+    BIN_OP_SET_MASK   = 0x01,   // Las zonas quedan exactamente como la máscara
+    BIN_OP_ZONES_ON   = 0x02,   // Enciende las zonas de la máscara
+    BIN_OP_ZONES_OFF  = 0x03,   // Apaga las zonas de la máscara
+    BIN_OP_ZONES_TOGGLE = 0x04, // Invierte las zonas de la máscara
+    BIN_OP_FAN_ONLY   = 0x05,   // Ignora la máscara, solo aplica el ventilador
+    BIN_OP_STATE      = 0x80,   // Solo en respuestas
+    BIN_OP_PREEMPTED  = 0x81    // Respuesta: anulada (entera o en parte) por un urgente
+};
+
+enum BinaryFanSetpoint : uint8_t {
+    BIN_FAN_OFF       = 0x00,
+    BIN_FAN_ON        = 0x01,
+    BIN_FAN_TOGGLE    = 0x02,
+    BIN_FAN_UNCHANGED = 0xFF
+};
+
+enum BinaryParseResult : uint8_t {
+    BIN_PARSE_OK = 0,
+    BIN_PARSE_BAD_LENGTH,
+    BIN_PARSE_BAD_MAGIC,
+    BIN_PARSE_BAD_OPCODE,
+    BIN_PARSE_BAD_MASK,
+    BIN_PARSE_BAD_FAN
+};
+
+struct BinaryCommand {
+    uint8_t opcode;
+    uint8_t zoneMask;
+    uint8_t fan;
+    uint32_t seq;
+};
+
+// Valida y decodifica una trama (sin reservas de memoria)
+BinaryParseResult binary_command_parse(const uint8_t* buffer, size_t length, BinaryCommand &out);
+
+// Codifica una trama en buffer (BINARY_COMMAND_SIZE bytes)
+void binary_command_encode(const BinaryCommand &command, uint8_t* buffer);
+
+// Maneja un mensaje recibido en el topic binario: valida, aplica y confirma.
+// preempted (PREEMPT_LIGHTS / PREEMPT_FAN) = partes que ya no se aplican.
+void handle_binary_command(const uint8_t* payload, unsigned int length, uint8_t preempted = 0);
+
+#endif // BINARY_COMMAND_H
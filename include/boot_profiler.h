@@ -0,0 +1,30 @@
+// include/boot_profiler.h
+#ifndef BOOT_PROFILER_H
+#define BOOT_PROFILER_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+// Fases de arranque medidas (tiempo desde el reset)
+enum BootPhase {
+    BOOT_PHASE_GPIO_SAFE = 0,   // Relés en estado seguro
+    BOOT_PHASE_SETUP_DONE,      // setup() terminado, tareas creadas
+    BOOT_PHASE_WIFI_UP,         // IP obtenida
+    BOOT_PHASE_MQTT_UP,         // Conectado al broker
+    BOOT_PHASE_COMMAND_READY,   // Suscripciones hechas: el dispositivo acepta comandos
+    BOOT_PHASE_COUNT
+};
+
+// Inicializa el perfilador (llamar al principio de setup)
+void boot_profiler_init();
+
+// Registra el instante de una fase (solo cuenta la primera vez)
+void boot_profiler_mark(BootPhase phase);
+
+// Devuelve el tiempo de la fase en ms desde el reset (0 = aún no alcanzada)
+uint32_t boot_profiler_get_ms(BootPhase phase);
+
+// Rellena el informe de arranque (StaticJsonDocument<384>)
+void generate_boot_json(JsonDocument &doc);
+
+#endif // BOOT_PROFILER_H
@@ -0,0 +1,48 @@
+// include/broker_pool.h
+#ifndef BROKER_POOL_H
+#define BROKER_POOL_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+// ============================
+// Lista de brokers MQTT con conmutación por fallo
+// ============================
+// MQTT_BROKER_LIST (config.h) fija el orden de preferencia; el primero es el
+// principal. Tras MQTT_BROKER_FAIL_THRESHOLD fallos seguidos (conexión
+// rechazada o keepalive vencido) el broker queda en espera
+// MQTT_BROKER_COOLDOWN_MS y se pasa al siguiente sin esperar. Conectado a un
+// secundario, se sondea el principal cada MQTT_PRIMARY_PROBE_INTERVAL y se
+// vuelve a él en cuanto acepta conexiones.
+// Solo se usa desde la tarea de bombeo MQTT.
+
+struct BrokerEndpoint {
+    const char* host;
+    uint16_t port;
+    const char* tlsName;   // Nombre a verificar en su certificado (NULL = host)
+};
+
+// Broker al que hay que conectar ahora
+const BrokerEndpoint &broker_pool_active();
+uint8_t broker_pool_active_index();
+
+// Resultado de un intento de conexión. Devuelve true si se cambió de broker
+// (conviene reintentar ya, sin esperar al intervalo de reconexión).
+bool broker_pool_connect_failed(uint32_t nowMs);
+void broker_pool_connected(uint32_t nowMs);
+
+// La conexión establecida se perdió (keepalive, socket cerrado...)
+void broker_pool_connection_lost(uint32_t nowMs);
+
+// Conectado a un secundario: ¿toca volver al principal? Hace un sondeo TCP
+// corto al principal cuando vence el intervalo. Si devuelve true, el
+// principal pasa a ser el activo y hay que desconectar y reconectar.
+bool broker_pool_should_return_to_primary(uint32_t nowMs);
+
+// Tiempo de la última conmutación (pérdida -> conectado de nuevo), 0 = ninguna
+uint32_t broker_pool_last_failover_ms();
+
+// Estado de salud de todos los brokers (para status/broker)
+void broker_pool_fill_status(JsonDocument &doc);
+
+#endif // BROKER_POOL_H
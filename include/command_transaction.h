@@ -0,0 +1,21 @@
+// include/command_transaction.h
+#ifndef COMMAND_TRANSACTION_H
+#define COMMAND_TRANSACTION_H
+
+#include <Arduino.h>
+
+// ============================
+// Transacciones de comandos (varias zonas + ventilador en un solo mensaje)
+// ============================
+// Payload JSON en auditorium/transaction/set:
+//   {"id": "abc-1", "zones": {"1": "ON", "3": "TOGGLE"}, "fan": "OFF", "fan_auto": false}
+// Se valida todo antes de tocar ningún relé; si algo es inválido no se aplica
+// nada (también un "id" de más de 48 caracteres o un "fan_auto" no booleano). La confirmación es un único mensaje en auditorium/transaction/state
+// con el "id" recibido y el estado resultante.
+// preempted (PREEMPT_LIGHTS / PREEMPT_FAN): partes anuladas por un urgente
+// posterior. Si no queda nada, la confirmación es "ok": false, "error":
+// "preempted"; si queda algo, se aplica y "preempted" dice qué no ("zones" o "fan").
+
+void handle_transaction_message(const uint8_t* payload, unsigned int length, uint8_t preempted = 0);
+
+#endif // COMMAND_TRANSACTION_H
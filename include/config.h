@@ -9,14 +9,76 @@
 
 // Tiempo de actualización de datos en ms (WiFi, Memoria)
 #define WIFI_INFO_INTERVAL         8000  // ms
+#define MEMORY_REPORT_INTERVAL     60000 // ms - el estado al momento se pide en system/memory/get
+
+// Muestreo de RSSI y criterio de republicación del estado WiFi
+#define WIFI_RSSI_SAMPLE_INTERVAL  2000  // ms
+#define WIFI_RSSI_SMOOTHING        4     // Media exponencial: alfa = 1/4
+#define WIFI_RSSI_DEADBAND_DB      5     // Republicar solo si el RSSI se mueve más de esto
+
+// Reconexión automática con backoff exponencial
+#define WIFI_RECONNECT_MIN_DELAY    500    // ms - primer reintento tras una caída
+#define WIFI_RECONNECT_MAX_DELAY    30000  // ms - techo del backoff
+
+// Reasociación rápida: se guardan BSSID/canal en NVS para saltar el escaneo
+// Tras este número de fallos seguidos con los datos cacheados se vuelve al escaneo completo
+#define WIFI_FAST_CONNECT_MAX_FAILS 2
+
+// Reutilizar la última IP obtenida por DHCP como IP estática (salta DHCP).
+// Solo con una reserva DHCP para la MAC del dispositivo: sin ella el router
+// puede haber dado esa IP a otro equipo y habría dos con la misma dirección.
+#ifndef WIFI_CACHE_IP_ENABLED
+#define WIFI_CACHE_IP_ENABLED       0
+#endif
 
 // ============================
 //MQTT Configuration
 // ============================
 #define MQTT_BROKER       "172.20.10.2"   // Dirección del broker MQTT
+
+// TLS con mbedTLS y reanudación de sesión (CA en tls_ca_cert.h, ver env:esp32dev_tls)
+#ifndef MQTT_USE_TLS
+#define MQTT_USE_TLS      0
+#endif
+
+#if MQTT_USE_TLS
+#define MQTT_PORT         8883             // MQTT sobre TLS
+#else
 #define MQTT_PORT         1883             // Puerto para MQTT (no WebSockets)
+#endif
 #define MQTT_CLIENT_ID    "esp32_device_01"
 
+// Solo laboratorio: con TLS y sin CA en tls_ca_cert.h, conectar sin verificar
+// el broker. Con 0 (por defecto) no se conecta hasta que haya una CA.
+#ifndef MQTT_TLS_INSECURE
+#define MQTT_TLS_INSECURE 0
+#endif
+
+// Espera entre intentos de conexión al broker (con WiFi activo)
+#define MQTT_RECONNECT_INTERVAL   5000    // ms
+
+// Nombre del certificado del broker con TLS (SNI y comprobación del nombre).
+// NULL = el propio host. Con el broker por IP, mbedTLS 2.x (el del core de
+// Arduino) solo compara el CN y los SAN de tipo DNS, nunca los SAN de IP: o se
+// pone aquí el nombre DNS del certificado, o el certificado lleva la IP como
+// CN o como SAN DNS.
+#define MQTT_TLS_SERVER_NAME  NULL
+
+// Brokers en orden de preferencia: { host, puerto, nombre TLS }. El primero es el principal.
+#define MQTT_BROKER_LIST  { { MQTT_BROKER, MQTT_PORT, MQTT_TLS_SERVER_NAME }, \
+                            { "172.20.10.3", MQTT_PORT, MQTT_TLS_SERVER_NAME } }
+#define MQTT_BROKER_FAIL_THRESHOLD    2       // Fallos seguidos antes de cambiar de broker
+#define MQTT_BROKER_COOLDOWN_MS       30000   // ms que un broker caído queda descartado
+#define MQTT_PRIMARY_PROBE_INTERVAL   30000   // ms entre sondeos del principal desde un secundario
+#define MQTT_PRIMARY_PROBE_TIMEOUT_MS 300     // ms - sondeo TCP (bloquea el bombeo MQTT)
+
+// Detección de caída: PubSubClient da la sesión por perdida a 1,5 x keepalive
+#define MQTT_KEEPALIVE_S          5
+#define MQTT_SOCKET_TIMEOUT_S     3       // Espera del CONNACK
+
+#define MQTT_TLS_HANDSHAKE_TIMEOUT_MS  8000   // ms - handshake completo (RSA/ECDHE) en el peor caso
+#define TLS_SESSION_CACHE_BYTES        2048   // Sesión serializada en RTC (incluye el certificado del broker)
+
 // Intervalo de latido (heartbeat) en ms
 #define MQTT_HEARTBEAT_INTERVAL   2500    // ms
 
@@ -24,33 +86,88 @@
 //MQTT Topics
 // ============================
 
-// Información del estado de conexión WiFi
-#define MQTT_TOPIC_WIFI       "esp32/wifi/status"
+// Prefijo común de todos los topics (ver topics.h para el registro completo)
+#ifndef DEVICE_TOPIC_PREFIX
+#define DEVICE_TOPIC_PREFIX   "esp32"
+#endif
 
-// Información de uso de memoria (RAM, Flash, Uptime)
-#define MQTT_TOPIC_MEMORY     "esp32/system/memory"
+// Consultas .../get: longitud máxima del topic de respuesta y del id de correlación
+#define STATE_REPLY_TOPIC_MAX     128
+#define STATE_QUERY_ID_MAX        32
 
-// Estado de conexión al broker (heartbeat)
-#define MQTT_TOPIC_HEARTBEAT  "esp32/status/heartbeat"
-
-//MQTT temperatura
-#define MQTT_TOPIC_TEMPERATURE "esp32/sensors/temperature"
+// Documento de estado consolidado (state/document completo + state/delta)
+#ifndef DEVICE_STATE_LEGACY_TOPICS
+#define DEVICE_STATE_LEGACY_TOPICS  1      // 0 = solo el documento (sin wifi/status, system/memory, heartbeat, sensores, luces y ventilador por topic)
+#endif
+// Binario y transacciones se confirman con un único mensaje (bin/state,
+// transaction/state); el nuevo estado llega por el documento. 1 = además
+// publicar las zonas y el ventilador en sus topics (con DEVICE_STATE_LEGACY_TOPICS)
+#ifndef COMMAND_ACK_MIRROR_TOPICS
+#define COMMAND_ACK_MIRROR_TOPICS   0
+#endif
+#define DEVICE_STATE_BATCH_MS       1000   // ms - la telemetría se agrupa en un delta como mucho este tiempo
+#define DEVICE_STATE_HEAP_DEADBAND  2048   // bytes
+#define DEVICE_STATE_TEMP_DEADBAND  100    // milésimas de °C
+#define DEVICE_STATE_LDR_DEADBAND   32     // cuentas ADC
+#define DEVICE_STATE_LUX_DEADBAND   5      // lux
 
 // ============================
 // 🌡️ Sensor de Temperatura (ADC)
 // ============================
 #define TEMP_SENSOR_PIN           34
-#define TEMP_REPORT_INTERVAL      5000      // ms
+#define TEMP_REPORT_INTERVAL      5000      // ms - publicación con el canal activo
+#define TEMP_REPORT_IDLE_INTERVAL 30000     // ms - publicación con la señal plana
 #define ADC_RESOLUTION_BITS       12
-#define ADC_REF_VOLTAGE           3.3
 #define ADC_MAX_VALUE             4095      // para 12 bits
+#define ADC_DEFAULT_VREF_MV       1100      // Si el eFuse no trae Vref ni Two Point
+#define TEMP_SENSOR_MV_PER_C      10        // LM35: 10 mV/°C
 
 // ============================
 // 🌙 Sensor LDR (luminosidad)
 // ============================
 #define LDR_SENSOR_PIN         35      // Pin ADC donde conectas el LDR
 #define LDR_REPORT_INTERVAL    5000    // ms (igual que temperatura)
-#define MQTT_TOPIC_LDR         "esp32/sensors/ldr"
+#define LDR_REPORT_IDLE_INTERVAL  30000 // ms - publicación con la señal plana
+
+// Curva del LDR (divisor: resistencia fija a 3V3, LDR a GND)
+#define LDR_SUPPLY_MV             3300
+#define LDR_FIXED_RESISTOR_OHMS   10000
+#define LDR_R10_OHMS              50000   // Resistencia a 10 lux (hoja de datos del LDR)
+#define LDR_GAMMA_X100            70      // Pendiente log-log de la curva (γ = 0,70)
+#define LDR_LUX_MAX               100000
+
+// Tablas de conversión: 2^bits cuentas por tramo (5 -> 128 tramos, 129 nodos por canal)
+#define SENSOR_LUT_SEGMENT_BITS   5
+
+// ============================
+// 📶 Muestreo adaptativo (por canal)
+// ============================
+// Intervalo mínimo con el canal activo, máximo con la señal plana, y umbrales
+// de actividad en unidades del canal (centésimas de °C / cuentas ADC).
+// La velocidad se mide sobre la media suavizada a lo largo de una ventana fija,
+// no entre dos lecturas: el ruido del ADC (±8 cuentas en una lectura suelta,
+// ±6 mV ≈ ±60 centésimas de °C con el LM35) no debe bastar para activar.
+#define TEMP_SAMPLE_MIN_MS        1000
+#define TEMP_SAMPLE_MAX_MS        10000
+#define TEMP_ACTIVITY_WINDOW_MS   10000
+#define TEMP_ACTIVITY_RATE        10      // centésimas de °C por segundo (1 °C en la ventana)
+#define TEMP_ACTIVITY_DEVIATION   60      // centésimas de °C (el ruido queda en ~30)
+
+#define LDR_SAMPLE_MIN_MS         100     // Capta puertas abiertas / luces encendidas
+#define LDR_SAMPLE_MAX_MS         5000
+#define LDR_ACTIVITY_WINDOW_MS    1000
+#define LDR_ACTIVITY_RATE         150     // cuentas ADC por segundo
+#define LDR_ACTIVITY_DEVIATION    60      // cuentas ADC (el ruido queda en ~4)
+
+#define SENSOR_MONITOR_MAX_SLEEP  1000    // ms - check-in del supervisor aunque no toque muestrear
+
+// ============================
+// 📈 Histórico de sensores (RAM)
+// ============================
+#define HISTORY_RAW_SAMPLES       300   // ~5 min a 1 muestra/s (menos con el canal activo)
+#define HISTORY_1MIN_BUCKETS      120   // 2 h de agregados de 1 min
+#define HISTORY_15MIN_BUCKETS     96    // 24 h de agregados de 15 min
+#define HISTORY_CHUNK_MAX_BYTES   900   // Cabe en el buffer de 1024 de PubSubClient con el topic
 
 // ============================
 // 💡 Control de Luces (Relés)
@@ -60,11 +177,129 @@
 #define LIGHT_ZONE_3_PIN    21  // Pasillo Derecho - B
 #define LIGHT_ZONE_4_PIN    19  // Pasillo Izquierdo
 
+// ============================
+// 💾 Persistencia del estado de relés (NVS)
+// ============================
+#define RELAY_BOOT_RESTORE    0   // Restaurar el último estado comandado
+#define RELAY_BOOT_SAFE_OFF   1   // Arrancar siempre con todo apagado
+
+#define RELAY_BOOT_POLICY          RELAY_BOOT_RESTORE
+#define RELAY_STATE_SAVE_QUIET_MS  3000  // ms sin cambios antes de escribir en flash
+#define RELAY_STATE_SAVE_MAX_DEFER_MS 15000 // ms - como mucho, desde la primera petición pendiente
+
+// ============================
+// 📝 Registro de actuaciones (SPIFFS)
+// ============================
+#define AUDIT_BUFFER_RECORDS      64      // Cambios en RAM pendientes de escribir
+#define AUDIT_BATCH_RECORDS       16      // Lote que dispara una escritura en flash
+#define AUDIT_FLUSH_INTERVAL_MS   30000   // ms - escritura aunque el lote no esté completo
+#define AUDIT_SEGMENT_RECORDS     512     // Registros por segmento (8 KB)
+#define AUDIT_MAX_SEGMENTS        8       // Segmentos conservados (~4000 cambios)
+#define AUDIT_QUERY_MAX_ROWS      500     // Filas máximas por consulta
+#define AUDIT_CHUNK_PACE_MS       20      // ms entre trozos de una respuesta (deja vaciar la cola de salida)
+#define AUDIT_CHUNK_RETRIES       5       // Reintentos de un trozo con la cola de salida llena
+#define AUDIT_CHUNK_RETRY_MS      50      // ms - espera antes del reintento n (x n)
+#define AUDIT_NTP_SERVER          "pool.ntp.org"   // Hora UTC de los registros
+
+// ============================
+// ⏱️ Uso y desgaste de relés (NVS)
+// ============================
+#define RELAY_USAGE_REPORT_INTERVAL  60000    // ms - publicación en system/usage
+#define RELAY_USAGE_CHECKPOINT_MS    600000   // ms - mínimo entre escrituras en flash (solo si cambió)
+
 // ============================
 // 🌀 Control del Ventilador
 // ============================
 #define FAN_CONTROL_PIN     18  // L298N control pin
 
+// ============================
+// 🐕 Supervisor de tareas / watchdog
+// ============================
+#define SUPERVISOR_CHECK_INTERVAL   1000   // ms - revisión de check-ins
+#define SUPERVISOR_TOLERANCE_PCT    50     // % del periodo tolerado como retraso
+#define SUPERVISOR_MIN_SLACK_MS     200    // ms de margen adicional
+#define SUPERVISOR_STALL_RESET_MS   30000  // ms sin check-in de una tarea crítica antes de escalar
+#define SUPERVISOR_WDT_TIMEOUT_S    10     // s - watchdog hardware de tareas
+
+// ============================
+// 🧵 Plan de tareas (núcleo / prioridad / pila)
+// ============================
+#define TASK_PLAN_LEGACY        0   // Colocación histórica
+#define TASK_PLAN_PARTITIONED   1   // Control aislado en el núcleo 1, telemetría y red en el 0
+
+#ifndef TASK_PLACEMENT_PLAN
+#define TASK_PLACEMENT_PLAN     TASK_PLAN_PARTITIONED
+#endif
+
+// Benchmark de latencia comando -> relé bajo carga sintética (ver platformio.ini)
+#ifndef TASK_PLAN_BENCHMARK
+#define TASK_PLAN_BENCHMARK     0
+#endif
+#define BENCHMARK_COMMANDS          200    // Comandos inyectados por ronda
+#define BENCHMARK_COMMAND_INTERVAL  50     // ms entre comandos
+#define BENCHMARK_LOAD_BUSY_MS      20     // ms de CPU ocupada por ciclo de la carga sintética
+// Ráfagas: el inyector envía un comando por tick (1000/s) durante BENCHMARK_BURST_MS
+// y se comprueba que ningún relé conmute dentro de RELAY_MIN_SWITCH_INTERVAL_MS
+#ifndef BENCHMARK_BURST
+#define BENCHMARK_BURST             0
+#endif
+#define BENCHMARK_BURST_MS          5000
+
+// Micro-benchmarks de las rutas calientes con referencias (env:bench_micro, ver micro_benchmark.h)
+#ifndef BENCHMARK_MODE
+#define BENCHMARK_MODE          0
+#endif
+#define MICRO_BENCH_ITERATIONS      32     // Medidas por caso (se compara la mediana)
+#define MICRO_BENCH_GAP_MS          20     // ms entre medidas (vacía el UART y la cola MQTT)
+#define MICRO_BENCH_CONNECT_WAIT_MS 30000  // ms de espera al broker antes de empezar
+#define MICRO_BENCH_BATCH           64     // Conversiones ADC por medida
+#define MICRO_BENCH_PAUSE_WAIT_MS   2000   // ms de espera a que la tarea de control se detenga
+
+// Modo de memoria estática: pilas de tareas fuera del heap y vigilancia de
+// reservas tras setup(). Requiere envolver malloc en el enlazador (env:esp32dev_static).
+#ifndef STATIC_ALLOCATION_MODE
+#define STATIC_ALLOCATION_MODE  0
+#endif
+#ifndef ALLOC_GUARD_STRICT
+#define ALLOC_GUARD_STRICT      0   // 1 = abort() en la primera reserva (con backtrace)
+#endif
+#define SERIAL_LOG_LINE_MAX     192 // bytes por línea de serial_printf (en la pila de la tarea)
+
+// Colas entre tareas (memoria estática)
+#define CONTROL_QUEUE_LENGTH        8      // Comandos pendientes para la tarea de control
+#define CONTROL_PAYLOAD_MAX         384    // bytes por comando
+#define MQTT_OUTBOUND_POOL_SIZE     12     // Mensajes de salida en vuelo
+#define MQTT_OUTBOUND_PAYLOAD_MAX   960    // bytes por mensaje de salida
+#define MQTT_OUTBOUND_WAIT_MS       10     // Espera máxima por un hueco libre antes de descartar
+#define MQTT_OUTBOUND_PRIORITY_RESERVE 3   // Huecos que la telemetría no puede ocupar (quedan para los estados)
+#define MQTT_DEFERRED_PAYLOAD_MAX   512    // bytes del último valor aplazado de un retenido con intervalo mínimo
+#define MQTT_INBOUND_BURST          32     // Paquetes entrantes procesados por vuelta del bucle
+#define MQTT_PUMP_POLL_MS           5      // Tramo de espera en el socket entre avisos de publicación
+
+// Combinación de comandos por destino (zonas 1-4 y ventilador): los pendientes
+// se funden (el último ON/OFF gana, dos TOGGLE se anulan) y cada relé conmuta
+// como mucho una vez por intervalo
+#ifndef RELAY_MIN_SWITCH_INTERVAL_MS
+#define RELAY_MIN_SWITCH_INTERVAL_MS  250
+#endif
+#define CONTROL_REPORT_INTERVAL     10000  // ms - contadores en system/diagnostics (solo si cambian)
+
+// Carril urgente: apagado total, escenario de emergencia y ventilador OFF
+// adelantan a la cola normal e interrumpen la escena en curso
+#define CONTROL_URGENT_QUEUE_LENGTH 4
+#define URGENT_LATENCY_TARGET_US    20000  // Objetivo recepción -> relé conmutado
+
+// Control local por UDP (mismos comandos que MQTT, firmados con HMAC-SHA256)
+#ifndef UDP_CONTROL_ENABLED
+#define UDP_CONTROL_ENABLED         0
+#endif
+#ifndef UDP_CONTROL_PORT
+#define UDP_CONTROL_PORT            4210
+#endif
+#define UDP_CONTROL_KEY             "cambia-esta-clave-compartida"   // Misma clave en el panel
+#define UDP_CONTROL_TOPIC_MAX       64     // Ruta del topic sin el prefijo
+#define UDP_CONTROL_ACK_WAIT_MS     100    // Espera a la tarea de control antes de confirmar
+
 // ============================
 // Intervalos de Automatización
 // ============================
@@ -0,0 +1,95 @@
+// include/control_dispatcher.h
+#ifndef CONTROL_DISPATCHER_H
+#define CONTROL_DISPATCHER_H
+
+#include <Arduino.h>
+#include "topics.h"
+#include "light_controller.h"
+
+// ============================
+// Despacho de comandos en una tarea de control dedicada
+// ============================
+// El callback MQTT (tarea de red) solo copia el mensaje a una cola; la tarea
+// de control lo interpreta y actúa sobre los relés. Así la actuación no
+// compite con la telemetría ni espera a la red.
+// Los comandos simples por destino (lights/N/set, fan/set y lights/all/set
+// con ON/OFF/TOGGLE) se funden en una intención pendiente por relé: el último
+// ON/OFF gana y dos TOGGLE se anulan; el TOGGLE global se decide contra el
+// estado que dejará lo pendiente. Cada relé conmuta como mucho una vez cada
+// RELAY_MIN_SWITCH_INTERVAL_MS; lo que llegue antes espera fundiéndose con lo
+// siguiente. El resto de comandos (escenarios, binario, transacciones, payloads
+// con más campos) se ejecutan en orden: esperan en cabeza de la cola a que se
+// apliquen las intenciones anteriores y a que ningún relé haya conmutado dentro
+// de su intervalo mínimo.
+// Los escenarios avanzan por pasos entre comandos, sin bloquear la tarea. Los
+// comandos simples que llegan durante una escena se funden igualmente y se
+// aplican al terminar (salvo el TOGGLE global, que espera a la escena).
+// Carril urgente: lights/all/set OFF, los escenarios all_off / emergency y
+// fan/set OFF van a una cola aparte que se atiende antes que la normal;
+// interrumpen la escena en curso y anulan lo recibido antes para los mismos
+// relés. De un binario o una transacción anterior se aplica la parte que no
+// se anuló (p. ej. el ventilador tras un all_off) y su confirmación lo indica.
+// Los que llegan como escenario quedan registrados con origen ACTUATION_SCENE.
+// Es el único camino que conmuta sin respetar el intervalo mínimo. Su latencia se mide por separado (objetivo URGENT_LATENCY_TARGET_US).
+
+// Latencia recepción -> actuación terminada (µs)
+struct ControlLatencyStats {
+    uint32_t count;
+    uint32_t minUs;
+    uint32_t maxUs;
+    uint32_t avgUs;
+    uint32_t dropped;      // Comandos descartados por cola llena o payload demasiado grande
+    uint32_t coalesced;    // Comandos absorbidos por otro posterior del mismo destino
+    uint32_t rateLimited;  // Intenciones retrasadas por el intervalo mínimo de conmutación
+    uint32_t urgentCount;  // Comandos del carril urgente
+    uint32_t urgentAvgUs;
+    uint32_t urgentMaxUs;
+    uint32_t urgentOverTarget;   // Urgentes por encima de URGENT_LATENCY_TARGET_US
+    uint32_t preempted;    // Comandos e intenciones anulados por un urgente posterior
+};
+
+// Comando encolado: su secuencia y la cola en la que espera
+struct ControlTicket {
+    uint32_t seq;
+    bool urgent;
+};
+
+// Crea la cola y arranca la tarea de control
+void control_dispatcher_start();
+
+// ¿Lo atiende la tarea de control?
+bool control_dispatcher_handles(TopicId topic);
+
+// Encola un comando recibido. receivedUs = instante de recepción (micros()).
+// Seguro desde varias tareas (callback MQTT, control UDP, inyector del
+// benchmark de plan): secuencia y copia del mensaje van bajo un mutex.
+// ticket (opcional) dice dónde quedó, para control_dispatcher_wait_processed.
+bool control_dispatcher_submit(TopicId topic, const uint8_t* payload, unsigned int length, uint32_t receivedUs,
+                               ControlTicket* ticket = NULL);
+
+// Espera como mucho timeoutMs a que la tarea de control consuma el comando
+// (ejecutado, fundido en una intención o anulado). No espera a los que
+// llegaron después ni a la otra cola: cada cola lleva su marca de lo
+// consumido. pending = quedan intenciones retrasadas por el intervalo mínimo
+// o por la escena en curso. Un solo llamador a la vez (UDP local).
+bool control_dispatcher_wait_processed(const ControlTicket &ticket, uint32_t timeoutMs, bool* pending);
+
+// Detiene la tarea de control al final de su pasada (micro-benchmark: así es
+// el único escritor de los relés). Lo que llegue mientras tanto espera en las
+// colas y se atiende al reanudar. false = no se detuvo en timeoutMs.
+bool control_dispatcher_pause(uint32_t timeoutMs);
+void control_dispatcher_resume();
+
+// Pide una escena desde otra tarea (automatización). Se ejecuta en la tarea de
+// control; si llega otra antes de empezar, la sustituye.
+void control_dispatcher_request_scene(Scenario scenario, ActuationSource source);
+
+// Pide encender o apagar el ventilador desde otra tarea (automatización). Lo
+// aplica la tarea de control, en orden con los urgentes: un fan OFF urgente
+// anula la petición anterior y un comando pendiente para el ventilador gana.
+void control_dispatcher_request_fan(LightCommand command, ActuationSource source);
+
+ControlLatencyStats control_dispatcher_get_stats();
+void control_dispatcher_reset_stats();
+
+#endif // CONTROL_DISPATCHER_H
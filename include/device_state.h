@@ -0,0 +1,56 @@
+// include/device_state.h
+#ifndef DEVICE_STATE_H
+#define DEVICE_STATE_H
+
+#include <Arduino.h>
+
+// ============================
+// Documento de estado consolidado (versionado)
+// ============================
+// Un único documento con WiFi, memoria, uptime, sensores, zonas y ventilador.
+// Cada publicación lleva un número de secuencia monótono dentro del arranque
+// y el número de arranque (contador en NVS):
+//   state/document  documento completo (retenido), al conectar o al pedirlo
+//                   en state/sync:  {"boot": 7, "seq": 40, "full": true, "state": {...}}
+//   state/delta     solo los campos que cambiaron desde la anterior:
+//                   {"boot": 7, "seq": 41, "prev": 40, "state": {"lights": {"2": false}}}
+// Un espejo que reciba un delta de otro "boot" o con "prev" distinto de su
+// última secuencia ha perdido algo: publica en state/sync y recibe el
+// documento completo. La secuencia vuelve a 1 en cada arranque; el par
+// (boot, seq) no se repite.
+// Los cambios de relés salen enseguida; la telemetría se agrupa como mucho
+// DEVICE_STATE_BATCH_MS y solo cuenta si supera la banda muerta del campo.
+
+enum StateField : uint8_t {
+    STATE_WIFI_CONNECTED = 0,
+    STATE_WIFI_SSID,
+    STATE_WIFI_IP,
+    STATE_WIFI_RSSI,
+    STATE_HEAP_FREE,
+    STATE_HEAP_MIN_FREE,
+    STATE_UPTIME_S,
+    STATE_TEMPERATURE,        // Milésimas de °C
+    STATE_LDR_RAW,
+    STATE_LDR_LUX,
+    STATE_LIGHT_1,            // STATE_LIGHT_1 + (zona - 1)
+    STATE_LIGHT_2,
+    STATE_LIGHT_3,
+    STATE_LIGHT_4,
+    STATE_FAN_ON,
+    STATE_FAN_SPEED,
+    STATE_FAN_AUTO,
+    STATE_FIELD_COUNT
+};
+
+// Numera el arranque (una escritura en NVS) y arranca la tarea que publica el documento
+void device_state_start();
+
+// Actualiza un campo (O(1); seguro desde cualquier tarea). Solo marca el campo
+// como cambiado si supera su banda muerta.
+void device_state_set(StateField field, int32_t value);
+void device_state_set_text(StateField field, const char* text);
+
+// Publica el documento completo en cuanto haya conexión (al conectar y en state/sync)
+void device_state_request_full();
+
+#endif // DEVICE_STATE_H
@@ -3,9 +3,11 @@
 #define JSON_FORMATTER_H
 
 #include <Arduino.h>
+#include <ArduinoJson.h>
+#include "wifi_manager.h"
 
-// Generadores de JSON separados
-String generate_wifi_json();
-String generate_memory_json();
+// Generadores de JSON separados (rellenan un documento del llamador, sin String)
+void generate_wifi_json(const WifiSnapshot &wifi, JsonDocument &doc);   // StaticJsonDocument<384>
+void generate_memory_json(JsonDocument &doc);                           // StaticJsonDocument<512>
 
 #endif // JSON_FORMATTER_H
@@ -3,6 +3,9 @@
 #define LIGHT_CONTROLLER_H
 
 #include <Arduino.h>
+#include <ArduinoJson.h>
+#include "topics.h"
+#include "audit_log.h"
 
 // ============================
 // 💡 Control de Luces (Relés)
@@ -17,21 +20,35 @@
 // ============================
 #define FAN_CONTROL_PIN     18  // L298N control pin
 
-// ============================
-// MQTT Topics para Control
-// ============================
-#define MQTT_TOPIC_LIGHT_BASE       "esp32/auditorium/lights"
-#define MQTT_TOPIC_LIGHT_ALL_SET    "esp32/auditorium/lights/all/set"
-#define MQTT_TOPIC_SCENARIO_SET     "esp32/auditorium/scenario/set"
-#define MQTT_TOPIC_FAN_SET          "esp32/auditorium/fan/set"
-#define MQTT_TOPIC_FAN_STATE        "esp32/auditorium/fan/state"
+// Acción de un comando (JSON "command" o binario)
+enum LightCommand : uint8_t {
+    LIGHT_CMD_NONE = 0,
+    LIGHT_CMD_ON,
+    LIGHT_CMD_OFF,
+    LIGHT_CMD_TOGGLE
+};
+
+// Partes de un comando compuesto (binario, transacción) anuladas por un
+// urgente posterior: no se aplican y la confirmación lo dice ("preempted")
+#define PREEMPT_LIGHTS  0x01
+#define PREEMPT_FAN     0x02
+
+// Escenarios predefinidos
+enum Scenario : uint8_t {
+    SCENARIO_NONE = 0,
+    SCENARIO_ALL_ON,
+    SCENARIO_ALL_OFF,
+    SCENARIO_STAGE_ONLY,
+    SCENARIO_HALLWAYS_ONLY,
+    SCENARIO_EMERGENCY        // Todas las luces encendidas a la vez y ventilador apagado
+};
 
 // Estados de las luces
 struct LightState {
     bool isOn;
     unsigned long lastUpdate;
     int pin;
-    String name;
+    const char* name;
 };
 
 // Estado del ventilador
@@ -44,43 +61,75 @@ struct FanState {
 
 // Funciones principales
 void light_controller_setup();
-void handle_light_message(char* topic, byte* payload, unsigned int length);
+void handle_light_message(TopicId topic, byte* payload, unsigned int length);
+
+// Comandos (comunes a JSON y binario)
+LightCommand parse_light_command(const char* text);
+Scenario parse_scenario(const char* text);
+void apply_light_command(int zone, LightCommand command, ActuationSource source = ACTUATION_MQTT);
+void apply_fan_command(LightCommand command, ActuationSource source = ACTUATION_MQTT);
+void run_scenario(Scenario scenario);   // Arranca la secuencia (ver scene_run_due)
 
-// Control individual de luces
-void turn_on_light(int zone);
-void turn_off_light(int zone);
-void toggle_light(int zone);
+// Máscara de zonas (bit i = zona i+1 encendida)
+uint8_t get_light_mask();
+uint8_t apply_light_mask(uint8_t mask, ActuationSource source = ACTUATION_MQTT);   // Devuelve los bits que cambiaron
+
+// Control individual de luces (el origen queda en el registro de actuaciones)
+void turn_on_light(int zone, ActuationSource source = ACTUATION_MQTT);
+void turn_off_light(int zone, ActuationSource source = ACTUATION_MQTT);
+void toggle_light(int zone, ActuationSource source = ACTUATION_MQTT);
 bool is_light_on(int zone);
 
-// Control global de luces
-void turn_on_all_lights();
-void turn_off_all_lights();
-void toggle_all_lights();
 
 // Control del ventilador
-void turn_on_fan();
-void turn_off_fan();
-void toggle_fan();
-void set_fan_auto_mode(bool enabled);
+void turn_on_fan(ActuationSource source = ACTUATION_MQTT);
+void turn_off_fan(ActuationSource source = ACTUATION_MQTT);
+void toggle_fan(ActuationSource source = ACTUATION_MQTT);
+void set_fan_auto_mode(bool enabled, ActuationSource source = ACTUATION_MQTT);
 bool is_fan_on();
 
-// Escenarios predefinidos
-void set_scenario_all_on();
-void set_scenario_all_off();
-void set_scenario_stage_only();
-void set_scenario_hallways_only();
+// Escenas por pasos (encendido escalonado sin delay()): la tarea de control
+// avanza la secuencia entre comandos y un comando urgente la interrumpe.
+// Al terminar se publican las zonas que cambiaron.
+#define SCENE_IDLE  0xFFFFFFFFUL
+
+void scene_start(Scenario scenario, ActuationSource source);
+uint32_t scene_run_due();     // Ejecuta los pasos vencidos; ms hasta el siguiente o SCENE_IDLE
+bool scene_active();
+uint8_t scene_cancel();       // Interrumpe la escena; devuelve las zonas que ya había cambiado
 
 // Publicación de estados
 void publish_light_status(int zone);
 void publish_all_lights_status();
+void publish_changed_lights(uint8_t changedMask);   // Solo las zonas de la máscara + resumen
 void publish_fan_status();
 
+// Estado actual en JSON (solo memoria, sin tocar el hardware)
+void fill_lights_status(JsonDocument &doc);   // StaticJsonDocument<300>
+void fill_fan_status(JsonDocument &doc);      // StaticJsonDocument<200>
+
 // Automatización
-void check_temperature_automation(float temperature);
+void check_temperature_automation(int32_t milliCelsius);   // Milésimas de °C
 void check_ldr_automation(int ldrValue);
 
 // Getters para estado
 LightState get_light_state(int zone);
 FanState get_fan_state();
 
+// Conmutaciones reales de cada relé (índices 0-3 = zonas 1-4, 4 = ventilador;
+// los mismos que relay_usage). Solo cuentan las escrituras que cambian el relé.
+#define RELAY_TARGET_FAN   4
+#define RELAY_TARGETS      5
+
+struct RelaySwitchStats {
+    uint32_t switches;          // Desde el arranque o el último reset
+    uint32_t minGapMs;          // Menor separación entre dos conmutaciones del mismo relé (0xFFFFFFFF = ninguna)
+    uint32_t underInterval;     // Separaciones por debajo de RELAY_MIN_SWITCH_INTERVAL_MS
+};
+
+unsigned long relay_last_switch_ms(uint8_t target);   // millis() de la última conmutación (0 = ninguna)
+uint32_t relay_interval_left(uint32_t elapsedMs);     // ms que faltan del intervalo mínimo (0 = puede conmutar)
+RelaySwitchStats relay_switch_stats();
+void relay_switch_stats_reset();
+
 #endif // LIGHT_CONTROLLER_H
\ No newline at end of file
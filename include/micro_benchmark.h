@@ -0,0 +1,26 @@
+// include/micro_benchmark.h
+#ifndef MICRO_BENCHMARK_H
+#define MICRO_BENCHMARK_H
+
+#include <Arduino.h>
+
+// ============================
+// Micro-benchmarks de rutas calientes (solo con BENCHMARK_MODE = 1)
+// ============================
+// Con el firmware completo en marcha, una tarea mide cada caso
+// MICRO_BENCH_ITERATIONS veces con el contador de ciclos de la CPU: JSON
+// (wifi, memoria), handle_light_message por tipo de comando, la publicación
+// de todas las luces, la conversión de sensores y las comprobaciones de
+// automatización. Cada caso sale por Serial como una línea JSON:
+//   [BENCH] {"case":"light_on","n":32,"min":..,"median":..,"max":..,"median_ns":..}
+// y al final un resumen (también en system/diagnostics). No hay referencias en
+// el dispositivo: las medianas se anotan para comparar antes y después de un
+// cambio. La comprobación de regresiones con umbral es test/host/bench_hot_paths.
+// Un caso que arranca una escena la ejecuta entera (sus pasos, sin las esperas
+// entre ellos).
+// Los casos conmutan relés de verdad. Mientras mide, la tarea de control está
+// en pausa y la automatización no arranca en este modo: los comandos que
+// lleguen esperan en la cola y se atienden al terminar.
+void micro_benchmark_start();
+
+#endif // MICRO_BENCHMARK_H
@@ -3,10 +3,37 @@
 #define MQTT_CLIENT_H
 
 #include <Arduino.h>
+#include <ArduinoJson.h>
+#include "topics.h"
 
+// mqtt_setup() y mqtt_loop() deben llamarse desde la misma tarea (la de bombeo)
 void mqtt_setup();
 void mqtt_loop();
-void mqtt_publish(const char* topic, const String& payload);
+
+// Espera hasta timeoutMs o hasta que otra tarea encole una publicación
+void mqtt_wait_for_work(uint32_t timeoutMs);
+
+// Publica en un topic del registro aplicando su retain e intervalo mínimo.
+// Desde otras tareas el mensaje se copia a la cola de salida y lo envía mqtt_loop().
+// Devuelve false si no hay conexión, si lo descarta el límite, si la cola está
+// llena o si falla el envío. En un topic retenido lo limitado no se descarta:
+// queda como último valor y sale al vencer el intervalo (devuelve true).
+bool mqtt_publish(TopicId id, const char* payload);
+bool mqtt_publish(TopicId id, const uint8_t* payload, size_t length);
+
+// Igual, pero serializa el documento directamente en la cola de salida (sin String)
+bool mqtt_publish_json(TopicId id, const JsonDocument& doc, bool pretty = false);
+
+// Respuesta a una consulta en un topic elegido por el cliente (sin retain).
+// Solo desde el callback MQTT (tarea de bombeo); devuelve false en otro caso.
+bool mqtt_reply_json(const char* topic, const JsonDocument& doc);
+
+// Publicaciones descartadas por el intervalo mínimo desde el arranque
+uint32_t mqtt_get_rate_limited_count();
+
+// Publicaciones descartadas por cola de salida llena
+uint32_t mqtt_get_outbound_dropped();
+
 bool mqtt_is_connected();
 
 #endif
@@ -0,0 +1,20 @@
+// include/placement_benchmark.h
+#ifndef PLACEMENT_BENCHMARK_H
+#define PLACEMENT_BENCHMARK_H
+
+#include <Arduino.h>
+
+// ============================
+// Benchmark del plan de tareas (solo con TASK_PLAN_BENCHMARK = 1)
+// ============================
+// Arranca una carga sintética de telemetría y un inyector de comandos que
+// entran por la misma cola que los de MQTT. Cada ronda publica en
+// system/diagnostics (y por Serial) la latencia comando -> relé del plan activo.
+// Se compara compilando los entornos bench_plan_legacy y bench_plan_partitioned.
+// Con BENCHMARK_BURST = 1 (env:bench_burst) las rondas son ráfagas a 1000 msg/s
+// que mezclan TOGGLE por zona y global, binario y transacciones; cada una
+// informa de las conmutaciones reales y de la menor separación por relé frente
+// a RELAY_MIN_SWITCH_INTERVAL_MS ("result": "pass" / "fail").
+void placement_benchmark_start();
+
+#endif // PLACEMENT_BENCHMARK_H
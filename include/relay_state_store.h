@@ -0,0 +1,25 @@
+// include/relay_state_store.h
+#ifndef RELAY_STATE_STORE_H
+#define RELAY_STATE_STORE_H
+
+#include <Arduino.h>
+
+// Último estado comandado de relés (persistido en NVS)
+struct RelayStateSnapshot {
+    uint8_t zoneMask;   // bit i = zona i+1 encendida
+    bool fanOn;
+    bool fanAutoMode;
+};
+
+// Lee el registro guardado. Devuelve false si no existe o el CRC no coincide.
+bool relay_state_store_load(RelayStateSnapshot &snapshot);
+
+// Arranca la tarea de escritura diferida (llamar tras restaurar el estado)
+void relay_state_store_start();
+
+// Solicita guardar un estado. Las ráfagas se agrupan: solo se escribe en
+// flash tras RELAY_STATE_SAVE_QUIET_MS sin cambios nuevos, pero nunca más de
+// RELAY_STATE_SAVE_MAX_DEFER_MS después de la primera petición pendiente.
+void relay_state_store_request_save(const RelayStateSnapshot &snapshot);
+
+#endif // RELAY_STATE_STORE_H
@@ -0,0 +1,27 @@
+// include/relay_usage.h
+#ifndef RELAY_USAGE_H
+#define RELAY_USAGE_H
+
+#include <Arduino.h>
+#include "audit_log.h"
+
+// ============================
+// Uso y desgaste de relés (zonas 1-4 y ventilador)
+// ============================
+// Por relé: ciclos de conmutación (apagado -> encendido), tiempo encendido
+// acumulado y ese mismo tiempo repartido por el origen que lo encendió.
+// Cada transición actualiza los contadores en O(1) y en RAM; una tarea de baja
+// prioridad los guarda en NVS como mucho cada RELAY_USAGE_CHECKPOINT_MS (solo
+// si cambiaron) y los publica en system/usage cada RELAY_USAGE_REPORT_INTERVAL.
+// Tras un reinicio se pierde como mucho lo acumulado desde el último guardado.
+
+#define USAGE_TARGET_FAN   4    // Índices 0-3 = zonas 1-4
+#define USAGE_TARGETS      5
+
+// Suma lo guardado en NVS y arranca la tarea (las transiciones anotadas antes se conservan)
+void relay_usage_start();
+
+// Anota una transición del relé (O(1), seguro desde cualquier tarea)
+void relay_usage_record(uint8_t target, bool on, ActuationSource source);
+
+#endif // RELAY_USAGE_H
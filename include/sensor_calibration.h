@@ -0,0 +1,30 @@
+// include/sensor_calibration.h
+#ifndef SENSOR_CALIBRATION_H
+#define SENSOR_CALIBRATION_H
+
+#include <Arduino.h>
+
+// ============================
+// Conversión calibrada de cuentas ADC (tablas enteras)
+// ============================
+// Al arrancar se caracteriza el ADC1 con los datos del eFuse (Vref o Two
+// Point; si no hay, ADC_DEFAULT_VREF_MV) y se construye una tabla por canal
+// de 2^(12 - SENSOR_LUT_SEGMENT_BITS) + 1 nodos: la curva no lineal del ADC ya
+// va dentro. Cada muestra se convierte con una búsqueda y una interpolación
+// lineal entera, sin coma flotante.
+//   Temperatura: LM35 (TEMP_SENSOR_MV_PER_C) -> milésimas de °C
+//   LDR: divisor con LDR_FIXED_RESISTOR_OHMS y curva R = R10·(lux/10)^-γ -> lux
+
+// Caracteriza el ADC y construye las tablas (llamar en setup antes de muestrear)
+void sensor_calibration_init();
+
+// Cuentas ADC (0..ADC_MAX_VALUE) -> milésimas de °C
+int32_t adc_to_millicelsius(uint16_t raw);
+
+// Cuentas ADC (0..ADC_MAX_VALUE) -> lux (0..LDR_LUX_MAX)
+int32_t adc_to_lux(uint16_t raw);
+
+// Origen de la calibración: "efuse_tp", "efuse_vref" o "default_vref"
+const char* sensor_calibration_source();
+
+#endif // SENSOR_CALIBRATION_H
@@ -0,0 +1,39 @@
+// include/sensor_history.h
+#ifndef SENSOR_HISTORY_H
+#define SENSOR_HISTORY_H
+
+#include <Arduino.h>
+
+// ============================
+// Histórico de sensores en memoria fija, multi-resolución
+// ============================
+// Por canal: anillo de muestras crudas (~1 s), agregados de 1 min y de 15 min
+// (mín/máx/media). Cada muestra se incorpora en O(1).
+// Tiempos desde el arranque (esp_timer, 64 bits: no dan la vuelta como
+// millis()): ms en las filas crudas, s en los agregados y en los límites
+// "from"/"to" de las consultas.
+
+enum SensorChannel : uint8_t {
+    SENSOR_CHANNEL_TEMPERATURE = 0,   // Valores en centésimas de °C
+    SENSOR_CHANNEL_LDR,               // Valores en cuentas ADC
+    SENSOR_CHANNEL_COUNT
+};
+
+enum HistoryResolution : uint8_t {
+    HISTORY_RES_RAW = 0,
+    HISTORY_RES_1MIN,
+    HISTORY_RES_15MIN
+};
+
+// Reserva las estructuras (llamar una vez en setup antes de crear las tareas)
+void sensor_history_init();
+
+// Añade una muestra al canal con la hora actual
+void sensor_history_add(SensorChannel channel, int16_t value);
+
+// Maneja una consulta recibida en sensors/history/get y responde por trozos
+// en sensors/history/data.
+// Payload: {"id": "q1", "channel": "temperature", "res": "1m", "from": 0, "to": 3600}
+void handle_history_query(const uint8_t* payload, unsigned int length);
+
+#endif // SENSOR_HISTORY_H
@@ -0,0 +1,17 @@
+// include/serial_log.h
+#ifndef SERIAL_LOG_H
+#define SERIAL_LOG_H
+
+#include <Arduino.h>
+
+// ============================
+// Trazas por Serial sin heap
+// ============================
+// Print::printf del core de Arduino formatea en 64 bytes de pila y pide al heap
+// las líneas más largas. serial_printf() formatea en un buffer de pila de
+// SERIAL_LOG_LINE_MAX bytes y lo escribe con Serial.write: nunca reserva, así
+// que se puede usar desde las tareas vigiladas por alloc_guard. Las líneas más
+// largas se recortan (conservando el salto de línea final).
+size_t serial_printf(const char* format, ...) __attribute__((format(printf, 1, 2)));
+
+#endif // SERIAL_LOG_H
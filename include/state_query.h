@@ -0,0 +1,20 @@
+// include/state_query.h
+#ifndef STATE_QUERY_H
+#define STATE_QUERY_H
+
+#include <Arduino.h>
+#include "topics.h"
+
+// ============================
+// Consultas de estado (petición / respuesta)
+// ============================
+// Topics .../get para zonas, ventilador, sensores, memoria y WiFi.
+// Payload: {"id": "c1", "reply_to": "app/123/resp"}  (ambos opcionales)
+// La respuesta sale en reply_to (o en state/response si no se indica) con el
+// mismo id, el tipo consultado y el estado actual. Se construye con los
+// snapshots en memoria: no se lee el ADC ni se tocan los relés.
+// reply_to no puede estar bajo DEVICE_TOPIC_PREFIX (solo state/response) ni
+// empezar por '$': la consulta se ignora.
+void handle_state_query(TopicId topic, const uint8_t* payload, unsigned int length);
+
+#endif // STATE_QUERY_H
@@ -0,0 +1,65 @@
+// include/task_plan.h
+#ifndef TASK_PLAN_H
+#define TASK_PLAN_H
+
+#include <Arduino.h>
+#include "config.h"
+
+// ============================
+// Plan de tareas FreeRTOS (núcleo, prioridad y pila de cada tarea)
+// ============================
+// Toda la colocación de tareas se declara en la tabla de task_plan.cpp.
+// TASK_PLACEMENT_PLAN (config.h) elige la variante:
+//   TASK_PLAN_LEGACY       colocación histórica (sensores y automatización en el
+//                          núcleo 0 con la pila WiFi/LwIP, telemetría y loop() en el 1)
+//   TASK_PLAN_PARTITIONED  control aislado en el núcleo 1 con prioridad alta;
+//                          telemetría y red en el núcleo 0
+// El bucle de Arduino (loop(), bombeo MQTT) siempre corre en el núcleo 1 con prioridad 1.
+// Con STATIC_ALLOCATION_MODE las pilas y TCB salen de memoria estática
+// (xTaskCreateStaticPinnedToCore) en lugar del heap.
+
+enum TaskRole : uint8_t {
+    TASK_ROLE_CONTROL = 0,        // Despacho de comandos y actuación
+    TASK_ROLE_SENSOR_MONITOR,
+    TASK_ROLE_AUTOMATION,
+    TASK_ROLE_RELAY_STORE,
+    TASK_ROLE_SUPERVISOR,
+    TASK_ROLE_WIFI_INFO,
+    TASK_ROLE_MEMORY_INFO,
+    TASK_ROLE_STATUS_REPORTER,
+    TASK_ROLE_TEMPERATURE,
+    TASK_ROLE_LDR,
+    TASK_ROLE_AUDIT_LOG,          // Escritura por lotes del registro de actuaciones
+    TASK_ROLE_DEVICE_STATE,       // Documento de estado consolidado (completo + deltas)
+    TASK_ROLE_RELAY_USAGE,        // Contadores de uso de relés (NVS + system/usage)
+    TASK_ROLE_UDP_CONTROL,        // Control local por UDP (solo con UDP_CONTROL_ENABLED)
+    TASK_ROLE_WIFI_CONNECT,       // Reintentos de conexión WiFi (los pide el temporizador de backoff)
+    TASK_ROLE_BENCHMARK_LOAD,     // Solo con TASK_PLAN_BENCHMARK
+    TASK_ROLE_BENCHMARK_DRIVER,   // Solo con TASK_PLAN_BENCHMARK
+    TASK_ROLE_MICRO_BENCHMARK,    // Solo con BENCHMARK_MODE
+    TASK_ROLE_COUNT
+};
+
+struct TaskSpec {
+    const char* name;
+    uint32_t stackSize;
+    UBaseType_t priority;
+    BaseType_t core;
+    bool heapAllowed;      // Reserva por diseño (NVS, SPIFFS, mbedTLS, WiFi): alloc_guard no la cuenta
+};
+
+// Especificación de una tarea en el plan activo
+const TaskSpec &task_plan_get(TaskRole role);
+
+// Crea la tarea según el plan activo
+bool task_plan_start(TaskRole role, TaskFunction_t function, void* parameter = NULL,
+                     TaskHandle_t* handle = NULL);
+
+// Nombre del plan activo (para diagnóstico)
+const char* task_plan_name();
+
+// true si la tarea fue creada por el plan y no tiene permitido el heap
+// (las que vigila alloc_guard)
+bool task_plan_heap_guarded(TaskHandle_t task);
+
+#endif // TASK_PLAN_H
@@ -0,0 +1,30 @@
+// include/task_supervisor.h
+#ifndef TASK_SUPERVISOR_H
+#define TASK_SUPERVISOR_H
+
+#include <Arduino.h>
+
+// ============================
+// Supervisor de plazos y watchdog por software
+// ============================
+// Cada tarea periódica se registra con su periodo esperado y hace check-in en
+// cada iteración. El supervisor cuenta los plazos incumplidos y el retraso
+// máximo por tarea, publica las violaciones en el topic de diagnóstico y, si
+// una tarea crítica deja de hacer check-in más de SUPERVISOR_STALL_RESET_MS,
+// deja de alimentar el watchdog hardware de tareas para forzar el reinicio.
+
+#define SUPERVISOR_MAX_TASKS  8
+#define SUPERVISOR_INVALID_ID 0xFF
+
+typedef uint8_t SupervisedTaskId;
+
+// Registra una tarea. Devuelve SUPERVISOR_INVALID_ID si no hay hueco.
+SupervisedTaskId supervisor_register(const char* name, uint32_t periodMs, bool critical);
+
+// Marca una iteración completada de la tarea
+void supervisor_checkin(SupervisedTaskId id);
+
+// Arranca la tarea del supervisor (configura el watchdog hardware)
+void start_supervisor_task();
+
+#endif // TASK_SUPERVISOR_H
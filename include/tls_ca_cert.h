@@ -0,0 +1,22 @@
+// include/tls_ca_cert.h
+#ifndef TLS_CA_CERT_H
+#define TLS_CA_CERT_H
+
+// ============================
+// Certificado de la CA del broker (PEM)
+// ============================
+// Pegar aquí la CA que firmó el certificado del broker, una línea del PEM por
+// literal y terminadas en \n:
+//
+//     "-----BEGIN CERTIFICATE-----\n"
+//     "MIIDazCCAlOgAwIBAgIU...\n"
+//     "-----END CERTIFICATE-----\n"
+//
+// Vacío = no se conecta al broker, salvo con MQTT_TLS_INSECURE=1 (config.h),
+// que conecta sin verificar el servidor (solo para pruebas en laboratorio).
+
+#ifndef MQTT_TLS_CA_CERT
+#define MQTT_TLS_CA_CERT  ""
+#endif
+
+#endif // TLS_CA_CERT_H
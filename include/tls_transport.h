@@ -0,0 +1,74 @@
+// include/tls_transport.h
+#ifndef TLS_TRANSPORT_H
+#define TLS_TRANSPORT_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <ArduinoJson.h>
+#include <mbedtls/ssl.h>
+
+// ============================
+// Transporte TLS para MQTT con reanudación de sesión
+// ============================
+// Client de Arduino (lo que espera PubSubClient) sobre un WiFiClient y mbedTLS.
+// Tras cada handshake la sesión (ID de sesión o ticket) queda cacheada en RAM y
+// en memoria RTC_NOINIT: el siguiente connect() al mismo broker la ofrece y, si
+// el servidor la acepta, el handshake abreviado se salta el intercambio de
+// certificados y de clave (la parte cara en tiempo y en heap).
+// La caché sobrevive a reinicios en caliente (watchdog, esp_restart), no a un
+// corte de alimentación.
+// El nombre que se verifica en el certificado (y se envía como SNI) es el de
+// setServerName() o, sin él, el host de connect(). mbedTLS 2.x no compara los
+// SAN de IP: con el broker por IP hay que dar el nombre DNS del certificado o
+// emitirlo con la IP como CN / SAN DNS (se avisa con [TLS] ⚠).
+
+struct TlsHandshakeStats {
+    uint32_t lastHandshakeMs;
+    uint32_t lastPeakHeapBytes;    // Heap consumido en el pico del último handshake
+    bool lastResumed;
+    uint32_t fullHandshakes;
+    uint32_t resumedHandshakes;
+    uint32_t failures;
+    bool sessionFromRtc;           // Sesión recuperada de RTC tras un reinicio en caliente
+};
+
+class TlsSessionClient : public Client {
+public:
+    TlsSessionClient();
+
+    int connect(IPAddress ip, uint16_t port) override;
+    int connect(const char* host, uint16_t port) override;
+    size_t write(uint8_t b) override;
+    size_t write(const uint8_t* buf, size_t size) override;
+    int available() override;
+    int read() override;
+    int read(uint8_t* buf, size_t size) override;
+    int peek() override;
+    void flush() override;
+    void stop() override;
+    uint8_t connected() override;
+    operator bool() override { return connected(); }
+    void setServerName(const char* name) { serverName = name; }   // NULL = el host
+    int fd() const { return tcp.fd(); }   // Socket subyacente (para esperar datos con select)
+
+private:
+    static int bio_send(void* ctx, const unsigned char* buf, size_t len);
+    static int bio_recv(void* ctx, unsigned char* buf, size_t len);
+    void track_heap();
+    void teardown();
+
+    WiFiClient tcp;
+    const char* serverName;
+    mbedtls_ssl_context ssl;
+    bool sslReady;       // ssl inicializado (hay que liberarlo)
+    bool established;    // Handshake completado
+    int peeked;          // Byte leído por peek(), -1 si no hay
+    uint32_t heapLow;    // Mínimo de heap libre visto durante el handshake
+};
+
+const TlsHandshakeStats& tls_transport_get_stats();
+
+// Añade el objeto "tls" al estado del broker (status/broker)
+void tls_transport_fill_status(JsonDocument &doc);
+
+#endif // TLS_TRANSPORT_H
@@ -0,0 +1,145 @@
+// include/topics.h
+#ifndef TOPICS_H
+#define TOPICS_H
+
+#include <Arduino.h>
+#include "config.h"
+
+// ============================
+// Registro de topics MQTT
+// ============================
+// Todas las rutas se construyen en compilación a partir de DEVICE_TOPIC_PREFIX
+// (concatenación de literales). Cada topic lleva su QoS, retain e intervalo
+// mínimo entre publicaciones, que aplica mqtt_publish(). Los de prioridad
+// (estados de relés y confirmaciones) salen por un carril propio, por delante
+// de la telemetría.
+
+#define TOPIC_PATH(path)          DEVICE_TOPIC_PREFIX "/" path
+#define AUDITORIUM_PATH(path)     TOPIC_PATH("auditorium/" path)
+
+enum TopicId : uint8_t {
+    // ---- Salida: telemetría y estado ----
+    TOPIC_WIFI_STATUS = 0,
+    TOPIC_SYSTEM_MEMORY,
+    TOPIC_SYSTEM_BOOT,
+    TOPIC_HEARTBEAT,
+    TOPIC_CONNECTION,
+    TOPIC_LASTWILL,
+    TOPIC_TEMPERATURE,
+    TOPIC_LDR,
+    TOPIC_LIGHT_1_STATE,
+    TOPIC_LIGHT_2_STATE,
+    TOPIC_LIGHT_3_STATE,
+    TOPIC_LIGHT_4_STATE,
+    TOPIC_LIGHTS_STATUS,
+    TOPIC_FAN_STATE,
+    TOPIC_BINARY_STATE,
+    TOPIC_TRANSACTION_STATE,
+    TOPIC_HISTORY_DATA,
+    TOPIC_DIAGNOSTICS,
+    TOPIC_STATE_RESPONSE,
+    TOPIC_BROKER_STATUS,
+    TOPIC_AUDIT_DATA,
+    TOPIC_STATE_DOCUMENT,
+    TOPIC_STATE_DELTA,
+    TOPIC_USAGE_METRICS,
+
+    // ---- Entrada: comandos ----
+    TOPIC_LIGHT_1_SET,
+    TOPIC_LIGHT_2_SET,
+    TOPIC_LIGHT_3_SET,
+    TOPIC_LIGHT_4_SET,
+    TOPIC_LIGHT_ALL_SET,
+    TOPIC_SCENARIO_SET,
+    TOPIC_FAN_SET,
+    TOPIC_COMMAND,
+    TOPIC_BINARY_SET,
+    TOPIC_TRANSACTION_SET,
+    TOPIC_HISTORY_GET,
+    TOPIC_LIGHTS_GET,
+    TOPIC_FAN_GET,
+    TOPIC_SENSORS_GET,
+    TOPIC_MEMORY_GET,
+    TOPIC_WIFI_GET,
+    TOPIC_AUDIT_GET,
+    TOPIC_STATE_SYNC,
+
+    TOPIC_COUNT,
+    TOPIC_INVALID = 0xFF
+};
+
+struct TopicDef {
+    const char* path;
+    uint8_t qos;              // Entrada: QoS de suscripción. Salida: PubSubClient solo publica QoS 0
+    bool retain;
+    uint16_t minIntervalMs;   // 0 = sin límite
+    bool inbound;             // true = se suscribe al conectar
+    bool priority;            // Salida: carril prioritario (adelanta a la telemetría)
+};
+
+static constexpr TopicDef TOPICS[TOPIC_COUNT] = {
+    // path                                     qos retain  min_ms  inbound priority
+    { TOPIC_PATH("wifi/status"),                0,  true,   1000,   false,  false },
+    { TOPIC_PATH("system/memory"),              0,  false,  5000,   false,  false },
+    { TOPIC_PATH("system/boot"),                0,  true,   0,      false,  false },
+    { TOPIC_PATH("status/heartbeat"),           0,  false,  2000,   false,  false },
+    { TOPIC_PATH("status/connection"),          0,  true,   0,      false,  false },
+    { TOPIC_PATH("status/lastwill"),            0,  true,   0,      false,  false },
+    { TOPIC_PATH("sensors/temperature"),        0,  true,   1000,   false,  false },
+    { TOPIC_PATH("sensors/ldr"),                0,  true,   1000,   false,  false },
+    { AUDITORIUM_PATH("lights/1/state"),        0,  true,   0,      false,  true  },
+    { AUDITORIUM_PATH("lights/2/state"),        0,  true,   0,      false,  true  },
+    { AUDITORIUM_PATH("lights/3/state"),        0,  true,   0,      false,  true  },
+    { AUDITORIUM_PATH("lights/4/state"),        0,  true,   0,      false,  true  },
+    { AUDITORIUM_PATH("lights/status"),         0,  true,   0,      false,  true  },
+    { AUDITORIUM_PATH("fan/state"),             0,  true,   0,      false,  true  },
+    { AUDITORIUM_PATH("bin/state"),             0,  false,  0,      false,  true  },
+    { AUDITORIUM_PATH("transaction/state"),     0,  false,  0,      false,  true  },
+    { TOPIC_PATH("sensors/history/data"),       0,  false,  0,      false,  false },
+    { TOPIC_PATH("system/diagnostics"),         0,  false,  1000,   false,  false },
+    { TOPIC_PATH("state/response"),             0,  false,  0,      false,  false },
+    { TOPIC_PATH("status/broker"),              0,  true,   0,      false,  false },
+    { TOPIC_PATH("system/audit/data"),          0,  false,  0,      false,  false },
+    { TOPIC_PATH("state/document"),             0,  true,   0,      false,  false },
+    { TOPIC_PATH("state/delta"),                0,  false,  0,      false,  true  },
+    { TOPIC_PATH("system/usage"),               0,  true,   0,      false,  false },
+
+    { AUDITORIUM_PATH("lights/1/set"),          1,  false,  0,      true,   false },
+    { AUDITORIUM_PATH("lights/2/set"),          1,  false,  0,      true,   false },
+    { AUDITORIUM_PATH("lights/3/set"),          1,  false,  0,      true,   false },
+    { AUDITORIUM_PATH("lights/4/set"),          1,  false,  0,      true,   false },
+    { AUDITORIUM_PATH("lights/all/set"),        1,  false,  0,      true,   false },
+    { AUDITORIUM_PATH("scenario/set"),          1,  false,  0,      true,   false },
+    { AUDITORIUM_PATH("fan/set"),               1,  false,  0,      true,   false },
+    { TOPIC_PATH("command"),                    0,  false,  0,      true,   false },
+    { AUDITORIUM_PATH("bin/set"),               1,  false,  0,      true,   false },
+    { AUDITORIUM_PATH("transaction/set"),       1,  false,  0,      true,   false },
+    { TOPIC_PATH("sensors/history/get"),        0,  false,  0,      true,   false },
+    { AUDITORIUM_PATH("lights/get"),            0,  false,  0,      true,   false },
+    { AUDITORIUM_PATH("fan/get"),               0,  false,  0,      true,   false },
+    { TOPIC_PATH("sensors/get"),                0,  false,  0,      true,   false },
+    { TOPIC_PATH("system/memory/get"),          0,  false,  0,      true,   false },
+    { TOPIC_PATH("wifi/get"),                   0,  false,  0,      true,   false },
+    { TOPIC_PATH("system/audit/get"),           0,  false,  0,      true,   false },
+    { TOPIC_PATH("state/sync"),                 0,  false,  0,      true,   false },
+};
+
+static_assert(sizeof(TOPICS) / sizeof(TOPICS[0]) == TOPIC_COUNT, "TOPICS debe cubrir todos los TopicId");
+
+constexpr const char* topic_path(TopicId id) {
+    return TOPICS[id].path;
+}
+
+// Topic de estado / comando de una zona (1-4)
+constexpr TopicId light_state_topic(int zone) {
+    return (TopicId)(TOPIC_LIGHT_1_STATE + zone - 1);
+}
+
+constexpr TopicId light_set_topic(int zone) {
+    return (TopicId)(TOPIC_LIGHT_1_SET + zone - 1);
+}
+
+// Busca un topic de entrada por su ruta. Devuelve TOPIC_INVALID si no está registrado.
+TopicId topic_lookup_inbound(const char* path);
+
+#endif // TOPICS_H
@@ -0,0 +1,69 @@
+// include/udp_control.h
+#ifndef UDP_CONTROL_H
+#define UDP_CONTROL_H
+
+#include <Arduino.h>
+
+// ============================
+// Control local por UDP (sin pasar por el broker)
+// ============================
+// Acepta los mismos comandos que los topics .../set en la LAN, en el puerto
+// UDP_CONTROL_PORT, y los entrega a la tarea de control igual que MQTT. Cada
+// datagrama va firmado con HMAC-SHA256 (clave compartida UDP_CONTROL_KEY) y
+// lleva la sesión del arranque actual y un número de secuencia: lo repetido o
+// demasiado antiguo se rechaza. La respuesta es un único datagrama firmado con
+// el estado de los relés después de atender el comando.
+//
+// Petición (enteros en little-endian):
+//   [0]      magic        UDP_CONTROL_MAGIC
+//   [1]      version      UDP_CONTROL_VERSION
+//   [2]      topic_len    longitud de la ruta (0 = solo consultar el estado)
+//   [3]      reservado    0
+//   [4..7]   session      sesión del dispositivo (0 = aún no se conoce)
+//   [8..11]  seq          secuencia del cliente dentro de la sesión (> 0)
+//   [12..]   ruta del topic sin el prefijo ("auditorium/lights/1/set") + payload
+//   [n-32..] HMAC-SHA256 de todo lo anterior
+//
+// Respuesta:
+//   [0]      magic        UDP_CONTROL_MAGIC
+//   [1]      version      UDP_CONTROL_VERSION
+//   [2]      status       UdpAckStatus
+//   [3]      zone mask    bit i = zona i+1 encendida
+//   [4]      fan          bit 0 encendido, bit 1 modo automático
+//   [5]      pending      1 = quedan conmutaciones retrasadas (intervalo mínimo o escena en curso)
+//   [6..7]   reservado    0
+//   [8..11]  session      sesión actual (el cliente la adopta y reinicia seq)
+//   [12..15] seq          la de la petición
+//   [16..47] HMAC-SHA256 de los 16 bytes anteriores
+// Las peticiones con firma inválida no se responden.
+
+#define UDP_CONTROL_MAGIC      0xC7
+#define UDP_CONTROL_VERSION    1
+#define UDP_CONTROL_HEADER     12
+#define UDP_CONTROL_MAC_SIZE   32
+#define UDP_CONTROL_ACK_SIZE   (16 + UDP_CONTROL_MAC_SIZE)
+
+enum UdpAckStatus : uint8_t {
+    UDP_ACK_OK = 0,          // Consumido por la tarea de control (o consulta de estado)
+    UDP_ACK_QUEUED,          // Encolado; no se atendió antes de UDP_CONTROL_ACK_WAIT_MS
+    UDP_ACK_BAD_SESSION,     // Sesión distinta: usar la de la respuesta con seq desde 1
+    UDP_ACK_REPLAY,          // seq repetida o fuera de la ventana
+    UDP_ACK_BAD_TOPIC,       // Ruta desconocida o que no es un comando
+    UDP_ACK_REJECTED,        // Cola llena o payload demasiado grande
+    UDP_ACK_BAD_FORMAT       // Cabecera o longitudes incoherentes
+};
+
+// Recepción -> confirmación enviada, medido en el dispositivo
+struct UdpControlStats {
+    uint32_t requests;
+    uint32_t rejected;     // Firma, sesión, secuencia, ruta o cola
+    uint32_t avgUs;
+    uint32_t maxUs;
+};
+
+// Abre el socket y arranca la tarea (solo con UDP_CONTROL_ENABLED)
+void udp_control_start();
+
+UdpControlStats udp_control_get_stats();
+
+#endif // UDP_CONTROL_H
@@ -2,24 +2,48 @@
 #define WIFI_MANAGER_H
 
 #include <WiFi.h>
-#include <string>
 
-// Inicializa la conexión WiFi (llamar una vez desde setup o una tarea)
+// Callback de cambio de estado (se llama desde la tarea de eventos WiFi)
+typedef void (*wifi_state_callback_t)(bool connected);
+
+// Tiempos de conexión medidos por el gestor
+struct WifiConnectStats {
+    uint32_t coldBootMs;       // Desde wifi_init() hasta obtener IP (0 = aún no)
+    uint32_t lastReassocMs;    // Desde la última caída hasta obtener IP (0 = nunca)
+    uint32_t reconnectCount;   // Reasociaciones completadas tras una caída
+    bool fastConnect;          // La última conexión usó BSSID/canal cacheados
+};
+
+// Estado WiFi cacheado: se actualiza solo con eventos WiFi (y el RSSI al muestrearlo)
+struct WifiSnapshot {
+    bool connected;
+    char ssid[33];
+    char ip[16];
+    char mac[18];              // Leída una sola vez al arrancar
+    int rssi;                  // dBm, suavizado
+    uint32_t identityVersion;  // Cambia con conexión, desconexión, SSID o IP
+};
+
+// Inicializa la conexión WiFi (no bloquea: la conexión avanza por eventos)
 void wifi_init();
 
+// Registra un callback para conexión (IP obtenida) / desconexión
+void wifi_register_state_callback(wifi_state_callback_t callback);
+
 // Devuelve true si estamos conectados al WiFi
 bool wifi_is_connected();
 
-// Devuelve el SSID actual
-std::string wifi_get_ssid();
+// Avisa de un fallo de conexión al broker. Si la conexión actual usa la IP
+// cacheada (WIFI_CACHE_IP_ENABLED), se descarta y se reasocia por DHCP.
+void wifi_report_broker_unreachable();
 
-// Devuelve la dirección IP local
-std::string wifi_get_ip();
+// Devuelve los tiempos de conexión medidos
+WifiConnectStats wifi_get_connect_stats();
 
-// Devuelve la dirección MAC
-std::string wifi_get_mac();
+// Copia del estado WiFi cacheado (sin llamadas al driver ni reservas de memoria)
+WifiSnapshot wifi_get_snapshot();
 
-// Devuelve el nivel de señal (RSSI)
-int wifi_get_rssi();
+// Toma una muestra de RSSI y actualiza el valor suavizado del snapshot
+void wifi_sample_rssi();
 
 #endif // WIFI_MANAGER_H
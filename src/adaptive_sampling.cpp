@@ -0,0 +1,130 @@
+// src/adaptive_sampling.cpp
+#include "adaptive_sampling.h"
+#include "serial_log.h"
+#include "config.h"
+
+// Suavizado de media y desviación: alfa = 1/ADAPTIVE_SMOOTHING
+#define ADAPTIVE_SMOOTHING  4
+
+struct ChannelState {
+    SamplingBounds bounds;
+    ChannelSample last;
+    int32_t meanX16;               // Media exponencial * 16
+    int32_t deviationX16;          // Desviación media absoluta * 16
+    uint32_t windowStartMs;        // Apertura de la ventana de velocidad
+    int32_t windowMeanX16;         // Media suavizada al abrirla
+    TaskHandle_t reporter;
+};
+
+static const char* CHANNEL_LABELS[SENSOR_CHANNEL_COUNT] = {"temperature", "ldr"};
+
+static portMUX_TYPE samplingMux = portMUX_INITIALIZER_UNLOCKED;
+static ChannelState channels[SENSOR_CHANNEL_COUNT];
+
+void adaptive_sampling_init() {
+    memset(channels, 0, sizeof(channels));
+
+    channels[SENSOR_CHANNEL_TEMPERATURE].bounds = {
+        TEMP_SAMPLE_MIN_MS, TEMP_SAMPLE_MAX_MS, TEMP_ACTIVITY_WINDOW_MS, TEMP_ACTIVITY_RATE, TEMP_ACTIVITY_DEVIATION
+    };
+    channels[SENSOR_CHANNEL_LDR].bounds = {
+        LDR_SAMPLE_MIN_MS, LDR_SAMPLE_MAX_MS, LDR_ACTIVITY_WINDOW_MS, LDR_ACTIVITY_RATE, LDR_ACTIVITY_DEVIATION
+    };
+
+    // Se arranca rápido: hasta tener media no se sabe si la señal está plana
+    for (int i = 0; i < SENSOR_CHANNEL_COUNT; i++) {
+        channels[i].last.intervalMs = channels[i].bounds.minIntervalMs;
+    }
+}
+
+bool adaptive_sampling_due(SensorChannel channel, uint32_t nowMs) {
+    if (channel >= SENSOR_CHANNEL_COUNT) return false;
+    const ChannelSample &last = channels[channel].last;
+    return last.samples == 0 || nowMs - last.timestampMs >= last.intervalMs;
+}
+
+uint32_t adaptive_sampling_update(SensorChannel channel, uint32_t nowMs, int16_t value, uint16_t raw) {
+    if (channel >= SENSOR_CHANNEL_COUNT) return 0;
+    ChannelState &ch = channels[channel];
+
+    // Media y desviación media absoluta en punto fijo
+    int32_t valueX16 = (int32_t)value * 16;
+    uint32_t rate = ch.last.rate;
+    if (ch.last.samples == 0) {
+        ch.meanX16 = valueX16;
+        ch.deviationX16 = 0;
+        ch.windowStartMs = nowMs;
+        ch.windowMeanX16 = valueX16;
+        rate = 0;
+    } else {
+        ch.meanX16 += (valueX16 - ch.meanX16) / ADAPTIVE_SMOOTHING;
+        ch.deviationX16 += (abs(valueX16 - ch.meanX16) - ch.deviationX16) / ADAPTIVE_SMOOTHING;
+    }
+    uint16_t deviation = (uint16_t)(ch.deviationX16 / 16);
+
+    // Velocidad de cambio de la media en la ventana que se cierra (unidades/s);
+    // entre cierres vale la de la ventana anterior
+    uint32_t windowMs = nowMs - ch.windowStartMs;
+    if (ch.last.samples > 0 && windowMs >= ch.bounds.rateWindowMs) {
+        rate = (uint32_t)abs(ch.meanX16 - ch.windowMeanX16) * 1000UL / (16UL * windowMs);
+        if (rate > 0xFFFF) rate = 0xFFFF;
+        ch.windowStartMs = nowMs;
+        ch.windowMeanX16 = ch.meanX16;
+    }
+
+    bool active = rate >= ch.bounds.rateThreshold || deviation >= ch.bounds.deviationThreshold;
+    bool becameActive = active && !ch.last.active;
+
+    // Subida inmediata al mínimo; bajada gradual (x2) hacia el máximo
+    uint32_t interval = ch.last.intervalMs;
+    if (active) {
+        interval = ch.bounds.minIntervalMs;
+    } else {
+        interval *= 2;
+        if (interval > ch.bounds.maxIntervalMs) interval = ch.bounds.maxIntervalMs;
+    }
+
+    portENTER_CRITICAL(&samplingMux);
+    ch.last.value = value;
+    ch.last.raw = raw;
+    ch.last.timestampMs = nowMs;
+    ch.last.intervalMs = interval;
+    ch.last.rate = (uint16_t)rate;
+    ch.last.deviation = deviation;
+    ch.last.active = active;
+    ch.last.samples++;
+    portEXIT_CRITICAL(&samplingMux);
+
+    if (becameActive) {
+        serial_printf("[SAMPLING] %s activo (%lu/s, desv. %u): muestreo cada %lu ms\n",
+                      CHANNEL_LABELS[channel], (unsigned long)rate, deviation, (unsigned long)interval);
+        if (ch.reporter != NULL) xTaskNotifyGive(ch.reporter);
+    }
+    return interval;
+}
+
+uint32_t adaptive_sampling_next_due_in(uint32_t nowMs) {
+    uint32_t wait = 0xFFFFFFFFUL;
+    for (int i = 0; i < SENSOR_CHANNEL_COUNT; i++) {
+        const ChannelSample &last = channels[i].last;
+        if (last.samples == 0) return 0;
+        uint32_t elapsed = nowMs - last.timestampMs;
+        uint32_t remaining = elapsed >= last.intervalMs ? 0 : last.intervalMs - elapsed;
+        if (remaining < wait) wait = remaining;
+    }
+    return wait;
+}
+
+ChannelSample adaptive_sampling_get(SensorChannel channel) {
+    ChannelSample copy = {};
+    if (channel >= SENSOR_CHANNEL_COUNT) return copy;
+    portENTER_CRITICAL(&samplingMux);
+    copy = channels[channel].last;
+    portEXIT_CRITICAL(&samplingMux);
+    return copy;
+}
+
+void adaptive_sampling_set_reporter(SensorChannel channel, TaskHandle_t task) {
+    if (channel >= SENSOR_CHANNEL_COUNT) return;
+    channels[channel].reporter = task;
+}
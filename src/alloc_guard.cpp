@@ -0,0 +1,81 @@
+// src/alloc_guard.cpp
+#include "alloc_guard.h"
+#include "config.h"
+
+#if STATIC_ALLOCATION_MODE
+
+#include "task_plan.h"
+
+static volatile bool armed = false;
+static portMUX_TYPE guardMux = portMUX_INITIALIZER_UNLOCKED;
+static AllocGuardStats stats = {false, 0, 0, "", 0};
+
+extern "C" {
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+}
+
+// Se ejecuta dentro de malloc: nada de Serial ni de nuevas reservas
+static void record_allocation(size_t size) {
+    if (!armed || size == 0 || xPortInIsrContext()) return;
+    if (!task_plan_heap_guarded(xTaskGetCurrentTaskHandle())) return;
+
+    portENTER_CRITICAL(&guardMux);
+    if (stats.allocations == 0) {
+        strncpy(stats.firstTask, pcTaskGetTaskName(NULL), sizeof(stats.firstTask) - 1);
+        stats.firstSize = size;
+    }
+    stats.allocations++;
+    stats.bytes += size;
+    portEXIT_CRITICAL(&guardMux);
+
+#if ALLOC_GUARD_STRICT
+    // El backtrace del abort señala la línea que reservó
+    abort();
+#endif
+}
+
+extern "C" {
+
+void* __wrap_malloc(size_t size) {
+    record_allocation(size);
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size) {
+    record_allocation(count * size);
+    return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void* ptr, size_t size) {
+    record_allocation(size);
+    return __real_realloc(ptr, size);
+}
+
+}
+
+void alloc_guard_arm() {
+    armed = true;
+    stats.armed = true;
+    Serial.println("[ALLOC] Vigilancia de heap activa: no se esperan reservas desde las tareas vigiladas");
+}
+
+AllocGuardStats alloc_guard_get_stats() {
+    portENTER_CRITICAL(&guardMux);
+    AllocGuardStats copy = stats;
+    portEXIT_CRITICAL(&guardMux);
+    return copy;
+}
+
+#else
+
+void alloc_guard_arm() {
+}
+
+AllocGuardStats alloc_guard_get_stats() {
+    AllocGuardStats empty = {false, 0, 0, "", 0};
+    return empty;
+}
+
+#endif // STATIC_ALLOCATION_MODE
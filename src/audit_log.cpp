@@ -0,0 +1,537 @@
+// src/audit_log.cpp
+#include "audit_log.h"
+#include "serial_log.h"
+#include "mqtt_client.h"
+#include "task_plan.h"
+#include "config.h"
+#include <ArduinoJson.h>
+#include <SPIFFS.h>
+#include <time.h>
+#include <rom/crc.h>
+
+#define AUDIT_FILE_PREFIX       "audit_"
+#define AUDIT_PATH_MAX          24
+#define AUDIT_CHUNK_MAX_BYTES   HISTORY_CHUNK_MAX_BYTES   // Mismo límite que las respuestas del histórico
+#define AUDIT_READ_BATCH        32                        // Registros por lectura al recorrer un segmento
+#define AUDIT_TIME_VALID_AFTER  1600000000UL              // Antes de esto el reloj no está sincronizado
+#define AUDIT_FLAG_TIME_APPROX  0x01                      // Hora heredada del registro anterior (sin SNTP)
+
+// Registro en flash: tamaño fijo, CRC16 al final
+struct AuditRecord {
+    uint32_t time;       // s UTC, nunca decrece a lo largo del registro
+    uint32_t uptimeMs;   // millis() del cambio
+    uint16_t boot;       // Número de arranque
+    uint8_t source;      // ActuationSource
+    uint8_t target;      // Zona 1-4 o AUDIT_TARGET_*
+    uint8_t state;
+    uint8_t flags;
+    uint16_t crc;
+};
+
+static_assert(sizeof(AuditRecord) == 16, "AuditRecord debe ocupar 16 bytes");
+
+// Cambio anotado en RAM; la hora definitiva se resuelve al escribirlo
+struct PendingEntry {
+    uint32_t epoch;      // 0 = reloj sin sincronizar
+    uint32_t uptimeMs;
+    uint8_t source;
+    uint8_t target;
+    uint8_t state;
+};
+
+// Índice en RAM de los segmentos en flash, del más antiguo al más reciente
+struct SegmentInfo {
+    uint32_t number;
+    uint32_t firstTime;
+    uint32_t lastTime;
+    uint16_t count;
+    bool sealed;         // No admite más registros (lleno o con cola truncada)
+};
+
+struct AuditQuery {
+    bool pending;
+    char id[STATE_QUERY_ID_MAX + 1];
+    uint32_t from;
+    uint32_t to;
+    uint16_t limit;
+};
+
+static const char* SOURCE_NAMES[ACTUATION_SOURCE_COUNT] = { "mqtt", "automation", "scene", "boot" };
+
+const char* actuation_source_name(ActuationSource source) {
+    return source < ACTUATION_SOURCE_COUNT ? SOURCE_NAMES[source] : "?";
+}
+
+static portMUX_TYPE auditMux = portMUX_INITIALIZER_UNLOCKED;
+static PendingEntry pending[AUDIT_BUFFER_RECORDS];
+static uint16_t pendingHead = 0;
+static uint16_t pendingCount = 0;
+static uint32_t droppedCount = 0;      // Cambios perdidos por RAM llena
+static uint32_t droppedReported = 0;
+static AuditQuery query = {};
+
+// Solo los toca la tarea del registro (tras audit_log_start)
+static SegmentInfo segments[AUDIT_MAX_SEGMENTS];
+static uint8_t segmentCount = 0;
+static uint32_t lastTime = 0;
+static uint16_t bootNumber = 0;
+static File activeFile;
+static TaskHandle_t auditTaskHandle = NULL;
+static char chunkBuffer[AUDIT_CHUNK_MAX_BYTES];
+
+static uint16_t record_crc(const AuditRecord &record) {
+    return crc16_le(0, (const uint8_t*)&record, offsetof(AuditRecord, crc));
+}
+
+static void segment_path(uint32_t number, char* path, size_t size) {
+    snprintf(path, size, "/" AUDIT_FILE_PREFIX "%06lu", (unsigned long)number);
+}
+
+static bool read_record(File &file, uint16_t index, AuditRecord &record) {
+    return file.seek((uint32_t)index * sizeof(AuditRecord)) &&
+           file.read((uint8_t*)&record, sizeof(record)) == sizeof(record);
+}
+
+// ============================
+// ANOTACIÓN (cualquier tarea)
+// ============================
+void audit_log_record(ActuationSource source, uint8_t target, bool state) {
+    time_t now = time(NULL);
+    PendingEntry entry;
+    entry.epoch = (uint32_t)now >= AUDIT_TIME_VALID_AFTER ? (uint32_t)now : 0;
+    entry.uptimeMs = millis();
+    entry.source = source;
+    entry.target = target;
+    entry.state = state ? 1 : 0;
+
+    portENTER_CRITICAL(&auditMux);
+    if (pendingCount == AUDIT_BUFFER_RECORDS) {
+        // Flash ocupada o sin montar: se pierde el más antiguo, no el último cambio
+        pendingHead = (pendingHead + 1) % AUDIT_BUFFER_RECORDS;
+        pendingCount--;
+        droppedCount++;
+    }
+    pending[(pendingHead + pendingCount) % AUDIT_BUFFER_RECORDS] = entry;
+    pendingCount++;
+    bool batchReady = pendingCount >= AUDIT_BATCH_RECORDS;
+    portEXIT_CRITICAL(&auditMux);
+
+    if (batchReady && auditTaskHandle != NULL) {
+        xTaskNotifyGive(auditTaskHandle);
+    }
+}
+
+// ============================
+// SEGMENTOS
+// ============================
+
+// Abre un segmento nuevo al final; si ya hay AUDIT_MAX_SEGMENTS se borra el más antiguo
+static bool open_new_segment() {
+    char path[AUDIT_PATH_MAX];
+    if (activeFile) activeFile.close();
+
+    if (segmentCount == AUDIT_MAX_SEGMENTS) {
+        segment_path(segments[0].number, path, sizeof(path));
+        SPIFFS.remove(path);
+        memmove(&segments[0], &segments[1], sizeof(SegmentInfo) * (segmentCount - 1));
+        segmentCount--;
+    }
+
+    uint32_t number = segmentCount > 0 ? segments[segmentCount - 1].number + 1 : 0;
+    segment_path(number, path, sizeof(path));
+    activeFile = SPIFFS.open(path, FILE_WRITE);
+    if (!activeFile) {
+        serial_printf("[AUDIT] ✗ No se pudo crear %s\n", path);
+        return false;
+    }
+
+    SegmentInfo &segment = segments[segmentCount++];
+    segment.number = number;
+    segment.firstTime = 0;
+    segment.lastTime = 0;
+    segment.count = 0;
+    segment.sealed = false;
+    return true;
+}
+
+static bool ensure_active_segment() {
+    if (segmentCount == 0 || segments[segmentCount - 1].sealed ||
+        segments[segmentCount - 1].count >= AUDIT_SEGMENT_RECORDS) {
+        return open_new_segment();
+    }
+    if (!activeFile) {
+        char path[AUDIT_PATH_MAX];
+        segment_path(segments[segmentCount - 1].number, path, sizeof(path));
+        activeFile = SPIFFS.open(path, FILE_APPEND);
+    }
+    return (bool)activeFile;
+}
+
+// Escribe registros consecutivos, partiendo el lote si cruza el final de un segmento
+static void write_records(const AuditRecord* records, uint16_t count) {
+    while (count > 0) {
+        if (!ensure_active_segment()) return;
+
+        SegmentInfo &segment = segments[segmentCount - 1];
+        uint16_t room = AUDIT_SEGMENT_RECORDS - segment.count;
+        uint16_t n = count < room ? count : room;
+        size_t bytes = (size_t)n * sizeof(AuditRecord);
+
+        size_t written = activeFile.write((const uint8_t*)records, bytes);
+        activeFile.flush();
+        if (written != bytes) {
+            // Un registro a medias desalinearía el resto: se cierra el segmento
+            serial_printf("[AUDIT] ✗ Escritura incompleta (%u de %u bytes)\n",
+                          (unsigned)written, (unsigned)bytes);
+            segment.count += written / sizeof(AuditRecord);
+            segment.sealed = true;
+            activeFile.close();
+            return;
+        }
+
+        if (segment.count == 0) segment.firstTime = records[0].time;
+        segment.lastTime = records[n - 1].time;
+        segment.count += n;
+        records += n;
+        count -= n;
+    }
+}
+
+// Vacía la RAM en flash por lotes de AUDIT_BATCH_RECORDS
+static void flush_pending() {
+    PendingEntry entries[AUDIT_BATCH_RECORDS];
+    AuditRecord records[AUDIT_BATCH_RECORDS];
+    uint32_t written = 0;
+
+    while (true) {
+        uint16_t n = 0;
+        portENTER_CRITICAL(&auditMux);
+        while (n < AUDIT_BATCH_RECORDS && pendingCount > 0) {
+            entries[n++] = pending[pendingHead];
+            pendingHead = (pendingHead + 1) % AUDIT_BUFFER_RECORDS;
+            pendingCount--;
+        }
+        uint32_t dropped = droppedCount;
+        portEXIT_CRITICAL(&auditMux);
+
+        if (dropped != droppedReported) {
+            serial_printf("[AUDIT] ⚠ %lu cambios descartados por memoria llena\n",
+                          (unsigned long)(dropped - droppedReported));
+            droppedReported = dropped;
+        }
+        if (n == 0) break;
+
+        for (uint16_t i = 0; i < n; i++) {
+            AuditRecord &record = records[i];
+            // Hora monótona: sin reloj (o si retrocede) se hereda la anterior marcada como aproximada
+            record.flags = 0;
+            record.time = entries[i].epoch;
+            if (record.time < lastTime) {
+                record.time = lastTime;
+                record.flags |= AUDIT_FLAG_TIME_APPROX;
+            }
+            lastTime = record.time;
+            record.uptimeMs = entries[i].uptimeMs;
+            record.boot = bootNumber;
+            record.source = entries[i].source;
+            record.target = entries[i].target;
+            record.state = entries[i].state;
+            record.crc = record_crc(record);
+        }
+        write_records(records, n);
+        written += n;
+    }
+
+    if (written > 0) {
+        serial_printf("[AUDIT] ✓ %lu cambios escritos en flash\n", (unsigned long)written);
+    }
+}
+
+// Reconstruye el índice a partir de los ficheros audit_* existentes
+static void load_segments() {
+    File root = SPIFFS.open("/");
+    if (!root) return;
+
+    for (File file = root.openNextFile(); file; file = root.openNextFile()) {
+        const char* name = file.name();
+        if (name[0] == '/') name++;   // Según la versión del core el nombre lleva o no la barra
+        if (strncmp(name, AUDIT_FILE_PREFIX, strlen(AUDIT_FILE_PREFIX)) != 0) continue;
+
+        SegmentInfo segment = {};
+        segment.number = strtoul(name + strlen(AUDIT_FILE_PREFIX), NULL, 10);
+        size_t size = file.size();
+        segment.count = size / sizeof(AuditRecord);
+        segment.sealed = (size % sizeof(AuditRecord)) != 0;   // Corte de alimentación a mitad de lote
+
+        AuditRecord record;
+        if (segment.count > 0 && read_record(file, 0, record)) {
+            segment.firstTime = record.time;
+        }
+        if (segment.count > 0 && read_record(file, segment.count - 1, record)) {
+            segment.lastTime = record.time;
+        }
+        file.close();
+
+        // Inserción ordenada por número; si sobran segmentos se borra el más antiguo
+        uint8_t pos = segmentCount;
+        while (pos > 0 && segments[pos - 1].number > segment.number) pos--;
+        if (segmentCount == AUDIT_MAX_SEGMENTS) {
+            char path[AUDIT_PATH_MAX];
+            if (pos == 0) {
+                segment_path(segment.number, path, sizeof(path));
+                SPIFFS.remove(path);
+                continue;
+            }
+            segment_path(segments[0].number, path, sizeof(path));
+            SPIFFS.remove(path);
+            memmove(&segments[0], &segments[1], sizeof(SegmentInfo) * (pos - 1));
+            segments[pos - 1] = segment;
+        } else {
+            memmove(&segments[pos + 1], &segments[pos], sizeof(SegmentInfo) * (segmentCount - pos));
+            segments[pos] = segment;
+            segmentCount++;
+        }
+    }
+    root.close();
+
+    // El arranque y la hora continúan desde el último registro escrito
+    for (int8_t i = segmentCount - 1; i >= 0; i--) {
+        if (segments[i].count == 0) continue;
+        char path[AUDIT_PATH_MAX];
+        segment_path(segments[i].number, path, sizeof(path));
+        File file = SPIFFS.open(path, FILE_READ);
+        AuditRecord record;
+        if (file && read_record(file, segments[i].count - 1, record)) {
+            bootNumber = record.boot + 1;
+            lastTime = record.time;
+        }
+        file.close();
+        break;
+    }
+}
+
+// ============================
+// CONSULTAS
+// ============================
+
+// Primer registro con time >= from (búsqueda binaria: O(log n) lecturas)
+static uint16_t lower_bound(File &file, uint16_t count, uint32_t from) {
+    uint16_t low = 0;
+    uint16_t high = count;
+    AuditRecord record;
+    while (low < high) {
+        uint16_t mid = low + (high - low) / 2;
+        if (!read_record(file, mid, record)) return count;
+        if (record.time < from) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+static size_t chunkLength = 0;
+static uint16_t chunkRows = 0;
+static uint16_t chunkIndex = 0;
+
+static void chunk_begin(const char* id, uint16_t index) {
+    int n = snprintf(chunkBuffer, sizeof(chunkBuffer),
+                     "{\"id\":\"%s\",\"boot\":%u,\"chunk\":%u,"
+                     "\"fields\":[\"t\",\"boot\",\"up_ms\",\"src\",\"target\",\"on\",\"approx\"],\"rows\":[",
+                     id, bootNumber, index);
+    chunkLength = (size_t)n;
+    chunkRows = 0;
+}
+
+// Espacio reservado para el cierre:
+// ],"last":false,"truncated":false,"aborted":false,"chunks":65535,"total":4294967295}
+#define CHUNK_FOOTER_RESERVE  96
+
+static bool chunk_append(const char* row, size_t rowLen) {
+    size_t needed = rowLen + (chunkRows > 0 ? 1 : 0);
+    if (chunkLength + needed + CHUNK_FOOTER_RESERVE > sizeof(chunkBuffer)) return false;
+
+    if (chunkRows > 0) chunkBuffer[chunkLength++] = ',';
+    memcpy(chunkBuffer + chunkLength, row, rowLen);
+    chunkLength += rowLen;
+    chunkRows++;
+    return true;
+}
+
+// El topic de datos no es prioritario: con la cola de salida llena mqtt_publish
+// descarta. Se reintenta con espera creciente mientras haya conexión.
+static bool chunk_publish() {
+    for (uint8_t attempt = 0; attempt <= AUDIT_CHUNK_RETRIES; attempt++) {
+        if (attempt > 0) vTaskDelay(pdMS_TO_TICKS(AUDIT_CHUNK_RETRY_MS * attempt));
+        if (mqtt_publish(TOPIC_AUDIT_DATA, (const uint8_t*)chunkBuffer, chunkLength)) return true;
+        if (!mqtt_is_connected()) return false;
+    }
+    return false;
+}
+
+// Cierra y publica el trozo. El último lleva cuántos trozos y filas se
+// enviaron: quien consulta detecta un hueco en "chunk" aunque falle el cierre.
+static bool chunk_send(bool last, bool truncated, bool aborted, uint32_t total) {
+    int n;
+    if (last) {
+        n = snprintf(chunkBuffer + chunkLength, sizeof(chunkBuffer) - chunkLength,
+                     "],\"last\":true,\"truncated\":%s,\"aborted\":%s,\"chunks\":%u,\"total\":%lu}",
+                     truncated ? "true" : "false", aborted ? "true" : "false",
+                     chunkIndex + 1, (unsigned long)total);
+    } else {
+        n = snprintf(chunkBuffer + chunkLength, sizeof(chunkBuffer) - chunkLength,
+                     "],\"last\":false,\"truncated\":false}");
+    }
+    chunkLength += n;
+    return chunk_publish();
+}
+
+static void run_query(const AuditQuery &q) {
+    uint32_t rows = 0;
+    uint32_t sent = 0;          // Filas de los trozos ya publicados
+    bool truncated = false;
+    bool aborted = false;
+    bool done = false;
+    char row[64];
+    AuditRecord batch[AUDIT_READ_BATCH];
+
+    chunkIndex = 0;
+    chunk_begin(q.id, chunkIndex);
+
+    for (uint8_t s = 0; s < segmentCount && !done; s++) {
+        const SegmentInfo &segment = segments[s];
+        // El índice descarta los segmentos fuera de rango sin abrirlos
+        if (segment.count == 0 || segment.lastTime < q.from) continue;
+        if (segment.firstTime > q.to) break;
+
+        char path[AUDIT_PATH_MAX];
+        segment_path(segment.number, path, sizeof(path));
+        File file = SPIFFS.open(path, FILE_READ);
+        if (!file) continue;
+
+        uint16_t index = lower_bound(file, segment.count, q.from);
+        while (index < segment.count && !done) {
+            uint16_t n = segment.count - index;
+            if (n > AUDIT_READ_BATCH) n = AUDIT_READ_BATCH;
+            file.seek((uint32_t)index * sizeof(AuditRecord));
+            size_t got = file.read((uint8_t*)batch, n * sizeof(AuditRecord)) / sizeof(AuditRecord);
+            if (got == 0) break;
+
+            for (size_t i = 0; i < got; i++) {
+                const AuditRecord &r = batch[i];
+                if (r.crc != record_crc(r)) continue;
+                if (r.time > q.to) { done = true; break; }
+                if (rows >= q.limit) { truncated = true; done = true; break; }
+
+                size_t rowLen = snprintf(row, sizeof(row), "[%lu,%u,%lu,\"%s\",%u,%u,%u]",
+                                         (unsigned long)r.time, r.boot, (unsigned long)r.uptimeMs,
+                                         actuation_source_name((ActuationSource)r.source),
+                                         r.target, r.state, (r.flags & AUDIT_FLAG_TIME_APPROX) ? 1 : 0);
+                if (!chunk_append(row, rowLen)) {
+                    uint16_t chunkRowsSent = chunkRows;
+                    if (!chunk_send(false, false, false, 0)) {
+                        // Se corta la consulta: el cierre (sin las filas perdidas) lo indica
+                        aborted = true;
+                        done = true;
+                        break;
+                    }
+                    sent += chunkRowsSent;
+                    vTaskDelay(pdMS_TO_TICKS(AUDIT_CHUNK_PACE_MS));
+                    chunk_begin(q.id, ++chunkIndex);
+                    chunk_append(row, rowLen);
+                }
+                rows++;
+            }
+            index += got;
+        }
+        file.close();
+    }
+
+    if (aborted) chunk_begin(q.id, ++chunkIndex);   // Cierre vacío tras el trozo perdido
+    sent += chunkRows;
+    if (!chunk_send(true, truncated, aborted, sent)) {
+        serial_printf("[AUDIT] ✗ Consulta '%s': no se pudo enviar el cierre (trozo %u)\n", q.id, chunkIndex);
+        return;
+    }
+    if (aborted) {
+        serial_printf("[AUDIT] ✗ Consulta '%s' cortada: cola de salida llena (%lu registros enviados)\n",
+                      q.id, (unsigned long)sent);
+        return;
+    }
+    serial_printf("[AUDIT] ✓ Consulta '%s': %lu registros en %u trozos%s\n",
+                  q.id, (unsigned long)sent, chunkIndex + 1, truncated ? " (truncada)" : "");
+}
+
+void handle_audit_query(const uint8_t* payload, unsigned int length) {
+    StaticJsonDocument<192> doc;
+    if (deserializeJson(doc, payload, length)) {
+        Serial.println("[AUDIT] ✗ Consulta con JSON inválido");
+        return;
+    }
+
+    AuditQuery q = {};
+    // El id se devuelve tal cual: se descartan caracteres que romperían el JSON
+    const char* rawId = doc["id"] | "";
+    size_t idLen = 0;
+    for (const char* p = rawId; *p && idLen < STATE_QUERY_ID_MAX; p++) {
+        if (*p != '"' && *p != '\\' && (uint8_t)*p >= 0x20) q.id[idLen++] = *p;
+    }
+    q.id[idLen] = '\0';
+    q.from = doc["from"] | 0UL;
+    q.to = doc["to"] | 0xFFFFFFFFUL;
+    uint32_t limit = doc["limit"] | (uint32_t)AUDIT_QUERY_MAX_ROWS;
+    q.limit = limit < AUDIT_QUERY_MAX_ROWS ? limit : AUDIT_QUERY_MAX_ROWS;
+    q.pending = true;
+
+    if (auditTaskHandle == NULL) {
+        Serial.println("[AUDIT] ✗ Registro no disponible (SPIFFS sin montar)");
+        return;
+    }
+
+    // Una consulta nueva sustituye a la que aún no se haya empezado
+    portENTER_CRITICAL(&auditMux);
+    query = q;
+    portEXIT_CRITICAL(&auditMux);
+    xTaskNotifyGive(auditTaskHandle);
+}
+
+// ============================
+// TAREA
+// ============================
+static void auditLogTask(void *parameter) {
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(AUDIT_FLUSH_INTERVAL_MS));
+
+        // Antes de cada consulta se vacía la RAM para que incluya lo último
+        flush_pending();
+
+        portENTER_CRITICAL(&auditMux);
+        AuditQuery q = query;
+        query.pending = false;
+        portEXIT_CRITICAL(&auditMux);
+
+        if (q.pending) run_query(q);
+    }
+}
+
+void audit_log_start() {
+    // Hora UTC por SNTP; hasta que llegue los registros heredan la última conocida
+    configTime(0, 0, AUDIT_NTP_SERVER);
+
+    if (!SPIFFS.begin(true)) {
+        Serial.println("[AUDIT] ✗ No se pudo montar SPIFFS, los cambios no se guardarán");
+        return;
+    }
+
+    load_segments();
+    uint32_t stored = 0;
+    for (uint8_t i = 0; i < segmentCount; i++) stored += segments[i].count;
+    serial_printf("[AUDIT] ✓ Registro de actuaciones: %lu cambios en %u segmentos, arranque #%u\n",
+                  (unsigned long)stored, segmentCount, bootNumber);
+
+    task_plan_start(TASK_ROLE_AUDIT_LOG, auditLogTask, NULL, &auditTaskHandle);
+
+    // Los cambios anotados durante el arranque se escriben ya
+    if (auditTaskHandle != NULL) xTaskNotifyGive(auditTaskHandle);
+}
@@ -0,0 +1,114 @@
+// src/binary_command.cpp
+#include "binary_command.h"
+#include "serial_log.h"
+#include "light_controller.h"
+#include "mqtt_client.h"
+#include "config.h"
+
+static const char* PARSE_ERRORS[] = {
+    "ok", "longitud", "magic", "opcode", "máscara", "ventilador"
+};
+
+// Último seq aceptado (se descartan duplicados y tramas atrasadas)
+static uint32_t lastSeq = 0;
+static bool haveSeq = false;
+
+BinaryParseResult binary_command_parse(const uint8_t* buffer, size_t length, BinaryCommand &out) {
+    if (buffer == NULL || length != BINARY_COMMAND_SIZE) return BIN_PARSE_BAD_LENGTH;
+    if (buffer[0] != BINARY_COMMAND_MAGIC) return BIN_PARSE_BAD_MAGIC;
+
+    uint8_t opcode = buffer[1];
+    if (opcode < BIN_OP_SET_MASK || opcode > BIN_OP_FAN_ONLY) return BIN_PARSE_BAD_OPCODE;
+
+    uint8_t mask = buffer[2];
+    if (mask & 0xF0) return BIN_PARSE_BAD_MASK;
+
+    uint8_t fan = buffer[3];
+    if (fan > BIN_FAN_TOGGLE && fan != BIN_FAN_UNCHANGED) return BIN_PARSE_BAD_FAN;
+
+    out.opcode = opcode;
+    out.zoneMask = mask;
+    out.fan = fan;
+    out.seq = (uint32_t)buffer[4] | ((uint32_t)buffer[5] << 8) |
+              ((uint32_t)buffer[6] << 16) | ((uint32_t)buffer[7] << 24);
+    return BIN_PARSE_OK;
+}
+
+void binary_command_encode(const BinaryCommand &command, uint8_t* buffer) {
+    buffer[0] = BINARY_COMMAND_MAGIC;
+    buffer[1] = command.opcode;
+    buffer[2] = command.zoneMask;
+    buffer[3] = command.fan;
+    buffer[4] = command.seq & 0xFF;
+    buffer[5] = (command.seq >> 8) & 0xFF;
+    buffer[6] = (command.seq >> 16) & 0xFF;
+    buffer[7] = (command.seq >> 24) & 0xFF;
+}
+
+static void publish_binary_state(uint32_t seq, uint8_t opcode = BIN_OP_STATE) {
+    BinaryCommand state;
+    state.opcode = opcode;
+    state.zoneMask = get_light_mask();
+    state.fan = is_fan_on() ? BIN_FAN_ON : BIN_FAN_OFF;
+    state.seq = seq;
+
+    uint8_t frame[BINARY_COMMAND_SIZE];
+    binary_command_encode(state, frame);
+    mqtt_publish(TOPIC_BINARY_STATE, frame, sizeof(frame));
+}
+
+void handle_binary_command(const uint8_t* payload, unsigned int length, uint8_t preempted) {
+    BinaryCommand command;
+    BinaryParseResult result = binary_command_parse(payload, length, command);
+    if (result != BIN_PARSE_OK) {
+        serial_printf("[BIN_CMD] ✗ Trama inválida (%s)\n", PARSE_ERRORS[result]);
+        return;
+    }
+
+    // Diferencia con signo: tolera el desbordamiento del contador
+    if (haveSeq && (int32_t)(command.seq - lastSeq) <= 0) {
+        serial_printf("[BIN_CMD] Seq %lu repetido o atrasado, se confirma sin aplicar\n",
+                      (unsigned long)command.seq);
+        publish_binary_state(command.seq);
+        return;
+    }
+    lastSeq = command.seq;
+    haveSeq = true;
+
+    // Un urgente posterior anuló parte de la trama: se aplica el resto y se avisa
+    bool lightsPreempted = (preempted & PREEMPT_LIGHTS) && command.opcode != BIN_OP_FAN_ONLY;
+    bool fanPreempted = (preempted & PREEMPT_FAN) && command.fan != BIN_FAN_UNCHANGED;
+    if (lightsPreempted) command.opcode = BIN_OP_FAN_ONLY;
+    if (fanPreempted) command.fan = BIN_FAN_UNCHANGED;
+    if (lightsPreempted || fanPreempted) {
+        serial_printf("[BIN_CMD] Seq %lu anulado por un urgente (%s%s)\n", (unsigned long)command.seq,
+                      lightsPreempted ? "zonas" : "", fanPreempted ? (lightsPreempted ? ", ventilador" : "ventilador") : "");
+    }
+
+    uint8_t current = get_light_mask();
+    uint8_t target = current;
+    switch (command.opcode) {
+        case BIN_OP_SET_MASK:     target = command.zoneMask;            break;
+        case BIN_OP_ZONES_ON:     target = current | command.zoneMask;  break;
+        case BIN_OP_ZONES_OFF:    target = current & ~command.zoneMask; break;
+        case BIN_OP_ZONES_TOGGLE: target = current ^ command.zoneMask;  break;
+        default: break;
+    }
+
+    uint8_t changed = apply_light_mask(target);
+
+    switch (command.fan) {
+        case BIN_FAN_ON:     apply_fan_command(LIGHT_CMD_ON);     break;
+        case BIN_FAN_OFF:    apply_fan_command(LIGHT_CMD_OFF);    break;
+        case BIN_FAN_TOGGLE: apply_fan_command(LIGHT_CMD_TOGGLE); break;
+        default: break;
+    }
+
+    // La confirmación compacta es la única publicación (salvo COMMAND_ACK_MIRROR_TOPICS)
+    publish_binary_state(command.seq, lightsPreempted || fanPreempted ? BIN_OP_PREEMPTED : BIN_OP_STATE);
+    if (!COMMAND_ACK_MIRROR_TOPICS) return;
+    for (int zone = 1; zone <= 4; zone++) {
+        if (changed & (1 << (zone - 1))) publish_light_status(zone);
+    }
+    if (command.fan != BIN_FAN_UNCHANGED) publish_fan_status();
+}
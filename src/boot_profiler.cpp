@@ -0,0 +1,70 @@
+// src/boot_profiler.cpp
+#include "boot_profiler.h"
+#include "serial_log.h"
+#include "wifi_manager.h"
+#include <ArduinoJson.h>
+#include <esp_system.h>
+#include <esp_timer.h>
+
+static const char* PHASE_NAMES[BOOT_PHASE_COUNT] = {
+    "gpio_safe_ms",
+    "setup_done_ms",
+    "wifi_up_ms",
+    "mqtt_up_ms",
+    "command_ready_ms"
+};
+
+// Microsegundos desde el reset en que se alcanzó cada fase (0 = pendiente)
+static int64_t phaseTimes[BOOT_PHASE_COUNT] = {0};
+
+static const char* reset_reason_name(esp_reset_reason_t reason) {
+    switch (reason) {
+        case ESP_RST_POWERON:   return "power_on";
+        case ESP_RST_EXT:       return "external";
+        case ESP_RST_SW:        return "software";
+        case ESP_RST_PANIC:     return "panic";
+        case ESP_RST_INT_WDT:   return "int_watchdog";
+        case ESP_RST_TASK_WDT:  return "task_watchdog";
+        case ESP_RST_WDT:       return "watchdog";
+        case ESP_RST_DEEPSLEEP: return "deep_sleep";
+        case ESP_RST_BROWNOUT:  return "brownout";
+        case ESP_RST_SDIO:      return "sdio";
+        default:                return "unknown";
+    }
+}
+
+static void boot_on_wifi_state(bool connected) {
+    if (connected) {
+        boot_profiler_mark(BOOT_PHASE_WIFI_UP);
+    }
+}
+
+void boot_profiler_init() {
+    wifi_register_state_callback(boot_on_wifi_state);
+}
+
+void boot_profiler_mark(BootPhase phase) {
+    if (phase >= BOOT_PHASE_COUNT || phaseTimes[phase] != 0) return;
+
+    phaseTimes[phase] = esp_timer_get_time();
+    serial_printf("[BOOT] %s = %lu\n", PHASE_NAMES[phase], (unsigned long)boot_profiler_get_ms(phase));
+}
+
+uint32_t boot_profiler_get_ms(BootPhase phase) {
+    if (phase >= BOOT_PHASE_COUNT) return 0;
+    return (uint32_t)(phaseTimes[phase] / 1000);
+}
+
+void generate_boot_json(JsonDocument &doc) {
+    doc["reset_reason"] = reset_reason_name(esp_reset_reason());
+    for (int i = 0; i < BOOT_PHASE_COUNT; i++) {
+        if (phaseTimes[i] != 0) {
+            doc[PHASE_NAMES[i]] = boot_profiler_get_ms((BootPhase)i);
+        } else {
+            doc[PHASE_NAMES[i]] = nullptr;
+        }
+    }
+
+    WifiConnectStats stats = wifi_get_connect_stats();
+    doc["wifi_fast_connect"] = stats.fastConnect;
+}
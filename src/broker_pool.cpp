@@ -0,0 +1,135 @@
+// src/broker_pool.cpp
+#include "broker_pool.h"
+#include "serial_log.h"
+#include "config.h"
+#include <WiFi.h>
+
+struct BrokerHealth {
+    uint8_t consecutiveFailures;
+    uint32_t failures;
+    uint32_t connects;
+    uint32_t cooldownUntil;        // 0 = disponible
+    uint32_t lastConnectedAt;
+};
+
+static const BrokerEndpoint BROKERS[] = MQTT_BROKER_LIST;
+static const uint8_t BROKER_COUNT = sizeof(BROKERS) / sizeof(BROKERS[0]);
+
+static BrokerHealth health[sizeof(BROKERS) / sizeof(BROKERS[0])] = {};
+static uint8_t active = 0;
+
+// Medición de la conmutación (desde la caída o el cambio hasta volver a conectar)
+static uint32_t lostAt = 0;            // 0 = conectado o nunca conectado
+static uint32_t lastFailoverMs = 0;
+static uint32_t failoverCount = 0;
+static uint32_t lastProbeAt = 0;
+
+static bool in_cooldown(uint8_t index, uint32_t nowMs) {
+    uint32_t until = health[index].cooldownUntil;
+    return until != 0 && (int32_t)(nowMs - until) < 0;
+}
+
+// Siguiente broker disponible en orden, empezando por el principal. Si todos
+// están en espera se sigue rotando para no quedarse parado en uno.
+static uint8_t next_available(uint32_t nowMs) {
+    for (uint8_t i = 0; i < BROKER_COUNT; i++) {
+        if (!in_cooldown(i, nowMs)) return i;
+    }
+    return (active + 1) % BROKER_COUNT;
+}
+
+const BrokerEndpoint &broker_pool_active() {
+    return BROKERS[active];
+}
+
+uint8_t broker_pool_active_index() {
+    return active;
+}
+
+static bool register_failure(uint32_t nowMs) {
+    BrokerHealth &h = health[active];
+    h.failures++;
+    h.consecutiveFailures++;
+    if (h.consecutiveFailures < MQTT_BROKER_FAIL_THRESHOLD || BROKER_COUNT < 2) return false;
+
+    h.cooldownUntil = (nowMs + MQTT_BROKER_COOLDOWN_MS) | 1;
+    h.consecutiveFailures = 0;
+
+    uint8_t previous = active;
+    active = next_available(nowMs);
+    serial_printf("[BROKER] ✗ %s:%u sin respuesta, cambiando a %s:%u\n",
+                  BROKERS[previous].host, BROKERS[previous].port,
+                  BROKERS[active].host, BROKERS[active].port);
+    return active != previous;
+}
+
+bool broker_pool_connect_failed(uint32_t nowMs) {
+    return register_failure(nowMs);
+}
+
+void broker_pool_connected(uint32_t nowMs) {
+    BrokerHealth &h = health[active];
+    h.consecutiveFailures = 0;
+    h.cooldownUntil = 0;
+    h.connects++;
+    h.lastConnectedAt = nowMs;
+    lastProbeAt = nowMs;
+
+    if (lostAt != 0) {
+        lastFailoverMs = nowMs - lostAt;
+        failoverCount++;
+        lostAt = 0;
+        serial_printf("[BROKER] ✓ Conectado a %s:%u tras %lu ms\n",
+                      BROKERS[active].host, BROKERS[active].port, (unsigned long)lastFailoverMs);
+    }
+}
+
+void broker_pool_connection_lost(uint32_t nowMs) {
+    lostAt = nowMs | 1;
+    // Una caída cuenta como fallo: con el umbral en 1 se conmuta al momento
+    register_failure(nowMs);
+}
+
+bool broker_pool_should_return_to_primary(uint32_t nowMs) {
+    if (active == 0 || nowMs - lastProbeAt < MQTT_PRIMARY_PROBE_INTERVAL) return false;
+    lastProbeAt = nowMs;
+
+    // Sondeo TCP corto: no interrumpe la sesión MQTT en curso
+    WiFiClient probe;
+    bool reachable = probe.connect(BROKERS[0].host, BROKERS[0].port, MQTT_PRIMARY_PROBE_TIMEOUT_MS);
+    probe.stop();
+    if (!reachable) return false;
+
+    serial_printf("[BROKER] Principal %s:%u disponible de nuevo, volviendo\n",
+                  BROKERS[0].host, BROKERS[0].port);
+    health[0].cooldownUntil = 0;
+    health[0].consecutiveFailures = 0;
+    active = 0;
+    lostAt = nowMs | 1;
+    return true;
+}
+
+uint32_t broker_pool_last_failover_ms() {
+    return lastFailoverMs;
+}
+
+void broker_pool_fill_status(JsonDocument &doc) {
+    uint32_t now = millis();
+
+    doc["active"] = active;
+    doc["host"] = BROKERS[active].host;
+    doc["port"] = BROKERS[active].port;
+    doc["failover_ms"] = lastFailoverMs;
+    doc["failovers"] = failoverCount;
+
+    JsonArray list = doc.createNestedArray("brokers");
+    for (uint8_t i = 0; i < BROKER_COUNT; i++) {
+        JsonObject entry = list.createNestedObject();
+        entry["host"] = BROKERS[i].host;
+        entry["port"] = BROKERS[i].port;
+        entry["connects"] = health[i].connects;
+        entry["failures"] = health[i].failures;
+        entry["healthy"] = !in_cooldown(i, now);
+    }
+    doc["timestamp"] = now;
+}
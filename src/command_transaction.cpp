@@ -0,0 +1,156 @@
+// src/command_transaction.cpp
+#include "command_transaction.h"
+#include "serial_log.h"
+#include "light_controller.h"
+#include "mqtt_client.h"
+#include "config.h"
+#include <ArduinoJson.h>
+
+#define TRANSACTION_ID_MAX_LEN  48
+
+struct Transaction {
+    char id[TRANSACTION_ID_MAX_LEN + 1];
+    LightCommand zones[4];    // LIGHT_CMD_NONE = zona sin cambios
+    LightCommand fan;
+    bool setFanAuto;
+    bool fanAuto;
+};
+
+// Acepta solo "1".."4" como clave de zona
+static int parse_zone_key(const char* key) {
+    if (key[0] >= '1' && key[0] <= '4' && key[1] == '\0') {
+        return key[0] - '0';
+    }
+    return -1;
+}
+
+static void publish_transaction_ack(const Transaction &tx, bool ok, const char* error,
+                                    uint8_t changed, uint32_t applyUs, const char* preempted = NULL) {
+    StaticJsonDocument<384> doc;
+    doc["id"] = tx.id[0] ? tx.id : nullptr;
+    doc["ok"] = ok;
+    if (!ok) {
+        doc["error"] = error;
+    } else {
+        doc["changed_mask"] = changed;
+        doc["apply_us"] = applyUs;
+        if (preempted != NULL) doc["preempted"] = preempted;
+    }
+
+    uint8_t mask = get_light_mask();
+    JsonObject zones = doc.createNestedObject("zones");
+    static const char* ZONE_KEYS[4] = {"1", "2", "3", "4"};
+    for (int i = 0; i < 4; i++) {
+        zones[ZONE_KEYS[i]] = (mask & (1 << i)) ? "ON" : "OFF";
+    }
+    FanState fan = get_fan_state();
+    doc["fan"] = fan.isOn ? "ON" : "OFF";
+    doc["fan_auto"] = fan.autoMode;
+    doc["timestamp"] = millis();
+
+    mqtt_publish_json(TOPIC_TRANSACTION_STATE, doc);
+}
+
+void handle_transaction_message(const uint8_t* payload, unsigned int length, uint8_t preempted) {
+    Transaction tx = {};
+    StaticJsonDocument<384> doc;
+    DeserializationError error = deserializeJson(doc, payload, length);
+    if (error) {
+        serial_printf("[TRANSACTION] ✗ Error parsing JSON: %s\n", error.c_str());
+        publish_transaction_ack(tx, false, "json", 0, 0);
+        return;
+    }
+
+    // ===== VALIDACIÓN COMPLETA (no se actúa hasta que todo es correcto) =====
+    // Un id recortado confirmaría otra transacción: se rechaza
+    const char* id = doc["id"] | "";
+    if (strlen(id) > TRANSACTION_ID_MAX_LEN) {
+        publish_transaction_ack(tx, false, "id demasiado largo", 0, 0);
+        return;
+    }
+    strcpy(tx.id, id);
+
+    if (doc.containsKey("zones") && !doc["zones"].is<JsonObject>()) {
+        publish_transaction_ack(tx, false, "zones no es un objeto", 0, 0);
+        return;
+    }
+    JsonObject zones = doc["zones"];
+    for (JsonPair kv : zones) {
+        int zone = parse_zone_key(kv.key().c_str());
+        if (zone < 0) {
+            publish_transaction_ack(tx, false, "zona inválida", 0, 0);
+            return;
+        }
+        LightCommand command = parse_light_command(kv.value() | "");
+        if (command == LIGHT_CMD_NONE) {
+            publish_transaction_ack(tx, false, "comando de zona inválido", 0, 0);
+            return;
+        }
+        tx.zones[zone - 1] = command;
+    }
+
+    if (doc.containsKey("fan")) {
+        tx.fan = parse_light_command(doc["fan"] | "");
+        if (tx.fan == LIGHT_CMD_NONE) {
+            publish_transaction_ack(tx, false, "comando de ventilador inválido", 0, 0);
+            return;
+        }
+    }
+    if (doc.containsKey("fan_auto")) {
+        if (!doc["fan_auto"].is<bool>()) {
+            publish_transaction_ack(tx, false, "fan_auto inválido", 0, 0);
+            return;
+        }
+        tx.setFanAuto = true;
+        tx.fanAuto = doc["fan_auto"];
+    }
+
+    // ===== PARTES ANULADAS POR UN URGENTE POSTERIOR =====
+    bool hasZones = false;
+    for (int i = 0; i < 4; i++) hasZones |= tx.zones[i] != LIGHT_CMD_NONE;
+    bool hasFan = tx.fan != LIGHT_CMD_NONE || tx.setFanAuto;
+    bool zonesPreempted = hasZones && (preempted & PREEMPT_LIGHTS);
+    bool fanPreempted = hasFan && (preempted & PREEMPT_FAN);
+    if (zonesPreempted) {
+        for (int i = 0; i < 4; i++) tx.zones[i] = LIGHT_CMD_NONE;
+    }
+    if (fanPreempted) {
+        tx.fan = LIGHT_CMD_NONE;
+        tx.setFanAuto = false;
+    }
+    if ((zonesPreempted || !hasZones) && (fanPreempted || !hasFan) && (zonesPreempted || fanPreempted)) {
+        serial_printf("[TRANSACTION] ✗ '%s' anulada por un urgente\n", tx.id);
+        publish_transaction_ack(tx, false, "preempted", 0, 0);
+        return;
+    }
+
+    // ===== APLICACIÓN EN UNA SOLA PASADA =====
+    uint32_t startUs = micros();
+
+    uint8_t current = get_light_mask();
+    uint8_t target = current;
+    for (int i = 0; i < 4; i++) {
+        uint8_t bit = 1 << i;
+        switch (tx.zones[i]) {
+            case LIGHT_CMD_ON:     target |= bit;  break;
+            case LIGHT_CMD_OFF:    target &= ~bit; break;
+            case LIGHT_CMD_TOGGLE: target ^= bit;  break;
+            default: break;
+        }
+    }
+    uint8_t changed = apply_light_mask(target);
+
+    if (tx.setFanAuto) set_fan_auto_mode(tx.fanAuto);
+    apply_fan_command(tx.fan);
+
+    uint32_t applyUs = micros() - startUs;
+    serial_printf("[TRANSACTION] ✓ '%s' aplicada en %lu us (cambios 0x%02X)\n",
+                  tx.id, (unsigned long)applyUs, changed);
+
+    // Una confirmación por transacción y nada más (salvo COMMAND_ACK_MIRROR_TOPICS)
+    publish_transaction_ack(tx, true, NULL, changed, applyUs,
+                            zonesPreempted ? "zones" : fanPreempted ? "fan" : NULL);
+    if (!COMMAND_ACK_MIRROR_TOPICS) return;
+    publish_changed_lights(changed);
+    if (tx.fan != LIGHT_CMD_NONE || tx.setFanAuto) publish_fan_status();
+}
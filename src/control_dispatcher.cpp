@@ -0,0 +1,802 @@
+// src/control_dispatcher.cpp
+#include "control_dispatcher.h"
+#include "serial_log.h"
+#include "task_plan.h"
+#include "config.h"
+#include "light_controller.h"
+#include "binary_command.h"
+#include "command_transaction.h"
+#include <ArduinoJson.h>
+
+#define COALESCE_FAN_TARGET   4
+#define COALESCE_TARGETS      5    // Zonas 1-4 y ventilador
+#define NO_DEFERRED_INTENT    0xFFFFFFFFUL
+
+struct ControlMessage {
+    TopicId topic;
+    uint16_t length;
+    uint32_t seq;           // Orden de llegada (común a las dos colas)
+    uint32_t receivedUs;
+    uint8_t payload[CONTROL_PAYLOAD_MAX];
+};
+
+enum UrgentAction : uint8_t {
+    URGENT_ALL_OFF = 0,     // lights/all/set OFF o escenario all_off
+    URGENT_EMERGENCY,       // Escenario emergency: todas encendidas y ventilador apagado
+    URGENT_FAN_OFF          // fan/set OFF
+};
+
+struct UrgentCommand {
+    UrgentAction action;
+    ActuationSource source;   // Escenario (all_off / emergency) o comando MQTT/UDP
+    uint32_t seq;
+    uint32_t receivedUs;
+};
+
+static QueueHandle_t controlQueue = NULL;
+static StaticQueue_t controlQueueBuffer;
+static uint8_t controlQueueStorage[CONTROL_QUEUE_LENGTH * sizeof(ControlMessage)];
+
+static QueueHandle_t urgentQueue = NULL;
+static StaticQueue_t urgentQueueBuffer;
+static uint8_t urgentQueueStorage[CONTROL_URGENT_QUEUE_LENGTH * sizeof(UrgentCommand)];
+
+// La tarea de control duerme en su notificación: la despiertan las dos colas,
+// las escenas pedidas y el vencimiento del siguiente paso o intención
+static TaskHandle_t controlTaskHandle = NULL;
+
+// Varias tareas encolan (MQTT, UDP y el inyector del benchmark de plan): número
+// de secuencia, buffer del mensaje y envío a la cola van juntos bajo el mutex,
+// así el orden de las colas es el de las secuencias
+static SemaphoreHandle_t submitMutex = NULL;
+static StaticSemaphore_t submitMutexBuffer;
+// Cada cola es FIFO en orden de secuencia: lo consumido de una (ejecutado,
+// fundido en una intención o anulado) marca hasta dónde se ha atendido en ella
+static volatile uint32_t normalConsumedSeq = 0;
+static volatile uint32_t urgentConsumedSeq = 0;
+static volatile bool intentsPending = false;  // Quedan intenciones retrasadas (o tras la escena)
+static volatile TaskHandle_t processedWaiter = NULL;
+
+// Pausa pedida por el micro-benchmark (único escritor de los relés mientras mide)
+static volatile TaskHandle_t pauseRequester = NULL;
+static volatile bool paused = false;
+
+// Lo recibido antes de estos números queda anulado por un urgente (solo la tarea de control)
+static uint32_t lightsSupersededSeq = 0;
+static uint32_t fanSupersededSeq = 0;
+
+// Escena y orden del ventilador pedidas desde otra tarea (automatización)
+static portMUX_TYPE sceneRequestMux = portMUX_INITIALIZER_UNLOCKED;
+static Scenario requestedScene = SCENARIO_NONE;
+static ActuationSource requestedSceneSource = ACTUATION_AUTOMATION;
+static LightCommand requestedFan = LIGHT_CMD_NONE;
+static ActuationSource requestedFanSource = ACTUATION_AUTOMATION;
+
+static portMUX_TYPE statsMux = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t latencyCount = 0;
+static uint32_t latencyMin = 0;
+static uint32_t latencyMax = 0;
+static uint64_t latencySum = 0;
+static uint32_t droppedCount = 0;
+static uint32_t coalescedCount = 0;
+static uint32_t rateLimitedCount = 0;
+static uint32_t urgentCount = 0;
+static uint32_t urgentMax = 0;
+static uint64_t urgentSum = 0;
+static uint32_t urgentOverTarget = 0;
+static uint32_t preemptedCount = 0;
+
+// Intención pendiente por destino (solo la toca la tarea de control)
+struct PendingIntent {
+    LightCommand command;   // LIGHT_CMD_NONE = nada pendiente
+    uint32_t seq;           // Último comando absorbido
+    uint32_t receivedUs;    // Último comando absorbido (para la latencia)
+    bool limited;           // Ya contada como retrasada por el intervalo mínimo
+};
+
+static PendingIntent intents[COALESCE_TARGETS] = {};
+
+// Comandos simples que llegaron con la cola llena, combinados por destino al
+// enviarlos (bajo submitMutex). Van detrás de todo lo encolado: mientras haya
+// alguno no se encola nada más, y la tarea de control los funde en sus
+// intenciones cuando la cola queda vacía.
+static PendingIntent overflow[COALESCE_TARGETS] = {};
+static bool overflowPending = false;
+static uint32_t overflowSeq = 0;        // Último absorbido
+
+static void record_latency(uint32_t us) {
+    portENTER_CRITICAL(&statsMux);
+    if (latencyCount == 0 || us < latencyMin) latencyMin = us;
+    if (us > latencyMax) latencyMax = us;
+    latencySum += us;
+    latencyCount++;
+    portEXIT_CRITICAL(&statsMux);
+}
+
+static void record_urgent_latency(uint32_t us) {
+    portENTER_CRITICAL(&statsMux);
+    if (us > urgentMax) urgentMax = us;
+    urgentSum += us;
+    urgentCount++;
+    if (us > URGENT_LATENCY_TARGET_US) urgentOverTarget++;
+    portEXIT_CRITICAL(&statsMux);
+}
+
+static void count_preempted(uint32_t count) {
+    portENTER_CRITICAL(&statsMux);
+    preemptedCount += count;
+    portEXIT_CRITICAL(&statsMux);
+}
+
+// Orden circular: a es anterior a b
+static inline bool seq_before(uint32_t a, uint32_t b) {
+    return (int32_t)(a - b) < 0;
+}
+
+// preempted: partes de un binario o transacción anuladas por un urgente (se confirman como tales)
+static void dispatch(ControlMessage &msg, uint8_t preempted) {
+    switch (msg.topic) {
+        case TOPIC_BINARY_SET:
+            handle_binary_command(msg.payload, msg.length, preempted);
+            break;
+        case TOPIC_TRANSACTION_SET:
+            handle_transaction_message(msg.payload, msg.length, preempted);
+            break;
+        default:
+            handle_light_message(msg.topic, msg.payload, msg.length);
+            break;
+    }
+}
+
+// ============================
+// COMBINACIÓN POR DESTINO
+// ============================
+
+// Funde un comando con lo pendiente: ON/OFF sustituyen, TOGGLE invierte la intención
+static void merge_intent(PendingIntent &intent, LightCommand command, uint32_t seq, uint32_t receivedUs) {
+    uint32_t absorbed = 0;
+
+    if (intent.command != LIGHT_CMD_NONE) absorbed++;
+    if (command == LIGHT_CMD_TOGGLE) {
+        switch (intent.command) {
+            case LIGHT_CMD_NONE:   intent.command = LIGHT_CMD_TOGGLE; break;
+            case LIGHT_CMD_ON:     intent.command = LIGHT_CMD_OFF;    break;
+            case LIGHT_CMD_OFF:    intent.command = LIGHT_CMD_ON;     break;
+            case LIGHT_CMD_TOGGLE:
+                intent.command = LIGHT_CMD_NONE;   // El par se anula: ninguno de los dos actúa
+                absorbed++;
+                break;
+        }
+    } else {
+        intent.command = command;
+    }
+    intent.seq = seq;
+    intent.receivedUs = receivedUs;
+    if (intent.command == LIGHT_CMD_NONE) intent.limited = false;
+
+    if (absorbed > 0) {
+        portENTER_CRITICAL(&statsMux);
+        coalescedCount += absorbed;
+        portEXIT_CRITICAL(&statsMux);
+    }
+}
+
+static bool target_is_on(uint8_t target) {
+    return target == COALESCE_FAN_TARGET ? is_fan_on() : is_light_on(target + 1);
+}
+
+// ¿Alguna zona quedará encendida al aplicar lo pendiente?
+static bool any_zone_ends_on() {
+    for (uint8_t zone = 0; zone < 4; zone++) {
+        bool on = target_is_on(zone);
+        switch (intents[zone].command) {
+            case LIGHT_CMD_ON:     on = true;  break;
+            case LIGHT_CMD_OFF:    on = false; break;
+            case LIGHT_CMD_TOGGLE: on = !on;   break;
+            default:               break;
+        }
+        if (on) return true;
+    }
+    return false;
+}
+
+// ¿Es un comando simple por destino? Solo {"command": ...} en una zona, todas
+// o el ventilador; con más campos (p. ej. auto_mode) va por el camino normal.
+static bool parse_simple(const ControlMessage &msg, bool &allZones, uint8_t &target, LightCommand &command) {
+    allZones = msg.topic == TOPIC_LIGHT_ALL_SET;
+    target = 0;
+    if (msg.topic >= TOPIC_LIGHT_1_SET && msg.topic <= TOPIC_LIGHT_4_SET) {
+        target = msg.topic - TOPIC_LIGHT_1_SET;
+    } else if (msg.topic == TOPIC_FAN_SET) {
+        target = COALESCE_FAN_TARGET;
+    } else if (!allZones) {
+        return false;
+    }
+
+    StaticJsonDocument<128> doc;
+    if (deserializeJson(doc, msg.payload, msg.length) || doc.size() != 1) return false;
+    command = parse_light_command(doc["command"] | "");
+    return command != LIGHT_CMD_NONE;
+}
+
+// Absorbe el mensaje si es un comando simple por destino. false = se ejecuta tal cual.
+// Con una escena en curso también se absorbe (se aplicará al terminar), salvo
+// el TOGGLE global, que depende del estado que deje la escena.
+static bool coalesce(const ControlMessage &msg, bool sceneRunning) {
+    bool allZones;
+    uint8_t target;
+    LightCommand command;
+    if (!parse_simple(msg, allZones, target, command)) return false;
+
+    if (allZones) {
+        if (command == LIGHT_CMD_TOGGLE && sceneRunning) return false;
+        // El TOGGLE global depende del conjunto: si alguna zona queda encendida
+        // (estado actual más lo pendiente) se apagan todas; si no, se encienden
+        if (command == LIGHT_CMD_TOGGLE) command = any_zone_ends_on() ? LIGHT_CMD_OFF : LIGHT_CMD_ON;
+        for (uint8_t zone = 0; zone < 4; zone++) merge_intent(intents[zone], command, msg.seq, msg.receivedUs);
+        return true;
+    }
+    merge_intent(intents[target], command, msg.seq, msg.receivedUs);
+    return true;
+}
+
+// Con la cola llena (o con combinados pendientes) absorbe un comando simple en
+// overflow. El TOGGLE global no: depende del estado al aplicarlo. Con submitMutex.
+static bool overflow_merge(const ControlMessage &msg) {
+    bool allZones;
+    uint8_t target;
+    LightCommand command;
+    if (!parse_simple(msg, allZones, target, command)) return false;
+    if (allZones && command == LIGHT_CMD_TOGGLE) return false;
+
+    if (allZones) {
+        for (uint8_t zone = 0; zone < 4; zone++) merge_intent(overflow[zone], command, msg.seq, msg.receivedUs);
+    } else {
+        merge_intent(overflow[target], command, msg.seq, msg.receivedUs);
+    }
+    overflowPending = true;
+    overflowSeq = msg.seq;
+    return true;
+}
+
+// Un urgente anula lo combinado antes que él para sus relés. Con submitMutex.
+static void overflow_drop(bool lights, bool fan) {
+    uint32_t dropped = 0;
+    for (uint8_t target = 0; target < COALESCE_TARGETS; target++) {
+        bool covered = target == COALESCE_FAN_TARGET ? fan : lights;
+        if (!covered || overflow[target].command == LIGHT_CMD_NONE) continue;
+        overflow[target].command = LIGHT_CMD_NONE;
+        dropped++;
+    }
+    if (dropped > 0) count_preempted(dropped);
+}
+
+// Funde lo combinado al enviar en las intenciones, cuando ya no queda nada
+// encolado delante. true = se consumió algo.
+static bool overflow_take() {
+    bool taken = false;
+    xSemaphoreTake(submitMutex, portMAX_DELAY);
+    if (overflowPending && uxQueueMessagesWaiting(controlQueue) == 0) {
+        for (uint8_t target = 0; target < COALESCE_TARGETS; target++) {
+            PendingIntent &pending = overflow[target];
+            if (pending.command != LIGHT_CMD_NONE) {
+                merge_intent(intents[target], pending.command, pending.seq, pending.receivedUs);
+            }
+            pending.command = LIGHT_CMD_NONE;
+        }
+        normalConsumedSeq = overflowSeq;
+        overflowPending = false;
+        taken = true;
+    }
+    xSemaphoreGive(submitMutex);
+    return taken;
+}
+
+static bool any_intent() {
+    for (uint8_t target = 0; target < COALESCE_TARGETS; target++) {
+        if (intents[target].command != LIGHT_CMD_NONE) return true;
+    }
+    return false;
+}
+
+// Aplica las intenciones cuyo relé ya puede conmutar.
+// Devuelve los ms hasta la siguiente que quede retrasada, o NO_DEFERRED_INTENT.
+static uint32_t apply_intents() {
+    unsigned long now = millis();
+    uint32_t nextDueMs = NO_DEFERRED_INTENT;
+    uint8_t lightMask = 0;
+    bool fanApplied = false;
+
+    for (uint8_t target = 0; target < COALESCE_TARGETS; target++) {
+        PendingIntent &intent = intents[target];
+        if (intent.command == LIGHT_CMD_NONE) continue;
+
+        bool on = target_is_on(target);
+        bool changes = intent.command == LIGHT_CMD_TOGGLE ||
+                       (intent.command == LIGHT_CMD_ON) != on;
+
+        uint32_t wait = relay_interval_left(now - relay_last_switch_ms(target));
+        if (changes && wait > 0) {
+            if (!intent.limited) {
+                intent.limited = true;
+                portENTER_CRITICAL(&statsMux);
+                rateLimitedCount++;
+                portEXIT_CRITICAL(&statsMux);
+            }
+            if (wait < nextDueMs) nextDueMs = wait;
+            continue;
+        }
+
+        // Sin cambio no se reescribe el relé (ni se reinicia su intervalo), pero se confirma el estado
+        if (changes) {
+            if (target == COALESCE_FAN_TARGET) {
+                apply_fan_command(intent.command);
+            } else {
+                apply_light_command(target + 1, intent.command);
+            }
+        }
+        if (target == COALESCE_FAN_TARGET) {
+            fanApplied = true;
+        } else {
+            lightMask |= 1 << target;
+        }
+        record_latency(micros() - intent.receivedUs);
+        intent.command = LIGHT_CMD_NONE;
+        intent.limited = false;
+    }
+
+    publish_changed_lights(lightMask);
+    if (fanApplied) publish_fan_status();
+    return nextDueMs;
+}
+
+// ms hasta que pueda ejecutarse un comando no combinable (escena, TOGGLE con
+// más campos, binario, transacción): antes van las intenciones pendientes y
+// ningún relé puede haber conmutado dentro de su intervalo mínimo, porque no
+// se sabe de antemano cuáles tocará. 0 = ya.
+static uint32_t relays_quiet_in() {
+    uint32_t pendingMs = apply_intents();
+    if (pendingMs != NO_DEFERRED_INTENT) return pendingMs;
+
+    unsigned long now = millis();
+    uint32_t wait = 0;
+    for (uint8_t target = 0; target < COALESCE_TARGETS; target++) {
+        unsigned long last = relay_last_switch_ms(target);
+        if (last == 0) continue;
+        uint32_t left = relay_interval_left(now - last);
+        if (left > wait) wait = left;
+    }
+    return wait;
+}
+
+// ============================
+// CARRIL URGENTE
+// ============================
+
+// ¿Es un comando urgente? Solo la forma simple {"command": "OFF"} / {"scenario": ...}
+static bool classify_urgent(TopicId topic, const uint8_t* payload, unsigned int length, UrgentAction &action) {
+    if (topic != TOPIC_LIGHT_ALL_SET && topic != TOPIC_SCENARIO_SET && topic != TOPIC_FAN_SET) return false;
+
+    StaticJsonDocument<128> doc;
+    if (deserializeJson(doc, payload, length) || doc.size() != 1) return false;
+
+    if (topic == TOPIC_SCENARIO_SET) {
+        Scenario scenario = parse_scenario(doc["scenario"] | "");
+        if (scenario == SCENARIO_ALL_OFF) {
+            action = URGENT_ALL_OFF;
+            return true;
+        }
+        if (scenario == SCENARIO_EMERGENCY) {
+            action = URGENT_EMERGENCY;
+            return true;
+        }
+        return false;
+    }
+
+    if (parse_light_command(doc["command"] | "") != LIGHT_CMD_OFF) return false;
+    action = topic == TOPIC_FAN_SET ? URGENT_FAN_OFF : URGENT_ALL_OFF;
+    return true;
+}
+
+// Binario y transacciones llevan zonas y ventilador: un urgente puede anular una parte
+static inline bool is_compound(TopicId topic) {
+    return topic == TOPIC_BINARY_SET || topic == TOPIC_TRANSACTION_SET;
+}
+
+// Partes (PREEMPT_LIGHTS / PREEMPT_FAN) de un comando normal recibido antes de
+// un urgente sobre sus relés: ya no se ejecutan
+static uint8_t superseded(const ControlMessage &msg) {
+    uint8_t parts = 0;
+    if (msg.topic != TOPIC_FAN_SET && seq_before(msg.seq, lightsSupersededSeq)) parts |= PREEMPT_LIGHTS;
+    if ((msg.topic == TOPIC_FAN_SET || is_compound(msg.topic)) && seq_before(msg.seq, fanSupersededSeq)) {
+        parts |= PREEMPT_FAN;
+    }
+    return parts;
+}
+
+static void run_urgent(const UrgentCommand &urgent) {
+    bool lights = urgent.action != URGENT_FAN_OFF;
+    bool fan = urgent.action != URGENT_ALL_OFF;
+    uint32_t preempted = 0;
+
+    // La escena a medias se corta: lo que ya cambió se publica con el resultado
+    uint8_t changed = scene_cancel();
+
+    // Lo anterior para los mismos relés queda anulado (lo posterior se respeta)
+    for (uint8_t target = 0; target < COALESCE_TARGETS; target++) {
+        PendingIntent &intent = intents[target];
+        bool covered = target == COALESCE_FAN_TARGET ? fan : lights;
+        if (!covered || intent.command == LIGHT_CMD_NONE || !seq_before(intent.seq, urgent.seq)) continue;
+        intent.command = LIGHT_CMD_NONE;
+        intent.limited = false;
+        preempted++;
+    }
+    if (lights) {
+        lightsSupersededSeq = urgent.seq;
+        portENTER_CRITICAL(&sceneRequestMux);
+        requestedScene = SCENARIO_NONE;
+        portEXIT_CRITICAL(&sceneRequestMux);
+    }
+    if (fan) {
+        fanSupersededSeq = urgent.seq;
+        portENTER_CRITICAL(&sceneRequestMux);
+        requestedFan = LIGHT_CMD_NONE;
+        portEXIT_CRITICAL(&sceneRequestMux);
+    }
+
+    // Conmutación directa, sin intervalo mínimo ni pasos (el único camino que se lo salta)
+    if (urgent.action == URGENT_ALL_OFF) {
+        changed |= apply_light_mask(0x00, urgent.source);
+    } else if (urgent.action == URGENT_EMERGENCY) {
+        changed |= apply_light_mask(0x0F, urgent.source);
+    }
+    if (fan) apply_fan_command(LIGHT_CMD_OFF, urgent.source);
+
+    uint32_t latencyUs = micros() - urgent.receivedUs;
+    record_urgent_latency(latencyUs);
+    if (preempted > 0) count_preempted(preempted);
+    if (latencyUs > URGENT_LATENCY_TARGET_US) {
+        serial_printf("[CONTROL] ⚠ Comando urgente en %lu µs (objetivo %lu µs)\n",
+                      (unsigned long)latencyUs, (unsigned long)URGENT_LATENCY_TARGET_US);
+    }
+
+    // Los estados salen por el carril prioritario de publicación
+    publish_changed_lights(changed);
+    if (fan) publish_fan_status();
+}
+
+static void start_requested_scene() {
+    portENTER_CRITICAL(&sceneRequestMux);
+    Scenario scenario = requestedScene;
+    ActuationSource source = requestedSceneSource;
+    requestedScene = SCENARIO_NONE;
+    portEXIT_CRITICAL(&sceneRequestMux);
+
+    if (scenario != SCENARIO_NONE) scene_start(scenario, source);
+}
+
+// Orden del ventilador pedida por la automatización. Un comando recibido para
+// el ventilador y aún pendiente tiene preferencia; el relé respeta su
+// intervalo mínimo. Devuelve los ms hasta poder aplicarla, o NO_DEFERRED_INTENT.
+static uint32_t apply_requested_fan() {
+    portENTER_CRITICAL(&sceneRequestMux);
+    LightCommand command = requestedFan;
+    ActuationSource source = requestedFanSource;
+    portEXIT_CRITICAL(&sceneRequestMux);
+    if (command == LIGHT_CMD_NONE) return NO_DEFERRED_INTENT;
+
+    bool changes = intents[COALESCE_FAN_TARGET].command == LIGHT_CMD_NONE &&
+                   (command == LIGHT_CMD_TOGGLE || (command == LIGHT_CMD_ON) != is_fan_on());
+    if (changes) {
+        uint32_t wait = relay_interval_left(millis() - relay_last_switch_ms(COALESCE_FAN_TARGET));
+        if (wait > 0) return wait;
+    }
+
+    // Solo se retira si nadie la sustituyó mientras tanto
+    portENTER_CRITICAL(&sceneRequestMux);
+    if (requestedFan == command) requestedFan = LIGHT_CMD_NONE;
+    portEXIT_CRITICAL(&sceneRequestMux);
+
+    if (changes) {
+        apply_fan_command(command, source);
+        publish_fan_status();
+    }
+    return NO_DEFERRED_INTENT;
+}
+
+static void controlTask(void *parameter) {
+    // Mensaje estático: la tarea es la única consumidora
+    static ControlMessage msg;
+    bool held = false;          // msg leído, esperando a que los relés puedan conmutar
+    UrgentCommand urgent;
+    TickType_t wait = portMAX_DELAY;
+
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, wait);
+
+        // En pausa no se consume nada: lo que llegue espera en las colas
+        if (pauseRequester != NULL) {
+            paused = true;
+            xTaskNotifyGive(pauseRequester);
+            while (pauseRequester != NULL) ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            paused = false;
+        }
+        bool consumed = false;
+
+        // 1. Urgentes: antes que cualquier otra cosa
+        while (xQueueReceive(urgentQueue, &urgent, 0) == pdTRUE) {
+            run_urgent(urgent);
+            urgentConsumedSeq = urgent.seq;
+            consumed = true;
+        }
+
+        // 2. Pasos vencidos de la escena en curso (o la pedida por la automatización)
+        // y la orden del ventilador de la automatización
+        uint32_t sceneDueMs = scene_run_due();
+        if (!scene_active()) {
+            start_requested_scene();
+            sceneDueMs = scene_run_due();
+        }
+        uint32_t fanDueMs = apply_requested_fan();
+
+        // 3. Cola normal. Se absorbe en ráfaga (también con escena en curso: las
+        // intenciones esperan a que termine); un comando no combinable espera en
+        // cabeza a la escena y a que los relés respeten su intervalo mínimo.
+        uint32_t gateDueMs = NO_DEFERRED_INTENT;
+        while (uxQueueMessagesWaiting(urgentQueue) == 0 &&
+               (held || xQueueReceive(controlQueue, &msg, 0) == pdTRUE)) {
+            // Anulado por un urgente: los simples se descartan; binario y
+            // transacción aplican lo que quede y confirman la anulación
+            uint8_t preempted = superseded(msg);
+            if (preempted != 0 && !is_compound(msg.topic)) {
+                held = false;
+                count_preempted(1);
+                normalConsumedSeq = msg.seq;
+                consumed = true;
+                continue;
+            }
+            if (!held && preempted == 0 && coalesce(msg, scene_active())) {
+                normalConsumedSeq = msg.seq;
+                consumed = true;
+                continue;
+            }
+            if (scene_active()) {
+                held = true;
+                break;
+            }
+
+            uint32_t quietMs = relays_quiet_in();
+            if (quietMs > 0) {
+                held = true;
+                gateDueMs = quietMs;
+                break;
+            }
+            held = false;
+            if (preempted != 0) count_preempted(1);
+            dispatch(msg, preempted);
+            record_latency(micros() - msg.receivedUs);
+            normalConsumedSeq = msg.seq;
+            consumed = true;
+            sceneDueMs = scene_run_due();   // El primer paso de una escena sale ya
+        }
+
+        // 4. Lo combinado al enviar con la cola llena va detrás de todo lo encolado
+        if (!held && uxQueueMessagesWaiting(urgentQueue) == 0 && overflow_take()) consumed = true;
+
+        // Con intenciones retrasadas o pasos pendientes se despierta cuando toquen.
+        // Durante una escena las intenciones esperan (la despierta su siguiente paso).
+        uint32_t nextDueMs = NO_DEFERRED_INTENT;
+        bool waiting = held;
+        if (scene_active()) {
+            waiting = waiting || any_intent();
+        } else {
+            nextDueMs = apply_intents();
+        }
+        intentsPending = waiting || nextDueMs != NO_DEFERRED_INTENT;
+        if (gateDueMs < nextDueMs) nextDueMs = gateDueMs;
+        if (consumed) {
+            TaskHandle_t waiter = processedWaiter;
+            if (waiter != NULL) xTaskNotifyGive(waiter);
+        }
+        if (sceneDueMs < nextDueMs) nextDueMs = sceneDueMs;
+        if (fanDueMs < nextDueMs) nextDueMs = fanDueMs;
+        wait = nextDueMs == NO_DEFERRED_INTENT ? portMAX_DELAY : pdMS_TO_TICKS(nextDueMs) + 1;
+    }
+}
+
+void control_dispatcher_start() {
+    controlQueue = xQueueCreateStatic(CONTROL_QUEUE_LENGTH, sizeof(ControlMessage),
+                                      controlQueueStorage, &controlQueueBuffer);
+    urgentQueue = xQueueCreateStatic(CONTROL_URGENT_QUEUE_LENGTH, sizeof(UrgentCommand),
+                                     urgentQueueStorage, &urgentQueueBuffer);
+    submitMutex = xSemaphoreCreateMutexStatic(&submitMutexBuffer);
+    task_plan_start(TASK_ROLE_CONTROL, controlTask, NULL, &controlTaskHandle);
+}
+
+bool control_dispatcher_handles(TopicId topic) {
+    switch (topic) {
+        case TOPIC_LIGHT_1_SET:
+        case TOPIC_LIGHT_2_SET:
+        case TOPIC_LIGHT_3_SET:
+        case TOPIC_LIGHT_4_SET:
+        case TOPIC_LIGHT_ALL_SET:
+        case TOPIC_SCENARIO_SET:
+        case TOPIC_FAN_SET:
+        case TOPIC_BINARY_SET:
+        case TOPIC_TRANSACTION_SET:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static void count_dropped() {
+    portENTER_CRITICAL(&statsMux);
+    droppedCount++;
+    portEXIT_CRITICAL(&statsMux);
+}
+
+// Asigna la secuencia y encola (con submitMutex tomado)
+static bool enqueue_locked(TopicId topic, const uint8_t* payload, unsigned int length, uint32_t receivedUs,
+                           ControlTicket* ticket) {
+    // Buffer y secuencia estáticos: protegidos por submitMutex
+    static ControlMessage msg;
+    static uint32_t nextSeq = 1;
+
+    uint32_t seq = nextSeq++;
+    if (ticket != NULL) {
+        ticket->seq = seq;
+        ticket->urgent = false;
+    }
+
+    // Urgente: adelanta a la cola normal (si su cola se llena, va por la normal)
+    UrgentAction action;
+    if (classify_urgent(topic, payload, length, action)) {
+        ActuationSource source = topic == TOPIC_SCENARIO_SET ? ACTUATION_SCENE : ACTUATION_MQTT;
+        UrgentCommand urgent = { action, source, seq, receivedUs };
+        if (xQueueSend(urgentQueue, &urgent, 0) == pdTRUE) {
+            if (overflowPending) overflow_drop(action != URGENT_FAN_OFF, action != URGENT_ALL_OFF);
+            if (ticket != NULL) ticket->urgent = true;
+            return true;
+        }
+    }
+
+    msg.topic = topic;
+    msg.length = length;
+    msg.seq = seq;
+    msg.receivedUs = receivedUs;
+    memcpy(msg.payload, payload, length);
+
+    // Con combinados pendientes no se encola nada: pasaría delante de ellos
+    static bool reportedFull = false;
+    if (!overflowPending && xQueueSend(controlQueue, &msg, 0) == pdTRUE) {
+        reportedFull = false;
+        return true;
+    }
+
+    // Cola llena: los comandos simples se combinan por destino (gana el último);
+    // el resto se descarta. En una ráfaga solo se avisa la primera vez.
+    bool merged = overflow_merge(msg);
+    if (!reportedFull) {
+        Serial.println(merged ? "[CONTROL] ⚠ Cola de control llena, combinando comandos simples"
+                              : "[CONTROL] ✗ Cola de control llena, descartando comandos");
+    }
+    reportedFull = true;
+    if (!merged) count_dropped();
+    return merged;
+}
+
+bool control_dispatcher_submit(TopicId topic, const uint8_t* payload, unsigned int length, uint32_t receivedUs,
+                               ControlTicket* ticket) {
+    if (controlQueue == NULL || controlTaskHandle == NULL || length > CONTROL_PAYLOAD_MAX) {
+        serial_printf("[CONTROL] ✗ Comando descartado (%u bytes)\n", length);
+        count_dropped();
+        return false;
+    }
+
+    xSemaphoreTake(submitMutex, portMAX_DELAY);
+    bool queued = enqueue_locked(topic, payload, length, receivedUs, ticket);
+    xSemaphoreGive(submitMutex);
+
+    if (queued) xTaskNotifyGive(controlTaskHandle);
+    return queued;
+}
+
+bool control_dispatcher_wait_processed(const ControlTicket &ticket, uint32_t timeoutMs, bool* pending) {
+    processedWaiter = xTaskGetCurrentTaskHandle();
+    TickType_t start = xTaskGetTickCount();
+    TickType_t limit = pdMS_TO_TICKS(timeoutMs);
+    const volatile uint32_t &consumedSeq = ticket.urgent ? urgentConsumedSeq : normalConsumedSeq;
+    bool done;
+
+    while (!(done = !seq_before(consumedSeq, ticket.seq))) {
+        TickType_t elapsed = xTaskGetTickCount() - start;
+        if (elapsed >= limit) break;
+        ulTaskNotifyTake(pdTRUE, limit - elapsed);
+    }
+    processedWaiter = NULL;
+
+    if (pending != NULL) *pending = intentsPending;
+    return done;
+}
+
+bool control_dispatcher_pause(uint32_t timeoutMs) {
+    if (controlTaskHandle == NULL) return false;
+
+    pauseRequester = xTaskGetCurrentTaskHandle();
+    xTaskNotifyGive(controlTaskHandle);
+    TickType_t start = xTaskGetTickCount();
+    TickType_t limit = pdMS_TO_TICKS(timeoutMs);
+    while (!paused) {
+        TickType_t elapsed = xTaskGetTickCount() - start;
+        if (elapsed >= limit) {
+            pauseRequester = NULL;
+            xTaskNotifyGive(controlTaskHandle);   // Por si se detuvo justo ahora
+            return false;
+        }
+        ulTaskNotifyTake(pdTRUE, limit - elapsed);
+    }
+    return true;
+}
+
+void control_dispatcher_resume() {
+    if (pauseRequester == NULL) return;
+    pauseRequester = NULL;
+    xTaskNotifyGive(controlTaskHandle);
+}
+
+void control_dispatcher_request_scene(Scenario scenario, ActuationSource source) {
+    if (controlTaskHandle == NULL) return;
+
+    portENTER_CRITICAL(&sceneRequestMux);
+    requestedScene = scenario;
+    requestedSceneSource = source;
+    portEXIT_CRITICAL(&sceneRequestMux);
+    xTaskNotifyGive(controlTaskHandle);
+}
+
+void control_dispatcher_request_fan(LightCommand command, ActuationSource source) {
+    if (controlTaskHandle == NULL) return;
+
+    portENTER_CRITICAL(&sceneRequestMux);
+    requestedFan = command;
+    requestedFanSource = source;
+    portEXIT_CRITICAL(&sceneRequestMux);
+    xTaskNotifyGive(controlTaskHandle);
+}
+
+ControlLatencyStats control_dispatcher_get_stats() {
+    ControlLatencyStats stats;
+    portENTER_CRITICAL(&statsMux);
+    stats.count = latencyCount;
+    stats.minUs = latencyMin;
+    stats.maxUs = latencyMax;
+    stats.avgUs = latencyCount > 0 ? (uint32_t)(latencySum / latencyCount) : 0;
+    stats.dropped = droppedCount;
+    stats.coalesced = coalescedCount;
+    stats.rateLimited = rateLimitedCount;
+    stats.urgentCount = urgentCount;
+    stats.urgentAvgUs = urgentCount > 0 ? (uint32_t)(urgentSum / urgentCount) : 0;
+    stats.urgentMaxUs = urgentMax;
+    stats.urgentOverTarget = urgentOverTarget;
+    stats.preempted = preemptedCount;
+    portEXIT_CRITICAL(&statsMux);
+    return stats;
+}
+
+void control_dispatcher_reset_stats() {
+    portENTER_CRITICAL(&statsMux);
+    latencyCount = 0;
+    latencyMin = 0;
+    latencyMax = 0;
+    latencySum = 0;
+    droppedCount = 0;
+    coalescedCount = 0;
+    rateLimitedCount = 0;
+    urgentCount = 0;
+    urgentMax = 0;
+    urgentSum = 0;
+    urgentOverTarget = 0;
+    preemptedCount = 0;
+    portEXIT_CRITICAL(&statsMux);
+}
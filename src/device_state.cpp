@@ -0,0 +1,264 @@
+// src/device_state.cpp
+#include "device_state.h"
+#include "serial_log.h"
+#include "mqtt_client.h"
+#include "task_plan.h"
+#include "config.h"
+#include <ArduinoJson.h>
+#include <Preferences.h>
+#include <rom/crc.h>
+
+#define STATE_TEXT_MAX      33     // SSID (32) + terminador
+#define ALL_STATE_FIELDS    ((1UL << STATE_FIELD_COUNT) - 1)
+
+#define DEVICE_STATE_NAMESPACE    "devstate"
+#define DEVICE_STATE_BOOT_KEY     "boot"
+#define DEVICE_STATE_BOOT_VERSION 1
+
+// Contador de arranques en flash: tamaño fijo y CRC32 al final
+struct BootRecord {
+    uint8_t version;
+    uint32_t boot;
+    uint32_t crc;
+};
+
+enum FieldType : uint8_t {
+    FIELD_BOOL = 0,
+    FIELD_INT,
+    FIELD_TEXT
+};
+
+struct FieldDef {
+    const char* group;
+    const char* key;
+    FieldType type;
+    int32_t deadband;     // Cambio mínimo que cuenta (0 = cualquiera)
+    bool immediate;       // Sale sin esperar a agrupar (estado de relés)
+};
+
+static constexpr FieldDef FIELDS[STATE_FIELD_COUNT] = {
+    // group     key               type        deadband                     immediate
+    { "wifi",    "connected",      FIELD_BOOL, 0,                           false },
+    { "wifi",    "ssid",           FIELD_TEXT, 0,                           false },
+    { "wifi",    "ip",             FIELD_TEXT, 0,                           false },
+    { "wifi",    "rssi",           FIELD_INT,  WIFI_RSSI_DEADBAND_DB,       false },
+    { "memory",  "heap_free",      FIELD_INT,  DEVICE_STATE_HEAP_DEADBAND,  false },
+    { "memory",  "heap_min_free",  FIELD_INT,  DEVICE_STATE_HEAP_DEADBAND,  false },
+    { "system",  "uptime_s",       FIELD_INT,  0,                           false },
+    { "sensors", "temperature_mc", FIELD_INT,  DEVICE_STATE_TEMP_DEADBAND,  false },
+    { "sensors", "ldr_raw",        FIELD_INT,  DEVICE_STATE_LDR_DEADBAND,   false },
+    { "sensors", "lux",            FIELD_INT,  DEVICE_STATE_LUX_DEADBAND,   false },
+    { "lights",  "1",              FIELD_BOOL, 0,                           true  },
+    { "lights",  "2",              FIELD_BOOL, 0,                           true  },
+    { "lights",  "3",              FIELD_BOOL, 0,                           true  },
+    { "lights",  "4",              FIELD_BOOL, 0,                           true  },
+    { "fan",     "on",             FIELD_BOOL, 0,                           true  },
+    { "fan",     "speed",          FIELD_INT,  0,                           true  },
+    { "fan",     "auto_mode",      FIELD_BOOL, 0,                           true  },
+};
+
+static_assert(STATE_FIELD_COUNT <= 32, "Los campos cambiados se marcan en una máscara de 32 bits");
+
+struct FieldValue {
+    int32_t number;
+    char text[STATE_TEXT_MAX];
+};
+
+static portMUX_TYPE stateMux = portMUX_INITIALIZER_UNLOCKED;
+static FieldValue values[STATE_FIELD_COUNT];
+static uint32_t knownMask = 0;      // Campos con valor (los demás salen como null)
+static uint32_t dirtyMask = 0;      // Cambiados desde la última publicación
+static volatile bool fullRequested = true;
+static TaskHandle_t stateTask = NULL;
+
+// Secuencia del último documento publicado (solo la toca la tarea). Vuelve a
+// empezar en cada arranque: "boot" distingue una secuencia de la anterior.
+static uint32_t publishedSeq = 0;
+static uint32_t bootNumber = 0;
+
+static uint32_t immediate_mask() {
+    uint32_t mask = 0;
+    for (uint8_t i = 0; i < STATE_FIELD_COUNT; i++) {
+        if (FIELDS[i].immediate) mask |= 1UL << i;
+    }
+    return mask;
+}
+
+static void notify_state_task() {
+    if (stateTask != NULL) xTaskNotifyGive(stateTask);
+}
+
+void device_state_set(StateField field, int32_t value) {
+    if (field >= STATE_FIELD_COUNT) return;
+    uint32_t bit = 1UL << field;
+    bool changed = false;
+
+    portENTER_CRITICAL(&stateMux);
+    int32_t delta = value - values[field].number;
+    if (delta < 0) delta = -delta;
+    if (!(knownMask & bit) || (delta != 0 && delta >= FIELDS[field].deadband)) {
+        values[field].number = value;
+        knownMask |= bit;
+        dirtyMask |= bit;
+        changed = true;
+    }
+    portEXIT_CRITICAL(&stateMux);
+
+    if (changed) notify_state_task();
+}
+
+void device_state_set_text(StateField field, const char* text) {
+    if (field >= STATE_FIELD_COUNT) return;
+    uint32_t bit = 1UL << field;
+    bool changed = false;
+
+    portENTER_CRITICAL(&stateMux);
+    if (!(knownMask & bit) || strncmp(values[field].text, text, STATE_TEXT_MAX - 1) != 0) {
+        strlcpy(values[field].text, text, STATE_TEXT_MAX);
+        knownMask |= bit;
+        dirtyMask |= bit;
+        changed = true;
+    }
+    portEXIT_CRITICAL(&stateMux);
+
+    if (changed) notify_state_task();
+}
+
+void device_state_request_full() {
+    fullRequested = true;
+    notify_state_task();
+}
+
+// Publica el documento completo o los campos cambiados. false = no salió
+// (los campos siguen marcados y se reintenta)
+static bool publish_document(bool full) {
+    // Copia estática: solo la tarea publica
+    static FieldValue snapshot[STATE_FIELD_COUNT];
+    uint32_t mask;
+    uint32_t known;
+
+    portENTER_CRITICAL(&stateMux);
+    mask = full ? ALL_STATE_FIELDS : dirtyMask;
+    known = knownMask;
+    dirtyMask = 0;
+    memcpy(snapshot, values, sizeof(values));
+    portEXIT_CRITICAL(&stateMux);
+
+    if (mask == 0) return true;
+
+    StaticJsonDocument<1024> doc;
+    doc["boot"] = bootNumber;
+    doc["seq"] = publishedSeq + 1;
+    if (full) {
+        doc["full"] = true;
+    } else {
+        doc["prev"] = publishedSeq;
+    }
+    doc["uptime_ms"] = millis();
+
+    // Los campos de un grupo van seguidos en la tabla: un objeto por grupo
+    JsonObject state = doc.createNestedObject("state");
+    JsonObject group;
+    const char* groupName = "";
+    for (uint8_t i = 0; i < STATE_FIELD_COUNT; i++) {
+        if (!(mask & (1UL << i))) continue;
+        const FieldDef &def = FIELDS[i];
+        if (strcmp(def.group, groupName) != 0) {
+            group = state.createNestedObject(def.group);
+            groupName = def.group;
+        }
+
+        if (!(known & (1UL << i))) {
+            group[def.key] = nullptr;
+            continue;
+        }
+        switch (def.type) {
+            case FIELD_BOOL:  group[def.key] = snapshot[i].number != 0; break;
+            case FIELD_INT:   group[def.key] = snapshot[i].number; break;
+            case FIELD_TEXT:  group[def.key] = (const char*)snapshot[i].text; break;
+        }
+    }
+
+    if (!mqtt_publish_json(full ? TOPIC_STATE_DOCUMENT : TOPIC_STATE_DELTA, doc)) {
+        portENTER_CRITICAL(&stateMux);
+        dirtyMask |= mask;
+        portEXIT_CRITICAL(&stateMux);
+        return false;
+    }
+    publishedSeq++;
+    return true;
+}
+
+static void deviceStateTask(void *parameter) {
+    const uint32_t immediate = immediate_mask();
+    unsigned long lastDelta = 0;
+    TickType_t wait = portMAX_DELAY;
+
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, wait);
+        wait = portMAX_DELAY;
+
+        // Sin conexión se acumula; al conectar sale el documento completo
+        if (!mqtt_is_connected()) continue;
+
+        if (fullRequested) {
+            fullRequested = false;
+            if (!publish_document(true)) {
+                fullRequested = true;
+                wait = pdMS_TO_TICKS(DEVICE_STATE_BATCH_MS);
+            }
+            lastDelta = millis();
+            continue;
+        }
+
+        portENTER_CRITICAL(&stateMux);
+        uint32_t dirty = dirtyMask;
+        portEXIT_CRITICAL(&stateMux);
+        if (dirty == 0) continue;
+
+        // Relés: enseguida. Telemetría: como mucho un delta por DEVICE_STATE_BATCH_MS
+        unsigned long elapsed = millis() - lastDelta;
+        if ((dirty & immediate) || elapsed >= DEVICE_STATE_BATCH_MS) {
+            if (!publish_document(false)) wait = pdMS_TO_TICKS(DEVICE_STATE_BATCH_MS);
+            lastDelta = millis();
+        } else {
+            wait = pdMS_TO_TICKS(DEVICE_STATE_BATCH_MS - elapsed);
+        }
+    }
+}
+
+static uint32_t boot_record_crc(const BootRecord &record) {
+    return crc32_le(0, (const uint8_t*)&record, offsetof(BootRecord, crc));
+}
+
+// Lee el número del arranque anterior y guarda el de este (una escritura por arranque)
+static uint32_t next_boot_number() {
+    Preferences prefs;
+    if (!prefs.begin(DEVICE_STATE_NAMESPACE, false)) {
+        Serial.println("[STATE] ✗ No se pudo abrir NVS, arranque sin numerar");
+        return 0;
+    }
+
+    BootRecord record = {};
+    size_t len = prefs.getBytes(DEVICE_STATE_BOOT_KEY, &record, sizeof(record));
+    bool valid = len == sizeof(record) && record.version == DEVICE_STATE_BOOT_VERSION &&
+                 record.crc == boot_record_crc(record);
+    uint32_t boot = valid ? record.boot + 1 : 1;
+    if (boot == 0) boot = 1;   // 0 queda para "sin numerar"
+
+    record = {};
+    record.version = DEVICE_STATE_BOOT_VERSION;
+    record.boot = boot;
+    record.crc = boot_record_crc(record);
+    if (prefs.putBytes(DEVICE_STATE_BOOT_KEY, &record, sizeof(record)) != sizeof(record)) {
+        Serial.println("[STATE] ✗ Error guardando el número de arranque");
+    }
+    prefs.end();
+    return boot;
+}
+
+void device_state_start() {
+    bootNumber = next_boot_number();
+    serial_printf("[STATE] ✓ Documento de estado, arranque #%lu\n", (unsigned long)bootNumber);
+    task_plan_start(TASK_ROLE_DEVICE_STATE, deviceStateTask, NULL, &stateTask);
+}
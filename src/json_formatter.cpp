@@ -4,28 +4,22 @@
 #include "memory_monitor.h"
 #include <ArduinoJson.h>
 
-// Generar JSON solo con datos WiFi
-String generate_wifi_json() {
-    StaticJsonDocument<256> doc;
+// Generar JSON solo con datos WiFi (desde el snapshot cacheado)
+void generate_wifi_json(const WifiSnapshot &wifi, JsonDocument &doc) {
+    doc["connected"] = wifi.connected;
+    doc["ssid"] = wifi.ssid;
+    doc["ip"] = wifi.ip;
+    doc["mac"] = wifi.mac;
+    doc["rssi"] = wifi.rssi;
 
-    doc["connected"] = wifi_is_connected();
-    doc["ssid"] = wifi_get_ssid();
-    doc["ip"] = wifi_get_ip();
-    doc["mac"] = wifi_get_mac();
-    doc["rssi"] = wifi_get_rssi();
-
-    String output;
-    serializeJsonPretty(doc, output);
-    return output;
+    WifiConnectStats stats = wifi_get_connect_stats();
+    doc["boot_connect_ms"] = stats.coldBootMs;
+    doc["reassoc_ms"] = stats.lastReassocMs;
+    doc["reconnects"] = stats.reconnectCount;
+    doc["fast_connect"] = stats.fastConnect;
 }
 
 // Generar JSON solo con datos de memoria
-String generate_memory_json() {
-    StaticJsonDocument<512> doc;
-
+void generate_memory_json(JsonDocument &doc) {
     append_memory_info(doc);
-
-    String output;
-    serializeJsonPretty(doc, output);
-    return output;
 }
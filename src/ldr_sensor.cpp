@@ -1,42 +1,46 @@
 #include "ldr_sensor.h"
+#include "serial_log.h"
 #include "mqtt_client.h"
 #include "config.h"
+#include "task_plan.h"
+#include "adaptive_sampling.h"
+#include "device_state.h"
+#include "sensor_calibration.h"
 #include <ArduinoJson.h>
 
+// Publica la última muestra de sensorMonitorTask (no lee el ADC).
+// Se despierta en cuanto el canal se activa (p. ej. al abrir una puerta).
 static void ldrTask(void *parameter) {
-    // Aseguramos resolución ADC igual que temperatura
-    analogReadResolution(ADC_RESOLUTION_BITS);
+    adaptive_sampling_set_reporter(SENSOR_CHANNEL_LDR, xTaskGetCurrentTaskHandle());
 
     while (true) {
-        int raw = analogRead(LDR_SENSOR_PIN);
-        // Aquí podrías mapear raw a lux si tienes la ecuación del sensor
-        // float lux = map(raw, 0, ADC_MAX_VALUE, 0, 1000); 
-
-        StaticJsonDocument<128> doc;
-        doc["ldr_raw"] = raw;
-        // doc["lux"] = lux;
-        doc["timestamp"] = millis();
-
-        String json;
-        serializeJsonPretty(doc, json);
-
-        Serial.println("[" MQTT_TOPIC_LDR "]");
-        Serial.println(json);
-
-        mqtt_publish(MQTT_TOPIC_LDR, json);
-
-        vTaskDelay(pdMS_TO_TICKS(LDR_REPORT_INTERVAL));
+        ChannelSample sample = adaptive_sampling_get(SENSOR_CHANNEL_LDR);
+
+        if (sample.samples > 0) {
+            int32_t lux = adc_to_lux(sample.raw);
+            device_state_set(STATE_LDR_RAW, sample.raw);
+            device_state_set(STATE_LDR_LUX, lux);
+
+#if DEVICE_STATE_LEGACY_TOPICS
+            StaticJsonDocument<160> doc;
+            doc["ldr_raw"] = sample.raw;
+            doc["lux"] = lux;
+            doc["sample_interval_ms"] = sample.intervalMs;
+            doc["timestamp"] = sample.timestampMs;
+
+            serial_printf("[%s]\n", topic_path(TOPIC_LDR));
+            serializeJsonPretty(doc, Serial);
+            Serial.println();
+
+            mqtt_publish_json(TOPIC_LDR, doc, true);
+#endif
+        }
+
+        uint32_t interval = sample.active ? LDR_REPORT_INTERVAL : LDR_REPORT_IDLE_INTERVAL;
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(interval));
     }
 }
 
 void start_ldr_task() {
-    xTaskCreatePinnedToCore(
-        ldrTask,
-        "LDRTask",
-        4096,
-        NULL,
-        1,
-        NULL,
-        1
-    );
+    task_plan_start(TASK_ROLE_LDR, ldrTask);
 }
@@ -1,6 +1,11 @@
 // src/light_controller.cpp
 #include "light_controller.h"
+#include "serial_log.h"
 #include "mqtt_client.h"
+#include "relay_state_store.h"
+#include "control_dispatcher.h"
+#include "device_state.h"
+#include "relay_usage.h"
 #include "config.h"
 #include <ArduinoJson.h>
 
@@ -18,126 +23,154 @@ FanState fanState = {false, 0, true, 0};
 struct AutomationConfig {
     bool ldrAutoMode = false;
     bool temperatureAutoMode = true;
-    float tempHotThreshold = 20.0;
-    float tempColdThreshold = 15.0;
+    int32_t tempHotThresholdMilli = 20000;    // Milésimas de °C
+    int32_t tempColdThresholdMilli = 15000;
     int ldrDarkThreshold = 3000;
     int ldrBrightThreshold = 1000;
 } automationConfig;
 
+// Refleja el estado actual en el documento consolidado (solo marca lo que cambió)
+static void mirror_device_state() {
+    for (int i = 0; i < 4; i++) {
+        device_state_set((StateField)(STATE_LIGHT_1 + i), lightStates[i].isOn);
+    }
+    device_state_set(STATE_FAN_ON, fanState.isOn);
+    device_state_set(STATE_FAN_SPEED, fanState.speed);
+    device_state_set(STATE_FAN_AUTO, fanState.autoMode);
+}
+
+// Conmutaciones reales por relé (control, automatización y escenas)
+static portMUX_TYPE switchMux = portMUX_INITIALIZER_UNLOCKED;
+static unsigned long lastSwitchMs[RELAY_TARGETS] = {0};
+static RelaySwitchStats switchStats = {0, 0xFFFFFFFFUL, 0};
+
+static void record_switch(uint8_t target) {
+    unsigned long now = millis();
+    portENTER_CRITICAL(&switchMux);
+    if (lastSwitchMs[target] != 0) {
+        uint32_t gap = now - lastSwitchMs[target];
+        if (gap < switchStats.minGapMs) switchStats.minGapMs = gap;
+        if (relay_interval_left(gap) > 0) switchStats.underInterval++;
+    }
+    lastSwitchMs[target] = now != 0 ? now : 1;
+    switchStats.switches++;
+    portEXIT_CRITICAL(&switchMux);
+}
+
+// Solicita guardar el estado actual (las ráfagas se agrupan en una escritura)
+static void persist_relay_state() {
+    RelayStateSnapshot snapshot;
+    snapshot.zoneMask = get_light_mask();
+    snapshot.fanOn = fanState.isOn;
+    snapshot.fanAutoMode = fanState.autoMode;
+    relay_state_store_request_save(snapshot);
+    mirror_device_state();
+}
+
 // ============================
 // INICIALIZACIÓN
 // ============================
 void light_controller_setup() {
     Serial.println("[LIGHT_CONTROLLER] Inicializando control de luces y ventilador...");
+
+    // Estado de arranque: último estado guardado o todo apagado según la política
+    RelayStateSnapshot restored = {0, false, true};
+#if RELAY_BOOT_POLICY == RELAY_BOOT_RESTORE
+    if (relay_state_store_load(restored)) {
+        serial_printf("[LIGHT_CONTROLLER] Restaurando estado guardado (zonas 0x%02X, ventilador %s)\n",
+                      restored.zoneMask, restored.fanOn ? "ON" : "OFF");
+    } else {
+        restored.zoneMask = 0;
+        restored.fanOn = false;
+        restored.fanAutoMode = true;
+    }
+#endif
     
-    // Configurar pines de relés (luces)
+    // Configurar pines de relés (luces). El nivel se fija antes de pasar a
+    // salida para que el relé no conmute de forma transitoria.
+    unsigned long now = millis();
     for (int i = 0; i < 4; i++) {
+        bool on = (restored.zoneMask >> i) & 0x01;
+        digitalWrite(lightStates[i].pin, on ? HIGH : LOW);
         pinMode(lightStates[i].pin, OUTPUT);
-        digitalWrite(lightStates[i].pin, LOW); // Relés activos en LOW
-        lightStates[i].isOn = false;
-        lightStates[i].lastUpdate = millis();
-        Serial.printf("[LIGHT] Zona %d configurada en pin %d\n", i+1, lightStates[i].pin);
+        lightStates[i].isOn = on;
+        lightStates[i].lastUpdate = now;
+        serial_printf("[LIGHT] Zona %d configurada en pin %d (%s)\n", i+1, lightStates[i].pin, on ? "ON" : "OFF");
     }
     
     // Configurar pin del ventilador
+    digitalWrite(FAN_CONTROL_PIN, restored.fanOn ? HIGH : LOW);
     pinMode(FAN_CONTROL_PIN, OUTPUT);
-    digitalWrite(FAN_CONTROL_PIN, LOW);
-    fanState.isOn = false;
-    fanState.lastUpdate = millis();
+    fanState.isOn = restored.fanOn;
+    fanState.autoMode = restored.fanAutoMode;
+    fanState.lastUpdate = now;
+
+    // Estado de arranque en el registro de actuaciones (se escribe al arrancar su tarea)
+    for (int i = 0; i < 4; i++) {
+        audit_log_record(ACTUATION_BOOT, i + 1, lightStates[i].isOn);
+        relay_usage_record(i, lightStates[i].isOn, ACTUATION_BOOT);
+    }
+    audit_log_record(ACTUATION_BOOT, AUDIT_TARGET_FAN, fanState.isOn);
+    relay_usage_record(USAGE_TARGET_FAN, fanState.isOn, ACTUATION_BOOT);
+    audit_log_record(ACTUATION_BOOT, AUDIT_TARGET_FAN_AUTO, fanState.autoMode);
+    mirror_device_state();
+
+    // A partir de aquí cada cambio se guarda de forma diferida
+    relay_state_store_start();
     
     Serial.println("[LIGHT_CONTROLLER] ✓ Inicialización completada");
     
-    // Publicar estado inicial después de un delay
-    delay(2000);
-    publish_all_lights_status();
-    publish_fan_status();
+    // El estado inicial se publica al conectar con el broker (mqtt_reconnect)
 }
 
 // ============================
 // MANEJO DE MENSAJES MQTT
 // ============================
-void handle_light_message(char* topic, byte* payload, unsigned int length) {
-    // Convertir payload a string
-    String payloadStr = "";
-    for (unsigned int i = 0; i < length; i++) {
-        payloadStr += (char)payload[i];
-    }
-    
-    String topicStr = String(topic);
-    Serial.printf("[LIGHT_HANDLER] Topic: %s | Payload: %s\n", topic, payloadStr.c_str());
+void handle_light_message(TopicId topic, byte* payload, unsigned int length) {
+    serial_printf("[LIGHT_HANDLER] Topic: %s | Payload: %.*s\n", topic_path(topic), (int)length, (const char*)payload);
     
     // Parsear JSON
     StaticJsonDocument<256> doc;
-    DeserializationError error = deserializeJson(doc, payloadStr);
+    DeserializationError error = deserializeJson(doc, payload, length);
     
     if (error) {
-        Serial.printf("[LIGHT_HANDLER] ✗ Error parsing JSON: %s\n", error.c_str());
+        serial_printf("[LIGHT_HANDLER] ✗ Error parsing JSON: %s\n", error.c_str());
         return;
     }
     
-    String command = doc["command"] | "";
-    command.toUpperCase();
+    // Comparación sin distinguir mayúsculas, sin copias a String
+    LightCommand command = parse_light_command(doc["command"] | "");
+    uint8_t before = get_light_mask();   // Solo se republican las zonas que cambien
     
     // ===== CONTROL INDIVIDUAL DE LUCES =====
-    if (topicStr.startsWith("esp32/auditorium/lights/") && topicStr.endsWith("/set")) {
-        // Extraer número de zona del topic
-        int zoneStart = topicStr.indexOf("/lights/") + 8;
-        int zoneEnd = topicStr.indexOf("/set");
-        String zoneStr = topicStr.substring(zoneStart, zoneEnd);
-        int zone = zoneStr.toInt();
-        
-        if (zone >= 1 && zone <= 4) {
-            if (command == "ON") {
-                turn_on_light(zone);
-            } else if (command == "OFF") {
-                turn_off_light(zone);
-            } else if (command == "TOGGLE") {
-                toggle_light(zone);
-            }
-            publish_light_status(zone);
-        } else {
-            Serial.printf("[LIGHT_HANDLER] ✗ Zona inválida: %d\n", zone);
-        }
+    if (topic >= TOPIC_LIGHT_1_SET && topic <= TOPIC_LIGHT_4_SET) {
+        // El número de zona sale directamente del registro de topics
+        int zone = topic - TOPIC_LIGHT_1_SET + 1;
+        apply_light_command(zone, command);
+        publish_light_status(zone);
     }
     
     // ===== CONTROL GLOBAL DE LUCES =====
-    else if (topicStr == "esp32/auditorium/lights/all/set") {
-        if (command == "ON") {
-            turn_on_all_lights();
-        } else if (command == "OFF") {
-            turn_off_all_lights();
-        } else if (command == "TOGGLE") {
-            toggle_all_lights();
+    // Encendido escalonado por pasos; las zonas cambiadas se publican al terminar
+    else if (topic == TOPIC_LIGHT_ALL_SET) {
+        if (command == LIGHT_CMD_ON) {
+            scene_start(SCENARIO_ALL_ON, ACTUATION_MQTT);
+        } else if (command == LIGHT_CMD_OFF) {
+            scene_start(SCENARIO_ALL_OFF, ACTUATION_MQTT);
+        } else if (command == LIGHT_CMD_TOGGLE) {
+            // Si alguna está encendida, apagar todas; si todas están apagadas, encender todas
+            scene_start(before != 0 ? SCENARIO_ALL_OFF : SCENARIO_ALL_ON, ACTUATION_MQTT);
         }
-        publish_all_lights_status();
     }
     
     // ===== ESCENARIOS =====
-    else if (topicStr == "esp32/auditorium/scenario/set") {
-        String scenario = doc["scenario"] | "";
-        scenario.toLowerCase();
-        
-        if (scenario == "all_on" || scenario == "todo_encendido") {
-            set_scenario_all_on();
-        } else if (scenario == "all_off" || scenario == "todo_apagado") {
-            set_scenario_all_off();
-        } else if (scenario == "stage_only" || scenario == "solo_escenario") {
-            set_scenario_stage_only();
-        } else if (scenario == "hallways_only" || scenario == "solo_pasillos") {
-            set_scenario_hallways_only();
-        }
-        publish_all_lights_status();
+    else if (topic == TOPIC_SCENARIO_SET) {
+        run_scenario(parse_scenario(doc["scenario"] | ""));
     }
     
     // ===== CONTROL DEL VENTILADOR =====
-    else if (topicStr == "esp32/auditorium/fan/set") {
-        if (command == "ON") {
-            turn_on_fan();
-        } else if (command == "OFF") {
-            turn_off_fan();
-        } else if (command == "TOGGLE") {
-            toggle_fan();
-        }
+    else if (topic == TOPIC_FAN_SET) {
+        apply_fan_command(command);
         
         // Configurar modo automático si se especifica
         if (doc.containsKey("auto_mode")) {
@@ -149,39 +182,120 @@ void handle_light_message(char* topic, byte* payload, unsigned int length) {
     }
 }
 
+// ============================
+// COMANDOS (comunes a JSON y binario)
+// ============================
+LightCommand parse_light_command(const char* text) {
+    if (strcasecmp(text, "ON") == 0) return LIGHT_CMD_ON;
+    if (strcasecmp(text, "OFF") == 0) return LIGHT_CMD_OFF;
+    if (strcasecmp(text, "TOGGLE") == 0) return LIGHT_CMD_TOGGLE;
+    return LIGHT_CMD_NONE;
+}
+
+Scenario parse_scenario(const char* text) {
+    if (strcasecmp(text, "all_on") == 0 || strcasecmp(text, "todo_encendido") == 0) return SCENARIO_ALL_ON;
+    if (strcasecmp(text, "all_off") == 0 || strcasecmp(text, "todo_apagado") == 0) return SCENARIO_ALL_OFF;
+    if (strcasecmp(text, "stage_only") == 0 || strcasecmp(text, "solo_escenario") == 0) return SCENARIO_STAGE_ONLY;
+    if (strcasecmp(text, "hallways_only") == 0 || strcasecmp(text, "solo_pasillos") == 0) return SCENARIO_HALLWAYS_ONLY;
+    if (strcasecmp(text, "emergency") == 0 || strcasecmp(text, "emergencia") == 0) return SCENARIO_EMERGENCY;
+    return SCENARIO_NONE;
+}
+
+void apply_light_command(int zone, LightCommand command, ActuationSource source) {
+    if (zone < 1 || zone > 4) {
+        serial_printf("[LIGHT_HANDLER] ✗ Zona inválida: %d\n", zone);
+        return;
+    }
+    switch (command) {
+        case LIGHT_CMD_ON:     turn_on_light(zone, source);  break;
+        case LIGHT_CMD_OFF:    turn_off_light(zone, source); break;
+        case LIGHT_CMD_TOGGLE: toggle_light(zone, source);   break;
+        default: break;
+    }
+}
+
+void apply_fan_command(LightCommand command, ActuationSource source) {
+    switch (command) {
+        case LIGHT_CMD_ON:     turn_on_fan(source);  break;
+        case LIGHT_CMD_OFF:    turn_off_fan(source); break;
+        case LIGHT_CMD_TOGGLE: toggle_fan(source);   break;
+        default: break;
+    }
+}
+
+void run_scenario(Scenario scenario) {
+    if (scenario != SCENARIO_NONE) scene_start(scenario, ACTUATION_SCENE);
+}
+
+uint8_t get_light_mask() {
+    uint8_t mask = 0;
+    for (int i = 0; i < 4; i++) {
+        if (lightStates[i].isOn) mask |= (1 << i);
+    }
+    return mask;
+}
+
+uint8_t apply_light_mask(uint8_t mask, ActuationSource source) {
+    // Una sola pasada: solo se conmutan las zonas cuyo estado cambia
+    uint8_t changed = (get_light_mask() ^ mask) & 0x0F;
+    for (int i = 0; i < 4; i++) {
+        if (!(changed & (1 << i))) continue;
+        if (mask & (1 << i)) {
+            turn_on_light(i + 1, source);
+        } else {
+            turn_off_light(i + 1, source);
+        }
+    }
+    return changed;
+}
+
 // ============================
 // CONTROL INDIVIDUAL DE LUCES
 // ============================
-void turn_on_light(int zone) {
+void turn_on_light(int zone, ActuationSource source) {
     if (zone < 1 || zone > 4) return;
     
     int index = zone - 1;
+    bool changed = !lightStates[index].isOn;
     digitalWrite(lightStates[index].pin, HIGH); // Activar relé
     lightStates[index].isOn = true;
     lightStates[index].lastUpdate = millis();
+    persist_relay_state();
+    if (changed) {
+        audit_log_record(source, zone, true);
+        relay_usage_record(index, true, source);
+        record_switch(index);
+    }
     
-    Serial.printf("[LIGHT] ✓ Zona %d (%s) ENCENDIDA\n", zone, lightStates[index].name.c_str());
+    serial_printf("[LIGHT] ✓ Zona %d (%s) ENCENDIDA\n", zone, lightStates[index].name);
 }
 
-void turn_off_light(int zone) {
+void turn_off_light(int zone, ActuationSource source) {
     if (zone < 1 || zone > 4) return;
     
     int index = zone - 1;
+    bool changed = lightStates[index].isOn;
     digitalWrite(lightStates[index].pin, LOW); // Desactivar relé
     lightStates[index].isOn = false;
     lightStates[index].lastUpdate = millis();
+    persist_relay_state();
+    if (changed) {
+        audit_log_record(source, zone, false);
+        relay_usage_record(index, false, source);
+        record_switch(index);
+    }
     
-    Serial.printf("[LIGHT] ✓ Zona %d (%s) APAGADA\n", zone, lightStates[index].name.c_str());
+    serial_printf("[LIGHT] ✓ Zona %d (%s) APAGADA\n", zone, lightStates[index].name);
 }
 
-void toggle_light(int zone) {
+void toggle_light(int zone, ActuationSource source) {
     if (zone < 1 || zone > 4) return;
     
     int index = zone - 1;
     if (lightStates[index].isOn) {
-        turn_off_light(zone);
+        turn_off_light(zone, source);
     } else {
-        turn_on_light(zone);
+        turn_on_light(zone, source);
     }
 }
 
@@ -190,71 +304,52 @@ bool is_light_on(int zone) {
     return lightStates[zone - 1].isOn;
 }
 
-// ============================
-// CONTROL GLOBAL DE LUCES
-// ============================
-void turn_on_all_lights() {
-    Serial.println("[LIGHT] Encendiendo todas las luces...");
-    for (int i = 1; i <= 4; i++) {
-        turn_on_light(i);
-        delay(100); // Pequeño delay entre activaciones
-    }
-}
-
-void turn_off_all_lights() {
-    Serial.println("[LIGHT] Apagando todas las luces...");
-    for (int i = 1; i <= 4; i++) {
-        turn_off_light(i);
-        delay(100);
-    }
-}
-
-void toggle_all_lights() {
-    // Si alguna está encendida, apagar todas; si todas están apagadas, encender todas
-    bool anyOn = false;
-    for (int i = 0; i < 4; i++) {
-        if (lightStates[i].isOn) {
-            anyOn = true;
-            break;
-        }
-    }
-    
-    if (anyOn) {
-        turn_off_all_lights();
-    } else {
-        turn_on_all_lights();
-    }
-}
-
 // ============================
 // CONTROL DEL VENTILADOR
 // ============================
-void turn_on_fan() {
+void turn_on_fan(ActuationSource source) {
+    bool changed = !fanState.isOn;
     digitalWrite(FAN_CONTROL_PIN, HIGH);  // ✓ Corregido: usar FAN_CONTROL_PIN consistentemente
     fanState.isOn = true;
     fanState.lastUpdate = millis();
+    persist_relay_state();
+    if (changed) {
+        audit_log_record(source, AUDIT_TARGET_FAN, true);
+        relay_usage_record(USAGE_TARGET_FAN, true, source);
+        record_switch(RELAY_TARGET_FAN);
+    }
     Serial.println("[FAN] ✓ Ventilador ENCENDIDO");
 }
 
-void turn_off_fan() {
+void turn_off_fan(ActuationSource source) {
+    bool changed = fanState.isOn;
     digitalWrite(FAN_CONTROL_PIN, LOW);
     fanState.isOn = false;
     fanState.speed = 0;
     fanState.lastUpdate = millis();
+    persist_relay_state();
+    if (changed) {
+        audit_log_record(source, AUDIT_TARGET_FAN, false);
+        relay_usage_record(USAGE_TARGET_FAN, false, source);
+        record_switch(RELAY_TARGET_FAN);
+    }
     Serial.println("[FAN] ✓ Ventilador APAGADO");
 }
 
-void toggle_fan() {
+void toggle_fan(ActuationSource source) {
     if (fanState.isOn) {
-        turn_off_fan();
+        turn_off_fan(source);
     } else {
-        turn_on_fan();
+        turn_on_fan(source);
     }
 }
 
-void set_fan_auto_mode(bool enabled) {
+void set_fan_auto_mode(bool enabled, ActuationSource source) {
+    bool changed = fanState.autoMode != enabled;
     fanState.autoMode = enabled;
-    Serial.printf("[FAN] Modo automático: %s\n", enabled ? "ACTIVADO" : "DESACTIVADO");
+    persist_relay_state();
+    if (changed) audit_log_record(source, AUDIT_TARGET_FAN_AUTO, enabled);
+    serial_printf("[FAN] Modo automático: %s\n", enabled ? "ACTIVADO" : "DESACTIVADO");
 }
 
 bool is_fan_on() {
@@ -262,39 +357,125 @@ bool is_fan_on() {
 }
 
 // ============================
-// ESCENARIOS PREDEFINIDOS
+// ESCENAS POR PASOS
 // ============================
-void set_scenario_all_on() {
-    Serial.println("[SCENARIO] Ejecutando: Todas las luces encendidas");
-    turn_on_all_lights();
+// Cada paso conmuta una zona y fija la espera hasta el siguiente (mismos
+// tiempos que las antiguas secuencias con delay())
+struct SceneStep {
+    uint8_t zone;
+    bool on;
+    uint16_t delayMs;
+};
+
+static const SceneStep SCENE_ALL_ON[] = {
+    {1, true, 100}, {2, true, 100}, {3, true, 100}, {4, true, 0}
+};
+static const SceneStep SCENE_ALL_OFF[] = {
+    {1, false, 100}, {2, false, 100}, {3, false, 100}, {4, false, 0}
+};
+static const SceneStep SCENE_STAGE_ONLY[] = {
+    {1, false, 100}, {2, false, 100}, {3, false, 100}, {4, false, 600}, {1, true, 0}
+};
+static const SceneStep SCENE_HALLWAYS_ONLY[] = {
+    {1, false, 200}, {2, true, 0}, {3, true, 0}, {4, true, 0}
+};
+static const SceneStep SCENE_EMERGENCY[] = {
+    {1, true, 0}, {2, true, 0}, {3, true, 0}, {4, true, 0}
+};
+
+struct SceneRun {
+    const SceneStep* steps;   // NULL = sin escena en curso
+    uint8_t count;
+    uint8_t next;
+    unsigned long dueAt;
+    ActuationSource source;
+    uint8_t startMask;        // Zonas encendidas al empezar (para publicar lo cambiado)
+};
+
+static SceneRun sceneRun = {NULL, 0, 0, 0, ACTUATION_SCENE, 0};
+
+// Indexada por Scenario
+struct SceneDef {
+    const SceneStep* steps;
+    uint8_t count;
+    const char* label;
+};
+
+#define SCENE_STEPS(table)  table, sizeof(table) / sizeof(table[0])
+
+static const SceneDef SCENES[] = {
+    { NULL, 0, "" },
+    { SCENE_STEPS(SCENE_ALL_ON),        "Todas las luces encendidas" },
+    { SCENE_STEPS(SCENE_ALL_OFF),       "Todas las luces apagadas" },
+    { SCENE_STEPS(SCENE_STAGE_ONLY),    "Solo escenario" },
+    { SCENE_STEPS(SCENE_HALLWAYS_ONLY), "Solo pasillos" },
+    { SCENE_STEPS(SCENE_EMERGENCY),     "Emergencia" },
+};
+
+static_assert(sizeof(SCENES) / sizeof(SCENES[0]) == SCENARIO_EMERGENCY + 1, "SCENES debe cubrir todos los Scenario");
+
+void scene_start(Scenario scenario, ActuationSource source) {
+    if (scenario == SCENARIO_NONE || scenario > SCENARIO_EMERGENCY) return;
+    const SceneDef &scene = SCENES[scenario];
+
+    // Una escena nueva sustituye a la que estuviera a medias
+    uint8_t changed = scene_cancel();
+    publish_changed_lights(changed);
+
+    serial_printf("[SCENARIO] Ejecutando: %s\n", scene.label);
+    if (scenario == SCENARIO_EMERGENCY && fanState.isOn) {
+        turn_off_fan(source);
+        publish_fan_status();
+    }
+
+    sceneRun.steps = scene.steps;
+    sceneRun.count = scene.count;
+    sceneRun.next = 0;
+    sceneRun.dueAt = millis();
+    sceneRun.source = source;
+    sceneRun.startMask = get_light_mask();
 }
 
-void set_scenario_all_off() {
-    Serial.println("[SCENARIO] Ejecutando: Todas las luces apagadas");
-    turn_off_all_lights();
+uint32_t scene_run_due() {
+    while (sceneRun.steps != NULL) {
+        unsigned long now = millis();
+        long wait = (long)(sceneRun.dueAt - now);
+        if (wait > 0) return (uint32_t)wait;
+
+        const SceneStep &step = sceneRun.steps[sceneRun.next++];
+        if (step.on) {
+            turn_on_light(step.zone, sceneRun.source);
+        } else {
+            turn_off_light(step.zone, sceneRun.source);
+        }
+
+        if (sceneRun.next >= sceneRun.count) {
+            sceneRun.steps = NULL;
+            publish_changed_lights(sceneRun.startMask ^ get_light_mask());
+            break;
+        }
+        sceneRun.dueAt = now + step.delayMs;
+    }
+    return SCENE_IDLE;
 }
 
-void set_scenario_stage_only() {
-    Serial.println("[SCENARIO] Ejecutando: Solo escenario");
-    turn_off_all_lights();
-    delay(500);
-    turn_on_light(1); // Solo escenario principal
+bool scene_active() {
+    return sceneRun.steps != NULL;
 }
 
-void set_scenario_hallways_only() {
-    Serial.println("[SCENARIO] Ejecutando: Solo pasillos");
-    turn_off_light(1); // Apagar escenario
-    delay(200);
-    turn_on_light(2);  // Pasillo derecho A
-    turn_on_light(3);  // Pasillo derecho B
-    turn_on_light(4);  // Pasillo izquierdo
+uint8_t scene_cancel() {
+    if (sceneRun.steps == NULL) return 0;
+    serial_printf("[SCENARIO] ⚠ Escena interrumpida en el paso %u de %u\n", sceneRun.next, sceneRun.count);
+    sceneRun.steps = NULL;
+    return (sceneRun.startMask ^ get_light_mask()) & 0x0F;
 }
 
 // ============================
 // PUBLICACIÓN DE ESTADOS
 // ============================
 void publish_light_status(int zone) {
-    if (zone < 1 || zone > 4 || !mqtt_is_connected()) return;
+    // Sin topics por zona el estado solo sale en el documento consolidado
+    if (!DEVICE_STATE_LEGACY_TOPICS || zone < 1 || zone > 4 || !mqtt_is_connected()) return;
     
     int index = zone - 1;
     StaticJsonDocument<200> doc;
@@ -305,65 +486,72 @@ void publish_light_status(int zone) {
     doc["timestamp"] = lightStates[index].lastUpdate;
     doc["pin"] = lightStates[index].pin;
     
-    String json;
-    serializeJson(doc, json);
+    mqtt_publish_json(light_state_topic(zone), doc);
+}
+
+void fill_lights_status(JsonDocument &doc) {
+    doc["total_zones"] = 4;
+    doc["active_zones"] = 0;
     
-    String topic = "esp32/auditorium/lights/" + String(zone) + "/state";
-    mqtt_publish(topic.c_str(), json);
+    JsonArray zones = doc.createNestedArray("zones");
+    for (int i = 0; i < 4; i++) {
+        JsonObject zone = zones.createNestedObject();
+        zone["id"] = i + 1;
+        zone["name"] = lightStates[i].name;
+        zone["status"] = lightStates[i].isOn ? "ON" : "OFF";
+        if (lightStates[i].isOn) {
+            doc["active_zones"] = doc["active_zones"].as<int>() + 1;
+        }
+    }
+    
+    bool allOn = doc["active_zones"].as<int>() == 4;
+    doc["all_lights_on"] = allOn;
+    doc["timestamp"] = millis();
 }
 
 void publish_all_lights_status() {
+    publish_changed_lights(0x0F);
+}
+
+// Zonas de la máscara (bit i = zona i+1) y, si hay alguna, el estado global
+void publish_changed_lights(uint8_t changedMask) {
+    changedMask &= 0x0F;
+    if (changedMask == 0) return;
+
     for (int i = 1; i <= 4; i++) {
-        publish_light_status(i);
-        delay(100); // Evitar saturar MQTT
+        if (changedMask & (1 << (i - 1))) {
+            publish_light_status(i);   // Sale por la cola de publicación, sin esperas
+        }
     }
     
     // Publicar estado global
-    if (mqtt_is_connected()) {
+    if (DEVICE_STATE_LEGACY_TOPICS && mqtt_is_connected()) {
         StaticJsonDocument<300> doc;
-        doc["total_zones"] = 4;
-        doc["active_zones"] = 0;
-        
-        JsonArray zones = doc.createNestedArray("zones");
-        for (int i = 0; i < 4; i++) {
-            JsonObject zone = zones.createNestedObject();
-            zone["id"] = i + 1;
-            zone["name"] = lightStates[i].name;
-            zone["status"] = lightStates[i].isOn ? "ON" : "OFF";
-            if (lightStates[i].isOn) {
-                doc["active_zones"] = doc["active_zones"].as<int>() + 1;
-            }
-        }
-        
-        bool allOn = doc["active_zones"].as<int>() == 4;
-        doc["all_lights_on"] = allOn;
-        doc["timestamp"] = millis();
-        
-        String json;
-        serializeJson(doc, json);
-        mqtt_publish("esp32/auditorium/lights/status", json);
+        fill_lights_status(doc);
+        mqtt_publish_json(TOPIC_LIGHTS_STATUS, doc);
     }
 }
 
-void publish_fan_status() {
-    if (!mqtt_is_connected()) return;
-    
-    StaticJsonDocument<200> doc;
+void fill_fan_status(JsonDocument &doc) {
     doc["status"] = fanState.isOn ? "ON" : "OFF";
     doc["speed"] = fanState.speed;
     doc["auto_mode"] = fanState.autoMode;
     doc["timestamp"] = fanState.lastUpdate;
     doc["pin"] = FAN_CONTROL_PIN;
+}
+
+void publish_fan_status() {
+    if (!DEVICE_STATE_LEGACY_TOPICS || !mqtt_is_connected()) return;
     
-    String json;
-    serializeJson(doc, json);
-    mqtt_publish(MQTT_TOPIC_FAN_STATE, json);
+    StaticJsonDocument<200> doc;
+    fill_fan_status(doc);
+    mqtt_publish_json(TOPIC_FAN_STATE, doc);
 }
 
 // ============================
 // AUTOMATIZACIÓN
 // ============================
-void check_temperature_automation(float temperature) {
+void check_temperature_automation(int32_t milliCelsius) {
     // ✓ Corregido: Solo actuar si el modo automático está habilitado
     if (!automationConfig.temperatureAutoMode || !fanState.autoMode) return;
     
@@ -376,17 +564,16 @@ void check_temperature_automation(float temperature) {
         return;
     }
     
-    if (temperature >= automationConfig.tempHotThreshold && !fanState.isOn) {
-        Serial.printf("[AUTO] Temperatura alta detectada (%.1f°C) - Encendiendo ventilador\n", temperature);
-        turn_on_fan();
+    // El relé lo conmuta la tarea de control (en orden con los comandos y los urgentes)
+    if (milliCelsius >= automationConfig.tempHotThresholdMilli && !fanState.isOn) {
+        serial_printf("[AUTO] Temperatura alta detectada (%ld m°C) - Encendiendo ventilador\n", (long)milliCelsius);
+        control_dispatcher_request_fan(LIGHT_CMD_ON, ACTUATION_AUTOMATION);
         lastAutoAction = currentTime;
-        publish_fan_status();
-    } else if (temperature <= automationConfig.tempColdThreshold && fanState.isOn) {
+    } else if (milliCelsius <= automationConfig.tempColdThresholdMilli && fanState.isOn) {
         // Solo apagar automáticamente si la última acción fue automática
         if (currentTime - lastAutoAction < 300000) { // 5 minutos
-            Serial.printf("[AUTO] Temperatura normal (%.1f°C) - Apagando ventilador\n", temperature);
-            turn_off_fan();
-            publish_fan_status();
+            serial_printf("[AUTO] Temperatura normal (%ld m°C) - Apagando ventilador\n", (long)milliCelsius);
+            control_dispatcher_request_fan(LIGHT_CMD_OFF, ACTUATION_AUTOMATION);
         }
     }
 }
@@ -400,14 +587,13 @@ void check_ldr_automation(int ldrValue) {
         if (lightStates[i].isOn) lightsOn++;
     }
     
+    // La secuencia la ejecuta la tarea de control (puede interrumpirla un comando urgente)
     if (ldrValue >= automationConfig.ldrDarkThreshold && lightsOn == 0) {
-        Serial.printf("[AUTO] Oscuridad detectada (LDR: %d) - Encendiendo luces\n", ldrValue);
-        turn_on_all_lights();
-        publish_all_lights_status();
+        serial_printf("[AUTO] Oscuridad detectada (LDR: %d) - Encendiendo luces\n", ldrValue);
+        control_dispatcher_request_scene(SCENARIO_ALL_ON, ACTUATION_AUTOMATION);
     } else if (ldrValue <= automationConfig.ldrBrightThreshold && lightsOn > 0) {
-        Serial.printf("[AUTO] Luminosidad alta detectada (LDR: %d) - Apagando luces\n", ldrValue);
-        turn_off_all_lights();
-        publish_all_lights_status();
+        serial_printf("[AUTO] Luminosidad alta detectada (LDR: %d) - Apagando luces\n", ldrValue);
+        control_dispatcher_request_scene(SCENARIO_ALL_OFF, ACTUATION_AUTOMATION);
     }
 }
 
@@ -423,4 +609,38 @@ LightState get_light_state(int zone) {
 
 FanState get_fan_state() {
     return fanState;
+}
+
+unsigned long relay_last_switch_ms(uint8_t target) {
+    if (target >= RELAY_TARGETS) return 0;
+    portENTER_CRITICAL(&switchMux);
+    unsigned long last = lastSwitchMs[target];
+    portEXIT_CRITICAL(&switchMux);
+    return last;
+}
+
+// Con RELAY_MIN_SWITCH_INTERVAL_MS = 0 (benchmarks sin límite) no se compara:
+// elapsed < 0 nunca se cumple y -Wtype-limits lo avisa
+uint32_t relay_interval_left(uint32_t elapsedMs) {
+#if RELAY_MIN_SWITCH_INTERVAL_MS > 0
+    return elapsedMs < RELAY_MIN_SWITCH_INTERVAL_MS ? RELAY_MIN_SWITCH_INTERVAL_MS - elapsedMs : 0;
+#else
+    (void)elapsedMs;
+    return 0;
+#endif
+}
+
+RelaySwitchStats relay_switch_stats() {
+    portENTER_CRITICAL(&switchMux);
+    RelaySwitchStats copy = switchStats;
+    portEXIT_CRITICAL(&switchMux);
+    return copy;
+}
+
+void relay_switch_stats_reset() {
+    portENTER_CRITICAL(&switchMux);
+    switchStats.switches = 0;
+    switchStats.minGapMs = 0xFFFFFFFFUL;
+    switchStats.underInterval = 0;
+    portEXIT_CRITICAL(&switchMux);
 }
\ No newline at end of file
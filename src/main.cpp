@@ -1,6 +1,7 @@
 // src/main.cpp
 
 #include <Arduino.h>
+#include "serial_log.h"
 #include "wifi_manager.h"
 #include "json_formatter.h"
 #include "memory_monitor.h"
@@ -10,40 +11,102 @@
 #include "temperature_sensor.h"
 #include "ldr_sensor.h"
 #include "light_controller.h"  // <-- NUEVO: Incluir el controlador de luces
+#include "boot_profiler.h"
+#include "sensor_history.h"
+#include "task_supervisor.h"
+#include "task_plan.h"
+#include "control_dispatcher.h"
+#include "placement_benchmark.h"
+#include "alloc_guard.h"
+#include "adaptive_sampling.h"
+#include "audit_log.h"
+#include "device_state.h"
+#include "sensor_calibration.h"
+#include "relay_usage.h"
+#include "udp_control.h"
+#include "micro_benchmark.h"
 
 // Variables globales para automatización
-float lastTemperature = 0.0;
+int32_t lastTemperatureMilli = 0;   // Milésimas de °C
 int lastLdrValue = 0;
 unsigned long lastAutomationCheck = 0;
 
-// Tarea que imprime y publica estado WiFi
+// Check-in del bucle principal (bombeo MQTT) en el supervisor
+static SupervisedTaskId loopSupervisorId = SUPERVISOR_INVALID_ID;
+
+// Tarea que muestrea el RSSI y publica el estado WiFi solo cuando cambia
 void wifiInfoTask(void *parameter) {
+    uint32_t publishedIdentity = 0;
+    int publishedRssi = 0;
+    bool published = false;
+
     while (true) {
-        String wifiJson = generate_wifi_json();
-        Serial.println("[wifi/status]");
-        Serial.println(wifiJson);
-        mqtt_publish(MQTT_TOPIC_WIFI, wifiJson);
-        vTaskDelay(pdMS_TO_TICKS(WIFI_INFO_INTERVAL));
+        wifi_sample_rssi();
+        WifiSnapshot wifi = wifi_get_snapshot();
+
+        // El documento consolidado aplica su propia banda muerta
+        device_state_set(STATE_WIFI_CONNECTED, wifi.connected);
+        device_state_set_text(STATE_WIFI_SSID, wifi.ssid);
+        device_state_set_text(STATE_WIFI_IP, wifi.ip);
+        device_state_set(STATE_WIFI_RSSI, wifi.rssi);
+
+        bool identityChanged = !published || wifi.identityVersion != publishedIdentity;
+        bool rssiChanged = abs(wifi.rssi - publishedRssi) >= WIFI_RSSI_DEADBAND_DB;
+
+        if (DEVICE_STATE_LEGACY_TOPICS && (identityChanged || rssiChanged) && mqtt_is_connected()) {
+            StaticJsonDocument<384> doc;
+            generate_wifi_json(wifi, doc);
+            Serial.println("[wifi/status]");
+            serializeJsonPretty(doc, Serial);
+            Serial.println();
+            // Si no sale (cola llena), se reintenta en la siguiente muestra
+            if (mqtt_publish_json(TOPIC_WIFI_STATUS, doc, true)) {
+                publishedIdentity = wifi.identityVersion;
+                publishedRssi = wifi.rssi;
+                published = true;
+            }
+        }
+        vTaskDelay(pdMS_TO_TICKS(WIFI_RSSI_SAMPLE_INTERVAL));
     }
 }
 
 // Tarea que imprime y publica estado de memoria
 void memoryInfoTask(void *parameter) {
+    uint32_t reportedAllocations = 0;
+
     while (true) {
-        String memJson = generate_memory_json();
+        AllocGuardStats allocs = alloc_guard_get_stats();
+        if (allocs.allocations != reportedAllocations) {
+            serial_printf("[ALLOC] ⚠ %lu reservas de heap tras setup (primera: %s, %lu bytes)\n",
+                          (unsigned long)allocs.allocations, allocs.firstTask, (unsigned long)allocs.firstSize);
+            reportedAllocations = allocs.allocations;
+        }
+
+        device_state_set(STATE_HEAP_FREE, ESP.getFreeHeap());
+        device_state_set(STATE_HEAP_MIN_FREE, ESP.getMinFreeHeap());
+
+#if DEVICE_STATE_LEGACY_TOPICS
+        StaticJsonDocument<512> doc;
+        generate_memory_json(doc);
         Serial.println("[system/memory]");
-        Serial.println(memJson);
-        mqtt_publish(MQTT_TOPIC_MEMORY, memJson);
-        vTaskDelay(pdMS_TO_TICKS(WIFI_INFO_INTERVAL));
+        serializeJsonPretty(doc, Serial);
+        Serial.println();
+        mqtt_publish_json(TOPIC_SYSTEM_MEMORY, doc, true);
+#endif
+        vTaskDelay(pdMS_TO_TICKS(MEMORY_REPORT_INTERVAL));
     }
 }
 
 // NUEVA TAREA: Automatización basada en sensores
 void automationTask(void *parameter) {
+    SupervisedTaskId svId = supervisor_register("automation", AUTOMATION_CHECK_INTERVAL, false);
+
     while (true) {
+        supervisor_checkin(svId);
+
         // Chequear automatización solo si hay datos de sensores
-        if (lastTemperature > 0 || lastLdrValue > 0) {
-            check_temperature_automation(lastTemperature);
+        if (lastTemperatureMilli > 0 || lastLdrValue > 0) {
+            check_temperature_automation(lastTemperatureMilli);
             check_ldr_automation(lastLdrValue);
         }
         
@@ -52,72 +115,98 @@ void automationTask(void *parameter) {
 }
 
 // NUEVA TAREA: Monitoreo de sensores para automatización
+// Único lector del ADC: cada canal se muestrea a su ritmo adaptativo
 void sensorMonitorTask(void *parameter) {
+    SupervisedTaskId svId = supervisor_register("sensor_monitor", SENSOR_MONITOR_MAX_SLEEP, true);
+    analogReadResolution(ADC_RESOLUTION_BITS);
+
     while (true) {
+        supervisor_checkin(svId);
+        uint32_t now = millis();
+
         // Leer temperatura
-        analogReadResolution(ADC_RESOLUTION_BITS);
-        int tempRaw = analogRead(TEMP_SENSOR_PIN);
-        float voltage = (tempRaw / float(ADC_MAX_VALUE)) * ADC_REF_VOLTAGE;
-        lastTemperature = voltage * 100.0;  // LM35: 10mV/°C
+        if (adaptive_sampling_due(SENSOR_CHANNEL_TEMPERATURE, now)) {
+            int tempRaw = analogRead(TEMP_SENSOR_PIN);
+            lastTemperatureMilli = adc_to_millicelsius(tempRaw);   // Tabla calibrada, sin coma flotante
+
+            // Histórico y muestreo en centésimas de °C
+            int16_t centi = (int16_t)(lastTemperatureMilli / 10);
+            adaptive_sampling_update(SENSOR_CHANNEL_TEMPERATURE, now, centi, (uint16_t)tempRaw);
+            sensor_history_add(SENSOR_CHANNEL_TEMPERATURE, centi);
+        }
         
         // Leer LDR
-        int ldrRaw = analogRead(LDR_SENSOR_PIN);
-        lastLdrValue = ldrRaw;
+        if (adaptive_sampling_due(SENSOR_CHANNEL_LDR, now)) {
+            int ldrRaw = analogRead(LDR_SENSOR_PIN);
+            lastLdrValue = ldrRaw;
+            adaptive_sampling_update(SENSOR_CHANNEL_LDR, now, (int16_t)ldrRaw, (uint16_t)ldrRaw);
+            sensor_history_add(SENSOR_CHANNEL_LDR, (int16_t)ldrRaw);
+        }
         
         // Debug cada 10 segundos
         static unsigned long lastDebug = 0;
         if (millis() - lastDebug > 10000) {
-            Serial.printf("[SENSOR_MONITOR] Temp: %.1f°C, LDR: %d\n", lastTemperature, lastLdrValue);
+            serial_printf("[SENSOR_MONITOR] Temp: %ld m°C (%lu ms), LDR: %d (%lu ms)\n",
+                          (long)lastTemperatureMilli, (unsigned long)adaptive_sampling_get(SENSOR_CHANNEL_TEMPERATURE).intervalMs,
+                          lastLdrValue, (unsigned long)adaptive_sampling_get(SENSOR_CHANNEL_LDR).intervalMs);
             lastDebug = millis();
         }
         
-        vTaskDelay(pdMS_TO_TICKS(1000)); // Leer cada segundo
+        // Dormir hasta la próxima muestra (acotado por el check-in del supervisor)
+        uint32_t wait = adaptive_sampling_next_due_in(millis());
+        if (wait > SENSOR_MONITOR_MAX_SLEEP) wait = SENSOR_MONITOR_MAX_SLEEP;
+        vTaskDelay(pdMS_TO_TICKS(wait > 0 ? wait : 1));
     }
 }
 
 void setup() {
     Serial.begin(115200);
-    delay(1000);
+
+    // Lo primero: relés en estado seguro (sin esperas previas)
+    light_controller_setup();
+    boot_profiler_mark(BOOT_PHASE_GPIO_SAFE);
     
     Serial.println("========================================");
     Serial.println("🏢 ESP32 AUDITORIUM CONTROLLER v2.0");
     Serial.println("========================================");
 
-    // Inicializar WiFi y MQTT
+    boot_profiler_init();
+
+    // WiFi y MQTT avanzan en segundo plano (por eventos) mientras se crean las tareas
     Serial.println("[SETUP] Inicializando WiFi...");
-    wifi_init();    // Inicializa y conecta a WiFi
+    wifi_init();    // Lanza la conexión WiFi sin bloquear
     
     Serial.println("[SETUP] Configurando MQTT...");
     mqtt_setup();   // Configura servidor y callback MQTT
-    
-    // NUEVO: Inicializar control de luces y ventilador
-    Serial.println("[SETUP] Inicializando control de luces y ventilador...");
-    light_controller_setup();
 
-    // Crear tareas FreeRTOS
-    Serial.println("[SETUP] Creando tareas FreeRTOS...");
+    // Histórico de sensores y muestreo adaptativo (antes de la tarea que los alimenta)
+    sensor_history_init();
+    adaptive_sampling_init();
+    sensor_calibration_init();
+
+    // Registro de actuaciones en flash (recoge también el estado de arranque)
+    audit_log_start();
+
+    // Contadores de uso de relés (suma lo guardado en NVS al estado de arranque)
+    relay_usage_start();
+
+    // Crear tareas FreeRTOS (núcleo, prioridad y pila en task_plan.cpp)
+    serial_printf("[SETUP] Creando tareas FreeRTOS (plan %s)...\n", task_plan_name());
+
+    // Tarea de control: ejecuta los comandos recibidos por MQTT
+    control_dispatcher_start();
+
+    // Control local por UDP (entrega en la misma tarea de control)
+    udp_control_start();
+
+    // Documento de estado consolidado (completo al conectar, luego deltas)
+    device_state_start();
     
     // Tarea WiFi
-    xTaskCreatePinnedToCore(
-        wifiInfoTask,
-        "WiFiInfoTask",
-        4096,
-        NULL,
-        1,
-        NULL,
-        1
-    );
+    task_plan_start(TASK_ROLE_WIFI_INFO, wifiInfoTask);
 
     // Tarea memoria
-    xTaskCreatePinnedToCore(
-        memoryInfoTask,
-        "MemoryInfoTask",
-        4096,
-        NULL,
-        1,
-        NULL,
-        1
-    );
+    task_plan_start(TASK_ROLE_MEMORY_INFO, memoryInfoTask);
 
     // Tarea de status (heartbeat MQTT)
     start_status_reporter_task();
@@ -129,42 +218,39 @@ void setup() {
     start_ldr_task();
     
     // NUEVAS TAREAS: Monitoreo de sensores y automatización
-    xTaskCreatePinnedToCore(
-        sensorMonitorTask,
-        "SensorMonitorTask",
-        4096,
-        NULL,
-        2,  // Prioridad más alta
-        NULL,
-        0   // Core 0
-    );
+    task_plan_start(TASK_ROLE_SENSOR_MONITOR, sensorMonitorTask);
     
-    xTaskCreatePinnedToCore(
-        automationTask,
-        "AutomationTask",
-        4096,
-        NULL,
-        1,
-        NULL,
-        0   // Core 0
-    );
+#if !BENCHMARK_MODE
+    // Con los micro-benchmarks el único escritor de los relés es la tarea que mide
+    task_plan_start(TASK_ROLE_AUTOMATION, automationTask);
+#endif
+
+    // Supervisor de plazos (el bucle principal hace check-in en loop())
+    loopSupervisorId = supervisor_register("mqtt_loop", 100, true);
+    start_supervisor_task();
+
+#if TASK_PLAN_BENCHMARK
+    placement_benchmark_start();
+#endif
+
+#if BENCHMARK_MODE
+    micro_benchmark_start();
+#endif
 
+    boot_profiler_mark(BOOT_PHASE_SETUP_DONE);
+    alloc_guard_arm();   // A partir de aquí las tareas no deberían reservar heap
     Serial.println("[SETUP] ✓ Inicialización completada");
     Serial.println("========================================");
-    
-    // Esperar a que MQTT se conecte y publicar estado inicial
-    delay(3000);
-    if (mqtt_is_connected()) {
-        publish_all_lights_status();
-        publish_fan_status();
-        Serial.println("[SETUP] ✓ Estados iniciales publicados");
-    }
+
+    // Los estados iniciales se publican al conectar con el broker (mqtt_reconnect)
 }
 
 void loop() {
+    supervisor_checkin(loopSupervisorId);
+
     // Mantener la conexión MQTT y manejar mensajes entrantes
     mqtt_loop();
     
-    // Liberar CPU brevemente para otras tareas
-    vTaskDelay(pdMS_TO_TICKS(100));
+    // Liberar CPU hasta el siguiente sondeo o hasta que haya algo que publicar
+    mqtt_wait_for_work(100);
 }
\ No newline at end of file
@@ -1,5 +1,7 @@
 // src/memory_monitor.cpp
 #include "memory_monitor.h"
+#include "alloc_guard.h"
+#include "config.h"
 #include <SPIFFS.h>
 
 void append_memory_info(JsonDocument &doc) {
@@ -14,6 +16,13 @@ void append_memory_info(JsonDocument &doc) {
     heap["total"] = heap_total;
     heap["free"] = heap_free;
     heap["used"] = heap_used;
+    heap["min_free"] = ESP.getMinFreeHeap();
+    heap["largest_block"] = ESP.getMaxAllocHeap();   // Baja con la fragmentación
+
+#if STATIC_ALLOCATION_MODE
+    AllocGuardStats allocs = alloc_guard_get_stats();
+    heap["allocs_after_setup"] = allocs.allocations;
+#endif
 
     // === Flash (SPIFFS) ===
     if (SPIFFS.begin(true)) {
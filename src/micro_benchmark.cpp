@@ -0,0 +1,232 @@
+// src/micro_benchmark.cpp
+#include "micro_benchmark.h"
+#include "serial_log.h"
+#include "config.h"
+
+#if BENCHMARK_MODE
+
+#include "task_plan.h"
+#include "mqtt_client.h"
+#include "json_formatter.h"
+#include "light_controller.h"
+#include "control_dispatcher.h"
+#include "sensor_calibration.h"
+#include <ArduinoJson.h>
+
+struct BenchCase {
+    const char* name;
+    void (*prepare)();       // Fuera de la medida: deja el estado de partida (puede ser NULL)
+    void (*run)();           // Lo medido
+};
+
+// Estado compartido por los casos (solo la tarea del benchmark)
+static StaticJsonDocument<384> wifiDoc;
+static StaticJsonDocument<512> memoryDoc;
+static WifiSnapshot wifiSnapshot;
+static uint8_t payload[64];
+static unsigned int payloadLength = 0;
+static volatile int32_t sink = 0;
+
+// deserializeJson modifica el buffer: cada medida parte de una copia nueva
+static void set_payload(const char* json) {
+    payloadLength = strlcpy((char*)payload, json, sizeof(payload));
+}
+
+// ---- JSON ----
+static void prepare_wifi_json()   { wifiDoc.clear(); }
+static void run_wifi_json()       { generate_wifi_json(wifiSnapshot, wifiDoc); }
+static void prepare_memory_json() { memoryDoc.clear(); }
+static void run_memory_json()     { generate_memory_json(memoryDoc); }
+
+// ---- handle_light_message por tipo de comando ----
+static void prepare_light_on() {
+    turn_off_light(1);
+    set_payload("{\"command\":\"ON\"}");
+}
+static void prepare_light_off() {
+    turn_on_light(1);
+    set_payload("{\"command\":\"OFF\"}");
+}
+static void prepare_light_toggle() { set_payload("{\"command\":\"TOGGLE\"}"); }
+static void run_light() { handle_light_message(TOPIC_LIGHT_1_SET, payload, payloadLength); }
+
+// Las escenas se ejecutan enteras (ver run_case); prepare corta una que quedara a medias
+static void prepare_all_on() {
+    scene_cancel();
+    apply_light_mask(0x00);
+    set_payload("{\"command\":\"ON\"}");
+}
+static void prepare_all_off() {
+    scene_cancel();
+    apply_light_mask(0x0F);
+    set_payload("{\"command\":\"OFF\"}");
+}
+static void run_all() { handle_light_message(TOPIC_LIGHT_ALL_SET, payload, payloadLength); }
+
+static void prepare_scenario() {
+    scene_cancel();
+    set_payload("{\"scenario\":\"stage_only\"}");
+}
+static void run_scenario_message() { handle_light_message(TOPIC_SCENARIO_SET, payload, payloadLength); }
+
+static void prepare_fan_on() {
+    turn_off_fan();
+    set_payload("{\"command\":\"ON\"}");
+}
+static void prepare_fan_off() {
+    turn_on_fan();
+    set_payload("{\"command\":\"OFF\"}");
+}
+static void run_fan() { handle_light_message(TOPIC_FAN_SET, payload, payloadLength); }
+
+// ---- Publicación ----
+static void run_publish_all_lights() { publish_all_lights_status(); }
+
+// ---- Conversión de sensores (un lote recorriendo todo el rango) ----
+static void run_adc_temperature() {
+    int32_t acc = 0;
+    for (uint16_t i = 0; i < MICRO_BENCH_BATCH; i++) acc += adc_to_millicelsius(i * (ADC_MAX_VALUE / MICRO_BENCH_BATCH));
+    sink = acc;
+}
+static void run_adc_lux() {
+    int32_t acc = 0;
+    for (uint16_t i = 0; i < MICRO_BENCH_BATCH; i++) acc += adc_to_lux(i * (ADC_MAX_VALUE / MICRO_BENCH_BATCH));
+    sink = acc;
+}
+
+// ---- Automatización (banda intermedia: la comprobación sin actuar, el caso habitual) ----
+static void run_temperature_automation() { check_temperature_automation(17500); }
+static void run_ldr_automation() { check_ldr_automation(ADC_MAX_VALUE / 2); }
+
+static const BenchCase CASES[] = {
+    // name                      prepare               run
+    { "generate_wifi_json",      prepare_wifi_json,    run_wifi_json },
+    { "generate_memory_json",    prepare_memory_json,  run_memory_json },
+    { "light_on",                prepare_light_on,     run_light },
+    { "light_off",               prepare_light_off,    run_light },
+    { "light_toggle",            prepare_light_toggle, run_light },
+    { "lights_all_on",           prepare_all_on,       run_all },
+    { "lights_all_off",          prepare_all_off,      run_all },
+    { "scenario",                prepare_scenario,     run_scenario_message },
+    { "fan_on",                  prepare_fan_on,       run_fan },
+    { "fan_off",                 prepare_fan_off,      run_fan },
+    { "publish_all_lights",      NULL,                 run_publish_all_lights },
+    { "adc_to_millicelsius",     NULL,                 run_adc_temperature },
+    { "adc_to_lux",              NULL,                 run_adc_lux },
+    { "temperature_automation",  NULL,                 run_temperature_automation },
+    { "ldr_automation",          NULL,                 run_ldr_automation },
+};
+
+#define CASE_COUNT  (sizeof(CASES) / sizeof(CASES[0]))
+
+static void sort_samples(uint32_t* samples, uint16_t count) {
+    for (uint16_t i = 1; i < count; i++) {
+        uint32_t value = samples[i];
+        uint16_t j = i;
+        while (j > 0 && samples[j - 1] > value) {
+            samples[j] = samples[j - 1];
+            j--;
+        }
+        samples[j] = value;
+    }
+}
+
+// Mide un caso y lo publica por Serial. En el dispositivo no hay referencias:
+// las medianas se anotan para comparar a mano antes y después de un cambio; la
+// comprobación automática de regresiones es test/host/bench_hot_paths.
+static void run_case(const BenchCase &bench, uint32_t cpuMhz) {
+    static uint32_t samples[MICRO_BENCH_ITERATIONS];
+
+    for (uint16_t i = 0; i < MICRO_BENCH_ITERATIONS; i++) {
+        if (bench.prepare != NULL) bench.prepare();
+        uint32_t start = ESP.getCycleCount();
+        bench.run();
+        uint32_t cycles = ESP.getCycleCount() - start;
+
+        // Si arrancó una escena se ejecuta entera, como en la tarea de control:
+        // cuentan sus pasos, no las esperas entre ellos
+        while (scene_active()) {
+            start = ESP.getCycleCount();
+            uint32_t due = scene_run_due();
+            cycles += ESP.getCycleCount() - start;
+            if (due != SCENE_IDLE) vTaskDelay(pdMS_TO_TICKS(due) + 1);
+        }
+        samples[i] = cycles;
+        vTaskDelay(pdMS_TO_TICKS(MICRO_BENCH_GAP_MS));
+    }
+    sort_samples(samples, MICRO_BENCH_ITERATIONS);
+
+    uint32_t median = samples[MICRO_BENCH_ITERATIONS / 2];
+
+    StaticJsonDocument<256> doc;
+    doc["case"] = bench.name;
+    doc["n"] = MICRO_BENCH_ITERATIONS;
+    doc["min"] = samples[0];
+    doc["median"] = median;
+    doc["max"] = samples[MICRO_BENCH_ITERATIONS - 1];
+    doc["median_ns"] = (uint32_t)((uint64_t)median * 1000 / cpuMhz);
+
+    Serial.print("[BENCH] ");
+    serializeJson(doc, Serial);
+    Serial.println();
+}
+
+static void microBenchTask(void *parameter) {
+    // Con broker, las publicaciones recorren el camino completo (no el descarte sin conexión)
+    unsigned long waitStart = millis();
+    while (!mqtt_is_connected() && millis() - waitStart < MICRO_BENCH_CONNECT_WAIT_MS) {
+        vTaskDelay(pdMS_TO_TICKS(500));
+    }
+    bool connected = mqtt_is_connected();
+    wifiSnapshot = wifi_get_snapshot();
+
+    uint32_t cpuMhz = ESP.getCpuFreqMHz();
+
+    // La tarea de control se detiene: los casos escriben los relés directamente
+    // y no puede haber otro escritor (la automatización no arranca en este modo)
+    if (!control_dispatcher_pause(MICRO_BENCH_PAUSE_WAIT_MS)) {
+        Serial.println("[BENCH] ✗ La tarea de control no se detuvo, benchmark cancelado");
+        vTaskSuspend(NULL);
+    }
+    uint8_t startMask = get_light_mask();
+    bool startFan = is_fan_on();
+
+    serial_printf("[BENCH] Micro-benchmarks: %u casos x %d medidas (CPU %lu MHz, broker %s)\n",
+                  (unsigned)CASE_COUNT, MICRO_BENCH_ITERATIONS, (unsigned long)cpuMhz,
+                  connected ? "conectado" : "sin conexión");
+
+    for (uint8_t i = 0; i < CASE_COUNT; i++) run_case(CASES[i], cpuMhz);
+
+    // Los relés vuelven a como estaban y la tarea de control atiende lo que llegó
+    scene_cancel();
+    apply_light_mask(startMask);
+    if (startFan) turn_on_fan(); else turn_off_fan();
+    control_dispatcher_resume();
+
+    StaticJsonDocument<256> summary;
+    summary["bench"] = "micro";
+    summary["cases"] = CASE_COUNT;
+    summary["cpu_mhz"] = cpuMhz;
+    summary["mqtt"] = connected;
+    summary["result"] = "measured";
+
+    Serial.print("[BENCH] ");
+    serializeJson(summary, Serial);
+    Serial.println();
+    Serial.println("[BENCH] ✓ Pasada completa");
+    mqtt_publish_json(TOPIC_DIAGNOSTICS, summary);
+
+    // Una pasada por arranque (el handle sigue registrado en task_plan)
+    vTaskSuspend(NULL);
+}
+
+void micro_benchmark_start() {
+    task_plan_start(TASK_ROLE_MICRO_BENCHMARK, microBenchTask);
+}
+
+#else
+
+void micro_benchmark_start() {
+}
+
+#endif // BENCHMARK_MODE
@@ -1,139 +1,619 @@
 // src/mqtt_client.cpp
 
 #include "mqtt_client.h"
+#include "serial_log.h"
 #include "config.h"
 #include "light_controller.h"  // <- Controlador de luces actualizado
+#include "wifi_manager.h"
+#include "boot_profiler.h"
+#include "binary_command.h"
+#include "command_transaction.h"
+#include "sensor_history.h"
+#include "control_dispatcher.h"
+#include "state_query.h"
+#include "broker_pool.h"
+#include "audit_log.h"
+#include "device_state.h"
 #include <WiFi.h>
 #include <PubSubClient.h>
+#include <lwip/sockets.h>
+#if MQTT_USE_TLS
+#include "tls_transport.h"
+#endif
 
+#if MQTT_USE_TLS
+TlsSessionClient espClient;
+#else
 WiFiClient espClient;
+#endif
 PubSubClient client(espClient);
 
+// Reintento de conexión: inmediato al recuperar WiFi, luego cada MQTT_RECONNECT_INTERVAL
+static volatile bool reconnectNow = false;
+static volatile bool dropConnection = false;
+static unsigned long lastReconnectAttempt = 0;
+
+// Última publicación por topic (para el intervalo mínimo del registro)
+static portMUX_TYPE rateMux = portMUX_INITIALIZER_UNLOCKED;
+static unsigned long lastPublishAt[TOPIC_COUNT] = {0};
+static uint32_t rateLimitedCount = 0;
+
+// ============================
+// Retenidos limitados por intervalo
+// ============================
+// En un topic retenido lo que importa es el último valor: lo que llega dentro
+// del intervalo mínimo no se descarta, se guarda (el último por topic) y la
+// tarea de bombeo lo envía en cuanto vence el intervalo.
+struct DeferredPublish {
+    TopicId topic;
+    bool pending;
+    uint16_t length;
+    uint8_t payload[MQTT_DEFERRED_PAYLOAD_MAX];
+};
+
+constexpr bool topic_deferrable(uint8_t i) {
+    return TOPICS[i].retain && TOPICS[i].minIntervalMs > 0;
+}
+
+constexpr uint8_t count_deferrable(uint8_t first) {
+    return first >= TOPIC_COUNT ? 0 : (topic_deferrable(first) ? 1 : 0) + count_deferrable(first + 1);
+}
+
+#define DEFERRED_TOPICS  count_deferrable(0)
+
+static DeferredPublish deferred[DEFERRED_TOPICS];
+static SemaphoreHandle_t deferredMutex = NULL;
+static StaticSemaphore_t deferredMutexBuffer;
+
+// ============================
+// Cola de publicación
+// ============================
+// PubSubClient no es reentrante: solo la tarea de bombeo (loop()) toca el socket.
+// El resto de tareas copian el mensaje a un hueco del pool y lo encolan; así
+// ninguna tarea de control espera a la red.
+// Dos carriles: los topics con prioridad (estados de relés) salen antes que la
+// telemetría, y la telemetría nunca ocupa los últimos
+// MQTT_OUTBOUND_PRIORITY_RESERVE huecos del pool.
+struct OutboundMessage {
+    TopicId topic;
+    uint16_t length;
+    unsigned long stampedAt;       // Marca del intervalo mínimo que puso este mensaje
+    unsigned long previousStamp;   // La de antes, por si no llega a salir
+    uint8_t payload[MQTT_OUTBOUND_PAYLOAD_MAX];
+};
+
+static OutboundMessage outboundPool[MQTT_OUTBOUND_POOL_SIZE];
+static QueueHandle_t freeSlots = NULL;     // Índices libres del pool
+static QueueHandle_t readySlots = NULL;    // Índices pendientes de enviar (FIFO)
+static QueueHandle_t priorityReady = NULL; // Ídem, carril prioritario
+static StaticQueue_t freeSlotsBuffer;
+static StaticQueue_t readySlotsBuffer;
+static StaticQueue_t priorityReadyBuffer;
+static uint8_t freeSlotsStorage[MQTT_OUTBOUND_POOL_SIZE];
+static uint8_t readySlotsStorage[MQTT_OUTBOUND_POOL_SIZE];
+static uint8_t priorityReadyStorage[MQTT_OUTBOUND_POOL_SIZE];
+static uint8_t normalInUse = 0;            // Huecos ocupados por telemetría (bajo rateMux)
+static TaskHandle_t pumpTask = NULL;
+static volatile bool linkUp = false;
+static uint32_t outboundDropped = 0;
+
+// Llamado desde el gestor WiFi al obtener IP o perder la conexión
+static void mqtt_on_wifi_state(bool connected) {
+    if (connected) {
+        reconnectNow = true;
+    } else {
+        // El socket TCP tardaría en notar la caída; cerrarlo desde mqtt_loop()
+        dropConnection = true;
+    }
+}
+
 // ===== CALLBACK MEJORADO PARA LUCES =====
 void mqtt_callback(char* topic, byte* payload, unsigned int length) {
-    Serial.print("[MQTT] Mensaje recibido en: ");
-    Serial.print(topic);
-    Serial.print(" | Payload: ");
-    
-    // Debug: mostrar payload como string
-    String payloadStr = "";
-    for (unsigned int i = 0; i < length; i++) {
-        payloadStr += (char)payload[i];
+    uint32_t receivedUs = micros();
+
+    // Resolver el topic contra el registro (sin construir Strings)
+    TopicId id = topic_lookup_inbound(topic);
+
+    // Comandos de actuación: a la tarea de control. Sin trazas por mensaje: en
+    // una ráfaga el puerto serie frenaría el bombeo; la tarea de control
+    // registra lo que llega a aplicarse.
+    if (control_dispatcher_handles(id)) {
+        control_dispatcher_submit(id, payload, length, receivedUs);
+        return;
     }
-    Serial.println(payloadStr);
+
+    serial_printf("[MQTT] Mensaje recibido en: %s | Payload: %.*s\n", topic, (int)length, (const char*)payload);
     
-    // Procesar mensajes de control de luces
-    String topicStr = String(topic);
-    if (topicStr.startsWith("esp32/auditorium/lights/") && topicStr.endsWith("/set")) {
-        Serial.println("[MQTT] Procesando comando de luz individual");
-        handle_light_message(topic, payload, length);
-    }
-    else if (topicStr == "esp32/auditorium/lights/all/set") {
-        Serial.println("[MQTT] Procesando comando global de luces");
-        handle_light_message(topic, payload, length);
-    }
-    else if (topicStr == "esp32/auditorium/scenario/set") {
-        Serial.println("[MQTT] Procesando comando de escenario");
-        handle_light_message(topic, payload, length);
-    }
-    // Mantener compatibilidad con LEDs RGB si los tienes
-    else if (topicStr.startsWith("esp32/leds/") && topicStr.endsWith("/set")) {
-        Serial.println("[MQTT] Procesando comando de LED RGB (si aplica)");
-        // handle_led_message(topic, payload, length); // Descomenta si tienes LEDs RGB
-    }
-    else {
-        Serial.println("[MQTT] Topic no manejado por callback");
+    switch (id) {
+        case TOPIC_HISTORY_GET:
+            Serial.println("[MQTT] Procesando consulta de histórico");
+            handle_history_query(payload, length);
+            break;
+        case TOPIC_AUDIT_GET:
+            Serial.println("[MQTT] Procesando consulta del registro de actuaciones");
+            handle_audit_query(payload, length);
+            break;
+        case TOPIC_LIGHTS_GET:
+        case TOPIC_FAN_GET:
+        case TOPIC_SENSORS_GET:
+        case TOPIC_MEMORY_GET:
+        case TOPIC_WIFI_GET:
+            handle_state_query(id, payload, length);
+            break;
+        case TOPIC_STATE_SYNC:
+            // Un espejo detectó un hueco en la secuencia
+            device_state_request_full();
+            break;
+        default:
+            Serial.println("[MQTT] Topic no manejado por callback");
+            break;
     }
 }
 
 void mqtt_reconnect() {
-    while (!client.connected()) {
-        Serial.print("Conectando a MQTT...");
+    const BrokerEndpoint &broker = broker_pool_active();
+    serial_printf("Conectando a MQTT (%s:%u)...", broker.host, broker.port);
+    client.setServer(broker.host, broker.port);
+#if MQTT_USE_TLS
+    espClient.setServerName(broker.tlsName);
+#endif
+
+    // ===== CONEXIÓN CON WILL MESSAGE =====
+    const TopicDef& will = TOPICS[TOPIC_LASTWILL];
+    const char* willMessage = "{\"online\": false, \"reason\": \"unexpected_disconnect\"}";
+
+    if (client.connect(MQTT_CLIENT_ID, will.path, will.qos, will.retain, willMessage)) {
+        Serial.println("CONECTADO");
+        linkUp = true;
+        broker_pool_connected(millis());
+        boot_profiler_mark(BOOT_PHASE_MQTT_UP);
+
+        // ===== SUSCRIBIRSE A TODOS LOS TOPICS DE ENTRADA DEL REGISTRO =====
+        Serial.println("[MQTT] Suscribiéndose a topics de control...");
+        for (uint8_t i = 0; i < TOPIC_COUNT; i++) {
+            if (!TOPICS[i].inbound) continue;
+            bool ok = client.subscribe(TOPICS[i].path, TOPICS[i].qos);
+            serial_printf("[MQTT] Suscripción %s (QoS %d): %s\n", TOPICS[i].path, TOPICS[i].qos, ok ? "OK" : "FAIL");
+        }
+        boot_profiler_mark(BOOT_PHASE_COMMAND_READY);
         
-        // ===== CONEXIÓN CON WILL MESSAGE =====
-        String willTopic = "esp32/status/lastwill";
-        String willMessage = "{\"online\": false, \"reason\": \"unexpected_disconnect\"}";
+        // Publicar mensaje de conexión exitosa
+        char connectMsg[160];
+        snprintf(connectMsg, sizeof(connectMsg),
+                 "{\"online\": true, \"client_id\": \"%s\", \"timestamp\": %lu, \"type\": \"auditorium_controller\"}",
+                 MQTT_CLIENT_ID, (unsigned long)millis());
+        mqtt_publish(TOPIC_CONNECTION, connectMsg);
         
-        if (client.connect(MQTT_CLIENT_ID, willTopic.c_str(), 0, true, willMessage.c_str())) {
-            Serial.println("CONECTADO");
-            
-            // ===== SUSCRIBIRSE A TODOS LOS TOPICS DE LUCES =====
-            Serial.println("[MQTT] Suscribiéndose a topics de control de luces...");
-            
-            // Suscribirse a control individual de luces (zonas 1-8)
-            bool subs[8];
-            for (int i = 1; i <= 8; i++) {
-                String topic = "esp32/auditorium/lights/" + String(i) + "/set";
-                subs[i-1] = client.subscribe(topic.c_str());
-                Serial.printf("[MQTT] Suscripción zona %d: %s\n", i, subs[i-1] ? "OK" : "FAIL");
-            }
-            
-            // Suscribirse a comandos globales
-            bool subAll = client.subscribe("esp32/auditorium/lights/all/set");
-            bool subScenario = client.subscribe("esp32/auditorium/scenario/set");
-            
-            Serial.printf("[MQTT] Suscripciones globales: ALL=%s, SCENARIO=%s\n", 
-                         subAll ? "OK" : "FAIL",
-                         subScenario ? "OK" : "FAIL");
-            
-            // Suscribirse a comandos generales (opcional)
-            client.subscribe("esp32/command");
-            
-            // Publicar mensaje de conexión exitosa
-            String connectMsg = "{\"online\": true, \"client_id\": \"" + String(MQTT_CLIENT_ID) + "\", \"timestamp\": " + String(millis()) + ", \"type\": \"auditorium_controller\"}";
-            client.publish("esp32/status/connection", connectMsg.c_str(), true);
-            
-            // Publicar estado inicial de todas las luces después de conectar
-            Serial.println("[MQTT] Publicando estado inicial de luces...");
-            delay(1000);
-            publish_all_lights_status();
-            
-        } else {
-            Serial.print("FALLO, rc=");
-            Serial.print(client.state());
-            Serial.println(" | Reintentando en 5 segundos...");
-            delay(5000);
-        }
+        // Broker activo, salud de la lista y tiempo de la última conmutación
+        StaticJsonDocument<512> brokerDoc;
+        broker_pool_fill_status(brokerDoc);
+#if MQTT_USE_TLS
+        tls_transport_fill_status(brokerDoc);
+#endif
+        mqtt_publish_json(TOPIC_BROKER_STATUS, brokerDoc);
+
+        // Informe de arranque (tiempos por fase y motivo del reset)
+        StaticJsonDocument<384> bootDoc;
+        generate_boot_json(bootDoc);
+        mqtt_publish_json(TOPIC_SYSTEM_BOOT, bootDoc);
+
+        // Publicar estado inicial de luces y ventilador después de conectar
+        // (en cualquier broker: tras una conmutación el nuevo no tiene el estado)
+        Serial.println("[MQTT] Publicando estado inicial de luces...");
+        publish_all_lights_status();
+        publish_fan_status();
+
+        // Documento de estado completo (los deltas siguen a partir de su secuencia)
+        device_state_request_full();
+        
+    } else {
+        Serial.print("FALLO, rc=");
+        Serial.println(client.state());
+
+        // Con la IP cacheada, el primer fallo ya hace volver a DHCP
+        wifi_report_broker_unreachable();
+
+        // Si se cambió de broker se intenta ya; si no, al siguiente intervalo
+        if (broker_pool_connect_failed(millis())) reconnectNow = true;
     }
 }
 
 void mqtt_setup() {
-    client.setServer(MQTT_BROKER, MQTT_PORT);
+    const BrokerEndpoint &broker = broker_pool_active();
+    client.setServer(broker.host, broker.port);
+    client.setKeepAlive(MQTT_KEEPALIVE_S);
+    client.setSocketTimeout(MQTT_SOCKET_TIMEOUT_S);
     client.setCallback(mqtt_callback);  // <- IMPORTANTE: Establecer callback
     
     // Aumentar el buffer para mensajes JSON más grandes
     client.setBufferSize(1024);
     
+    // Reconectar en cuanto el WiFi vuelva, sin esperar al siguiente sondeo
+    wifi_register_state_callback(mqtt_on_wifi_state);
+
+    // mqtt_setup() y mqtt_loop() corren en la misma tarea (loop de Arduino)
+    pumpTask = xTaskGetCurrentTaskHandle();
+    freeSlots = xQueueCreateStatic(MQTT_OUTBOUND_POOL_SIZE, sizeof(uint8_t), freeSlotsStorage, &freeSlotsBuffer);
+    readySlots = xQueueCreateStatic(MQTT_OUTBOUND_POOL_SIZE, sizeof(uint8_t), readySlotsStorage, &readySlotsBuffer);
+    priorityReady = xQueueCreateStatic(MQTT_OUTBOUND_POOL_SIZE, sizeof(uint8_t), priorityReadyStorage, &priorityReadyBuffer);
+    for (uint8_t i = 0; i < MQTT_OUTBOUND_POOL_SIZE; i++) {
+        xQueueSend(freeSlots, &i, 0);
+    }
+
+    deferredMutex = xSemaphoreCreateMutexStatic(&deferredMutexBuffer);
+    uint8_t next = 0;
+    for (uint8_t i = 0; i < TOPIC_COUNT && next < DEFERRED_TOPICS; i++) {
+        if (topic_deferrable(i)) deferred[next++].topic = (TopicId)i;
+    }
+
     Serial.println("[MQTT] Cliente configurado para control de luces");
 }
 
-void mqtt_loop() {
-    if (!client.connected()) {
-        mqtt_reconnect();
+static bool publish_now(TopicId id, const uint8_t* payload, size_t length) {
+    const TopicDef& def = TOPICS[id];
+    bool result = client.publish(def.path, payload, length, def.retain);
+    if (result) {
+        serial_printf("[MQTT] ✓ Publicado en %s\n", def.path);
+    } else {
+        serial_printf("[MQTT] ✗ Error publicando en %s\n", def.path);
+    }
+    return result;
+}
+
+// Deshace la marca del intervalo si el mensaje no llegó a salir (y nadie marcó después)
+static void restore_stamp(TopicId id, unsigned long stampedAt, unsigned long previousStamp) {
+    if (stampedAt == 0) return;
+    portENTER_CRITICAL(&rateMux);
+    if (lastPublishAt[id] == stampedAt) lastPublishAt[id] = previousStamp;
+    portEXIT_CRITICAL(&rateMux);
+}
+
+static void release_slot(uint8_t slot) {
+    if (!TOPICS[outboundPool[slot].topic].priority) {
+        portENTER_CRITICAL(&rateMux);
+        normalInUse--;
+        portEXIT_CRITICAL(&rateMux);
     }
-    client.loop();  // <- IMPORTANTE: Procesar mensajes entrantes
+    xQueueSend(freeSlots, &slot, 0);
 }
 
-void mqtt_publish(const char* topic, const String& payload) {
-    if (client.connected()) {
-        bool result = client.publish(topic, payload.c_str(), true);  // retain = true
-        if (result) {
-            Serial.printf("[MQTT] ✓ Publicado en %s\n", topic);
+// Envía (o descarta) el primer mensaje de un carril. false = carril vacío
+static bool send_next(QueueHandle_t lane, bool send) {
+    uint8_t slot;
+    if (xQueueReceive(lane, &slot, 0) != pdTRUE) return false;
+    OutboundMessage &msg = outboundPool[slot];
+    if (!send || !publish_now(msg.topic, msg.payload, msg.length)) {
+        restore_stamp(msg.topic, msg.stampedAt, msg.previousStamp);
+    }
+    release_slot(slot);
+    return true;
+}
+
+// Envía (o descarta si no hay conexión) lo encolado por otras tareas.
+// El carril prioritario se vacía antes y se vuelve a mirar tras cada telemetría.
+static void drain_outbound(bool send) {
+    do {
+        while (send_next(priorityReady, send)) {}
+    } while (send_next(readySlots, send));
+}
+
+static DeferredPublish* deferred_for(TopicId id) {
+    for (uint8_t i = 0; i < DEFERRED_TOPICS; i++) {
+        if (deferred[i].topic == id) return &deferred[i];
+    }
+    return NULL;
+}
+
+// Envía los retenidos aplazados cuyo intervalo ya venció (tarea de bombeo)
+static void flush_deferred(unsigned long now) {
+    static uint8_t flushBuffer[MQTT_DEFERRED_PAYLOAD_MAX];
+
+    for (uint8_t i = 0; i < DEFERRED_TOPICS; i++) {
+        DeferredPublish &entry = deferred[i];
+        if (!entry.pending) continue;   // Lectura sin cerrojo: se confirma abajo
+
+        TopicId id = entry.topic;
+        portENTER_CRITICAL(&rateMux);
+        bool due = now - lastPublishAt[id] >= TOPICS[id].minIntervalMs;
+        portEXIT_CRITICAL(&rateMux);
+        if (!due) continue;
+
+        // Copia y suelta el cerrojo: el socket no se escribe con otras tareas esperando
+        xSemaphoreTake(deferredMutex, portMAX_DELAY);
+        uint16_t length = entry.length;
+        bool pending = entry.pending;
+        if (pending) memcpy(flushBuffer, entry.payload, length);
+        entry.pending = false;
+        xSemaphoreGive(deferredMutex);
+        if (!pending) continue;
+
+        if (publish_now(id, flushBuffer, length)) {
+            portENTER_CRITICAL(&rateMux);
+            lastPublishAt[id] = now | 1;
+            portEXIT_CRITICAL(&rateMux);
         } else {
-            Serial.printf("[MQTT] ✗ Error publicando en %s\n", topic);
+            // Se reintenta, salvo que ya haya llegado un valor más nuevo
+            xSemaphoreTake(deferredMutex, portMAX_DELAY);
+            if (!entry.pending) {
+                memcpy(entry.payload, flushBuffer, length);
+                entry.length = length;
+                entry.pending = true;
+            }
+            xSemaphoreGive(deferredMutex);
         }
-    } else {
+    }
+}
+
+void mqtt_loop() {
+    unsigned long now = millis();
+
+    if (dropConnection) {
+        // Caída del WiFi: no cuenta contra el broker
+        dropConnection = false;
+        client.disconnect();
+        linkUp = false;
+    }
+
+    if (linkUp && !client.connected()) {
+        // Keepalive vencido o socket cerrado por el broker: reintento inmediato
+        serial_printf("[MQTT] ✗ Conexión con el broker perdida (estado %d)\n", client.state());
+        linkUp = false;
+        broker_pool_connection_lost(now);
+        reconnectNow = true;
+    }
+
+    if (!client.connected()) {
+        linkUp = false;
+        drain_outbound(false);
+
+        // Sin WiFi no tiene sentido intentarlo; el evento de IP nos despertará
+        if (!wifi_is_connected()) return;
+
+        if (reconnectNow || now - lastReconnectAttempt >= MQTT_RECONNECT_INTERVAL) {
+            reconnectNow = false;
+            lastReconnectAttempt = now;
+            mqtt_reconnect();
+        }
+        if (!client.connected()) return;
+    }
+    // Procesar mensajes entrantes: client.loop() lee un paquete por llamada,
+    // así que se vacía lo que ya haya en el socket (acotado) antes de dormir
+    client.loop();
+    for (uint8_t i = 1; i < MQTT_INBOUND_BURST && espClient.available() > 0; i++) {
+        client.loop();
+    }
+    drain_outbound(true);
+    flush_deferred(now);
+
+    // En un secundario: volver al principal en cuanto acepte conexiones
+    if (broker_pool_should_return_to_primary(now)) {
+        client.disconnect();
+        linkUp = false;
+        reconnectNow = true;
+    }
+}
+
+void mqtt_wait_for_work(uint32_t timeoutMs) {
+    // Sin conexión solo puede despertar una publicación encolada
+    int fd = linkUp ? espClient.fd() : -1;
+    if (fd < 0) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(timeoutMs));
+        return;
+    }
+
+    // Conectado: despierta también en cuanto el broker envía algo (un comando
+    // no espera al siguiente sondeo). Se alterna el socket con el aviso de
+    // publicación en tramos de MQTT_PUMP_POLL_MS.
+    for (uint32_t waited = 0; waited < timeoutMs; waited += MQTT_PUMP_POLL_MS) {
+        if (ulTaskNotifyTake(pdTRUE, 0) > 0) return;
+
+        fd_set readable;
+        FD_ZERO(&readable);
+        FD_SET(fd, &readable);
+        struct timeval slice = { 0, MQTT_PUMP_POLL_MS * 1000 };
+        if (select(fd + 1, &readable, NULL, NULL, &slice) != 0) return;   // Datos o error del socket
+    }
+}
+
+enum PublishAdmission : uint8_t {
+    ADMIT_SEND,     // Sale ahora (el intervalo queda marcado)
+    ADMIT_DEFER,    // Retenido dentro del intervalo: se guarda como último valor
+    ADMIT_DROP
+};
+
+// Marca del intervalo puesta por la última admisión (para deshacerla si no sale)
+struct PublishStamp {
+    unsigned long stampedAt;
+    unsigned long previous;
+};
+
+// Comprueba la conexión y el intervalo mínimo del topic
+static PublishAdmission admit_publish(TopicId id, PublishStamp &stamp) {
+    stamp.stampedAt = 0;
+    stamp.previous = 0;
+    if (id >= TOPIC_COUNT) return ADMIT_DROP;
+    const TopicDef& def = TOPICS[id];
+
+    if (!linkUp) {
         Serial.println("[MQTT] No conectado, no se puede publicar");
+        return ADMIT_DROP;
     }
+
+    // Intervalo mínimo por topic: lo demasiado seguido se aplaza (retenidos) o se descarta
+    unsigned long now = millis();
+    bool limited = false;
+    portENTER_CRITICAL(&rateMux);
+    if (def.minIntervalMs > 0 && lastPublishAt[id] != 0 && now - lastPublishAt[id] < def.minIntervalMs) {
+        rateLimitedCount++;
+        limited = true;
+    } else {
+        stamp.previous = lastPublishAt[id];
+        stamp.stampedAt = now | 1;   // 0 se reserva para "nunca publicado"
+        lastPublishAt[id] = stamp.stampedAt;
+    }
+    portEXIT_CRITICAL(&rateMux);
+
+    if (!limited) return ADMIT_SEND;
+    if (topic_deferrable(id)) return ADMIT_DEFER;
+
+    serial_printf("[MQTT] ⏱ Limitado %s (mín. %u ms)\n", def.path, def.minIntervalMs);
+    return ADMIT_DROP;
+}
+
+// Guarda el último payload de un retenido limitado (lo envía flush_deferred)
+static bool defer_publish(TopicId id, const uint8_t* payload, size_t length) {
+    DeferredPublish* entry = deferred_for(id);
+    if (entry == NULL || length > sizeof(entry->payload)) return false;
+
+    xSemaphoreTake(deferredMutex, portMAX_DELAY);
+    memcpy(entry->payload, payload, length);
+    entry->length = (uint16_t)length;
+    entry->pending = true;
+    xSemaphoreGive(deferredMutex);
+    return true;
+}
+
+static bool defer_publish_json(TopicId id, const JsonDocument& doc, bool pretty, size_t length) {
+    DeferredPublish* entry = deferred_for(id);
+    if (entry == NULL || length >= sizeof(entry->payload)) return false;
+
+    xSemaphoreTake(deferredMutex, portMAX_DELAY);
+    char* out = (char*)entry->payload;
+    entry->length = pretty ? serializeJsonPretty(doc, out, sizeof(entry->payload))
+                           : serializeJson(doc, out, sizeof(entry->payload));
+    entry->pending = true;
+    xSemaphoreGive(deferredMutex);
+    return true;
+}
+
+// Reserva un hueco del pool para un mensaje de length bytes (NULL = descartado)
+static OutboundMessage* acquire_slot(TopicId id, size_t length, uint8_t &slot, const PublishStamp &stamp) {
+    bool priority = TOPICS[id].priority;
+
+    // La telemetría cuenta su hueco antes de cogerlo: nunca entra en la reserva
+    bool admitted = length < MQTT_OUTBOUND_PAYLOAD_MAX;
+    if (admitted && !priority) {
+        portENTER_CRITICAL(&rateMux);
+        admitted = normalInUse < MQTT_OUTBOUND_POOL_SIZE - MQTT_OUTBOUND_PRIORITY_RESERVE;
+        if (admitted) normalInUse++;
+        portEXIT_CRITICAL(&rateMux);
+    }
+    if (admitted && xQueueReceive(freeSlots, &slot, pdMS_TO_TICKS(MQTT_OUTBOUND_WAIT_MS)) != pdTRUE) {
+        if (!priority) {
+            portENTER_CRITICAL(&rateMux);
+            normalInUse--;
+            portEXIT_CRITICAL(&rateMux);
+        }
+        admitted = false;
+    }
+    if (!admitted) {
+        portENTER_CRITICAL(&rateMux);
+        outboundDropped++;
+        portEXIT_CRITICAL(&rateMux);
+        serial_printf("[MQTT] ✗ Cola de salida llena, descartado %s\n", TOPICS[id].path);
+        restore_stamp(id, stamp.stampedAt, stamp.previous);
+        return NULL;
+    }
+    OutboundMessage &msg = outboundPool[slot];
+    msg.topic = id;
+    msg.length = (uint16_t)length;
+    msg.stampedAt = stamp.stampedAt;
+    msg.previousStamp = stamp.previous;
+    return &msg;
+}
+
+static void submit_slot(uint8_t slot) {
+    xQueueSend(TOPICS[outboundPool[slot].topic].priority ? priorityReady : readySlots, &slot, 0);
+    xTaskNotifyGive(pumpTask);
+}
+
+bool mqtt_publish(TopicId id, const char* payload) {
+    return mqtt_publish(id, (const uint8_t*)payload, strlen(payload));
+}
+
+bool mqtt_publish(TopicId id, const uint8_t* payload, size_t length) {
+    PublishStamp stamp;
+    PublishAdmission admission = admit_publish(id, stamp);
+    if (admission == ADMIT_DEFER) return defer_publish(id, payload, length);
+    if (admission == ADMIT_DROP) return false;
+
+    // Desde la tarea de bombeo se publica directamente
+    if (xTaskGetCurrentTaskHandle() == pumpTask) {
+        bool result = publish_now(id, payload, length);
+        if (!result) restore_stamp(id, stamp.stampedAt, stamp.previous);
+        return result;
+    }
+
+    uint8_t slot;
+    OutboundMessage* msg = acquire_slot(id, length, slot, stamp);
+    if (msg == NULL) return false;
+    memcpy(msg->payload, payload, length);
+    submit_slot(slot);
+    return true;
+}
+
+bool mqtt_publish_json(TopicId id, const JsonDocument& doc, bool pretty) {
+    PublishStamp stamp;
+    PublishAdmission admission = admit_publish(id, stamp);
+    if (admission == ADMIT_DROP) return false;
+
+    size_t length = pretty ? measureJsonPretty(doc) : measureJson(doc);
+    if (admission == ADMIT_DEFER) return defer_publish_json(id, doc, pretty, length);
+
+    // Desde la tarea de bombeo se serializa en un buffer propio y se envía
+    if (xTaskGetCurrentTaskHandle() == pumpTask) {
+        static char pumpBuffer[MQTT_OUTBOUND_PAYLOAD_MAX];
+        bool result = false;
+        if (length < sizeof(pumpBuffer)) {
+            length = pretty ? serializeJsonPretty(doc, pumpBuffer, sizeof(pumpBuffer))
+                            : serializeJson(doc, pumpBuffer, sizeof(pumpBuffer));
+            result = publish_now(id, (const uint8_t*)pumpBuffer, length);
+        }
+        if (!result) restore_stamp(id, stamp.stampedAt, stamp.previous);
+        return result;
+    }
+
+    // Desde otras tareas se serializa directamente en el hueco del pool
+    uint8_t slot;
+    OutboundMessage* msg = acquire_slot(id, length, slot, stamp);
+    if (msg == NULL) return false;
+    char* out = (char*)msg->payload;
+    msg->length = pretty ? serializeJsonPretty(doc, out, sizeof(msg->payload))
+                         : serializeJson(doc, out, sizeof(msg->payload));
+    submit_slot(slot);
+    return true;
+}
+
+bool mqtt_reply_json(const char* topic, const JsonDocument& doc) {
+    // Solo la tarea de bombeo (callback MQTT) puede escribir en el socket
+    if (xTaskGetCurrentTaskHandle() != pumpTask || !linkUp) return false;
+
+    static char replyBuffer[MQTT_OUTBOUND_PAYLOAD_MAX];
+    if (measureJson(doc) >= sizeof(replyBuffer)) return false;
+    size_t length = serializeJson(doc, replyBuffer, sizeof(replyBuffer));
+
+    bool result = client.publish(topic, (const uint8_t*)replyBuffer, length, false);
+    serial_printf("[MQTT] %s Respuesta en %s\n", result ? "✓" : "✗", topic);
+    return result;
+}
+
+uint32_t mqtt_get_outbound_dropped() {
+    return outboundDropped;
+}
+
+uint32_t mqtt_get_rate_limited_count() {
+    return rateLimitedCount;
 }
 
 bool mqtt_is_connected() {
-    return client.connected();
+    // Copia mantenida por la tarea de bombeo: consultable desde cualquier tarea
+    return linkUp;
 }
 
 // ===== FUNCIÓN DE DEBUG =====
 void mqtt_debug_info() {
-    Serial.printf("[MQTT] Estado: %s | Broker: %s:%d | Cliente: %s\n",
+    const BrokerEndpoint &broker = broker_pool_active();
+    serial_printf("[MQTT] Estado: %s | Broker: %s:%d | Cliente: %s\n",
                   client.connected() ? "CONECTADO" : "DESCONECTADO",
-                  MQTT_BROKER, MQTT_PORT, MQTT_CLIENT_ID);
+                  broker.host, broker.port, MQTT_CLIENT_ID);
 }
\ No newline at end of file
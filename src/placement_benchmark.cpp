@@ -0,0 +1,176 @@
+// src/placement_benchmark.cpp
+#include "placement_benchmark.h"
+#include "serial_log.h"
+#include "config.h"
+
+#if TASK_PLAN_BENCHMARK
+
+#include "task_plan.h"
+#include "control_dispatcher.h"
+#include "binary_command.h"
+#include "light_controller.h"
+#include "mqtt_client.h"
+#include <ArduinoJson.h>
+
+#define BENCHMARK_SETTLE_MS       10000   // Espera a que WiFi/MQTT se estabilicen
+#define BENCHMARK_ROUND_PAUSE_MS  30000
+
+// Carga sintética: CPU ocupada (como serializar JSON o filtrar muestras) y
+// publicaciones de telemetría, cediendo solo un tick entre ciclos
+static void benchLoadTask(void *parameter) {
+    while (true) {
+        uint32_t start = millis();
+        volatile uint32_t sink = 0;
+        while (millis() - start < BENCHMARK_LOAD_BUSY_MS) {
+            sink += start;
+        }
+
+        StaticJsonDocument<256> doc;
+        doc["bench"] = "load";
+        doc["free_heap"] = ESP.getFreeHeap();
+        doc["timestamp"] = millis();
+        mqtt_publish_json(TOPIC_SYSTEM_MEMORY, doc);
+
+        vTaskDelay(1);
+    }
+}
+
+static void report_round(uint16_t round) {
+    ControlLatencyStats stats = control_dispatcher_get_stats();
+
+    StaticJsonDocument<256> doc;
+    doc["bench"] = "task_plan";
+    doc["plan"] = task_plan_name();
+    doc["round"] = round;
+    doc["commands"] = stats.count;
+    doc["dropped"] = stats.dropped;
+    doc["coalesced"] = stats.coalesced;
+    doc["min_us"] = stats.minUs;
+    doc["avg_us"] = stats.avgUs;
+    doc["max_us"] = stats.maxUs;
+
+    Serial.print("[BENCH] ");
+    serializeJson(doc, Serial);
+    Serial.println();
+    mqtt_publish_json(TOPIC_DIAGNOSTICS, doc);
+}
+
+#if BENCHMARK_BURST
+
+// Un comando por tick, rotando entre los caminos que llegan a los relés:
+// TOGGLE por zona, TOGGLE global, trama binaria y transacción
+static bool submit_burst_command(uint32_t i) {
+    static const char TOGGLE[] = "{\"command\":\"TOGGLE\"}";
+    static const char TRANSACTION[] = "{\"id\":\"burst\",\"zones\":{\"2\":\"TOGGLE\",\"4\":\"TOGGLE\"}}";
+
+    switch (i % 4) {
+        case 0:
+            return control_dispatcher_submit((TopicId)(TOPIC_LIGHT_1_SET + (i / 4) % 4), (const uint8_t*)TOGGLE,
+                                             sizeof(TOGGLE) - 1, micros());
+        case 1:
+            return control_dispatcher_submit(TOPIC_LIGHT_ALL_SET, (const uint8_t*)TOGGLE, sizeof(TOGGLE) - 1, micros());
+        case 2: {
+            BinaryCommand command = { BIN_OP_ZONES_TOGGLE, 0x0F, BIN_FAN_TOGGLE, i };
+            uint8_t frame[BINARY_COMMAND_SIZE];
+            binary_command_encode(command, frame);
+            return control_dispatcher_submit(TOPIC_BINARY_SET, frame, sizeof(frame), micros());
+        }
+        default:
+            return control_dispatcher_submit(TOPIC_TRANSACTION_SET, (const uint8_t*)TRANSACTION,
+                                             sizeof(TRANSACTION) - 1, micros());
+    }
+}
+
+// Conmutaciones de los relés frente a una ráfaga de BENCHMARK_BURST_MS a 1000 msg/s.
+// Pasa si ninguna separación entre dos conmutaciones del mismo relé baja del intervalo.
+static void run_burst_round(uint16_t round) {
+    control_dispatcher_reset_stats();
+    relay_switch_stats_reset();
+
+    uint32_t sent = 0;
+    uint32_t rejected = 0;
+    uint32_t start = millis();
+    while (millis() - start < BENCHMARK_BURST_MS) {
+        if (!submit_burst_command(sent)) rejected++;
+        sent++;
+        vTaskDelay(1);
+    }
+    uint32_t elapsedMs = millis() - start;
+    // Lo que quedó en cola sale a un comando por intervalo como mucho
+    vTaskDelay(pdMS_TO_TICKS((CONTROL_QUEUE_LENGTH + 2) * (RELAY_MIN_SWITCH_INTERVAL_MS + 50)));
+
+    ControlLatencyStats stats = control_dispatcher_get_stats();
+    RelaySwitchStats switches = relay_switch_stats();
+
+    StaticJsonDocument<384> doc;
+    doc["bench"] = "burst";
+    doc["plan"] = task_plan_name();
+    doc["round"] = round;
+    doc["sent"] = sent;
+    doc["rate_hz"] = (uint32_t)((uint64_t)sent * 1000 / (elapsedMs > 0 ? elapsedMs : 1));
+    doc["rejected"] = rejected;
+    doc["applied"] = stats.count;
+    doc["coalesced"] = stats.coalesced;
+    doc["rate_limited"] = stats.rateLimited;
+    doc["switches"] = switches.switches;
+    doc["max_switches"] = (uint32_t)RELAY_TARGETS * (elapsedMs / (RELAY_MIN_SWITCH_INTERVAL_MS > 0 ? RELAY_MIN_SWITCH_INTERVAL_MS : 1) + 1);
+    if (switches.minGapMs != 0xFFFFFFFFUL) doc["min_gap_ms"] = switches.minGapMs;
+    doc["under_interval"] = switches.underInterval;
+    doc["result"] = switches.underInterval == 0 ? "pass" : "fail";
+
+    Serial.print("[BENCH] ");
+    serializeJson(doc, Serial);
+    Serial.println();
+    mqtt_publish_json(TOPIC_DIAGNOSTICS, doc);
+}
+
+#endif // BENCHMARK_BURST
+
+// Inyecta comandos como si llegaran del callback MQTT (mismo núcleo y prioridad).
+// Es un segundo productor junto al callback real: control_dispatcher_submit()
+// serializa a los dos con su mutex.
+static void benchDriverTask(void *parameter) {
+    static const char TOGGLE[] = "{\"command\":\"TOGGLE\"}";
+    uint16_t round = 0;
+
+    vTaskDelay(pdMS_TO_TICKS(BENCHMARK_SETTLE_MS));
+
+    while (true) {
+#if BENCHMARK_BURST
+        run_burst_round(++round);
+        vTaskDelay(pdMS_TO_TICKS(BENCHMARK_ROUND_PAUSE_MS));
+        continue;
+#endif
+        control_dispatcher_reset_stats();
+
+        // Número par de TOGGLE: la zona termina como empezó
+        for (uint16_t i = 0; i < BENCHMARK_COMMANDS; i++) {
+            control_dispatcher_submit(TOPIC_LIGHT_1_SET, (const uint8_t*)TOGGLE,
+                                      sizeof(TOGGLE) - 1, micros());
+            vTaskDelay(pdMS_TO_TICKS(BENCHMARK_COMMAND_INTERVAL));
+        }
+        vTaskDelay(pdMS_TO_TICKS(1000));   // Que termine el último comando
+
+        report_round(++round);
+        vTaskDelay(pdMS_TO_TICKS(BENCHMARK_ROUND_PAUSE_MS));
+    }
+}
+
+void placement_benchmark_start() {
+#if BENCHMARK_BURST
+    serial_printf("[BENCH] Ráfagas en el plan '%s': %d ms a un comando por tick, intervalo mínimo %d ms\n",
+                  task_plan_name(), BENCHMARK_BURST_MS, RELAY_MIN_SWITCH_INTERVAL_MS);
+#else
+    serial_printf("[BENCH] Benchmark de plan de tareas '%s': %d comandos cada %d ms\n",
+                  task_plan_name(), BENCHMARK_COMMANDS, BENCHMARK_COMMAND_INTERVAL);
+#endif
+    task_plan_start(TASK_ROLE_BENCHMARK_LOAD, benchLoadTask);
+    task_plan_start(TASK_ROLE_BENCHMARK_DRIVER, benchDriverTask);
+}
+
+#else
+
+void placement_benchmark_start() {
+}
+
+#endif // TASK_PLAN_BENCHMARK
@@ -0,0 +1,125 @@
+// src/relay_state_store.cpp
+#include "relay_state_store.h"
+#include "serial_log.h"
+#include "config.h"
+#include "task_plan.h"
+#include <Preferences.h>
+#include <rom/crc.h>
+
+#define RELAY_STATE_NAMESPACE  "relays"
+#define RELAY_STATE_KEY        "state"
+#define RELAY_STATE_VERSION    1
+
+// Registro en flash: tamaño fijo y CRC32 al final
+struct RelayStateRecord {
+    uint8_t version;
+    uint8_t zoneMask;
+    uint8_t fanOn;
+    uint8_t fanAutoMode;
+    uint32_t writeCount;   // Escrituras acumuladas (diagnóstico de desgaste)
+    uint32_t crc;
+};
+
+static TaskHandle_t storeTaskHandle = NULL;
+static portMUX_TYPE pendingMux = portMUX_INITIALIZER_UNLOCKED;
+static RelayStateSnapshot pending = {0, false, true};
+static RelayStateRecord lastWritten = {};
+
+static uint32_t record_crc(const RelayStateRecord &record) {
+    return crc32_le(0, (const uint8_t*)&record, offsetof(RelayStateRecord, crc));
+}
+
+bool relay_state_store_load(RelayStateSnapshot &snapshot) {
+    Preferences prefs;
+    if (!prefs.begin(RELAY_STATE_NAMESPACE, true)) return false;
+
+    RelayStateRecord record = {};
+    size_t len = prefs.getBytes(RELAY_STATE_KEY, &record, sizeof(record));
+    prefs.end();
+
+    if (len != sizeof(record) || record.version != RELAY_STATE_VERSION) return false;
+    if (record.crc != record_crc(record)) {
+        Serial.println("[STATE_STORE] ✗ CRC inválido, se ignora el estado guardado");
+        return false;
+    }
+
+    lastWritten = record;
+    snapshot.zoneMask = record.zoneMask;
+    snapshot.fanOn = record.fanOn != 0;
+    snapshot.fanAutoMode = record.fanAutoMode != 0;
+    return true;
+}
+
+static void write_record(const RelayStateSnapshot &snapshot) {
+    // Nada que hacer si coincide con lo que ya está en flash
+    if (lastWritten.version == RELAY_STATE_VERSION &&
+        lastWritten.zoneMask == snapshot.zoneMask &&
+        lastWritten.fanOn == (snapshot.fanOn ? 1 : 0) &&
+        lastWritten.fanAutoMode == (snapshot.fanAutoMode ? 1 : 0)) {
+        return;
+    }
+
+    RelayStateRecord record = {};
+    record.version = RELAY_STATE_VERSION;
+    record.zoneMask = snapshot.zoneMask;
+    record.fanOn = snapshot.fanOn ? 1 : 0;
+    record.fanAutoMode = snapshot.fanAutoMode ? 1 : 0;
+    record.writeCount = lastWritten.writeCount + 1;
+    record.crc = record_crc(record);
+
+    Preferences prefs;
+    if (!prefs.begin(RELAY_STATE_NAMESPACE, false)) {
+        Serial.println("[STATE_STORE] ✗ No se pudo abrir NVS");
+        return;
+    }
+    size_t written = prefs.putBytes(RELAY_STATE_KEY, &record, sizeof(record));
+    prefs.end();
+
+    if (written == sizeof(record)) {
+        lastWritten = record;
+        serial_printf("[STATE_STORE] ✓ Estado guardado (zonas 0x%02X, ventilador %s, escritura #%lu)\n",
+                      record.zoneMask, record.fanOn ? "ON" : "OFF", (unsigned long)record.writeCount);
+    } else {
+        Serial.println("[STATE_STORE] ✗ Error escribiendo en NVS");
+    }
+}
+
+// Espera una petición y luego un periodo de silencio antes de escribir
+static void relayStateStoreTask(void *parameter) {
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        TickType_t firstRequest = xTaskGetTickCount();
+
+        // Cada nueva petición dentro del periodo reinicia la espera, sin pasar
+        // del plazo máximo: una ráfaga continua no deja el estado sin guardar
+        while (true) {
+            TickType_t waited = xTaskGetTickCount() - firstRequest;
+            TickType_t maxDefer = pdMS_TO_TICKS(RELAY_STATE_SAVE_MAX_DEFER_MS);
+            if (waited >= maxDefer) break;
+
+            TickType_t quiet = pdMS_TO_TICKS(RELAY_STATE_SAVE_QUIET_MS);
+            if (quiet > maxDefer - waited) quiet = maxDefer - waited;
+            if (ulTaskNotifyTake(pdTRUE, quiet) == 0) break;
+        }
+
+        portENTER_CRITICAL(&pendingMux);
+        RelayStateSnapshot snapshot = pending;
+        portEXIT_CRITICAL(&pendingMux);
+
+        write_record(snapshot);
+    }
+}
+
+void relay_state_store_start() {
+    task_plan_start(TASK_ROLE_RELAY_STORE, relayStateStoreTask, NULL, &storeTaskHandle);
+}
+
+void relay_state_store_request_save(const RelayStateSnapshot &snapshot) {
+    portENTER_CRITICAL(&pendingMux);
+    pending = snapshot;
+    portEXIT_CRITICAL(&pendingMux);
+
+    if (storeTaskHandle != NULL) {
+        xTaskNotifyGive(storeTaskHandle);
+    }
+}
@@ -0,0 +1,203 @@
+// src/relay_usage.cpp
+#include "relay_usage.h"
+#include "serial_log.h"
+#include "mqtt_client.h"
+#include "task_plan.h"
+#include "config.h"
+#include <ArduinoJson.h>
+#include <Preferences.h>
+#include <rom/crc.h>
+#include <esp_timer.h>
+
+#define RELAY_USAGE_NAMESPACE  "usage"
+#define RELAY_USAGE_KEY        "counters"
+#define RELAY_USAGE_VERSION    1
+
+struct UsageCounters {
+    uint32_t cycles;                                  // Encendidos (apagado -> encendido)
+    uint64_t onMs;                                    // Tiempo encendido acumulado
+    uint64_t onMsBySource[ACTUATION_SOURCE_COUNT];    // Mismo tiempo, por origen del encendido
+};
+
+// Registro en flash: tamaño fijo y CRC32 al final
+struct UsageRecord {
+    uint8_t version;
+    uint32_t checkpoints;                             // Escrituras acumuladas
+    UsageCounters targets[USAGE_TARGETS];
+    uint32_t crc;
+};
+
+struct RelayUsage {
+    UsageCounters counters;
+    bool isOn;
+    uint8_t onSource;
+    uint64_t onSinceMs;       // Desde aquí falta sumar el tiempo encendido
+};
+
+static portMUX_TYPE usageMux = portMUX_INITIALIZER_UNLOCKED;
+static RelayUsage usage[USAGE_TARGETS];
+static bool dirty = false;                // Cambió desde el último guardado
+static uint32_t checkpoints = 0;
+
+// Milisegundos desde el arranque en 64 bits (millis() da la vuelta a los 49 días)
+static inline uint64_t uptime_ms() {
+    return (uint64_t)esp_timer_get_time() / 1000;
+}
+
+// Suma el tramo encendido en curso (llamar con usageMux tomado)
+static inline void fold_running(RelayUsage &u, uint64_t now) {
+    uint64_t elapsed = now - u.onSinceMs;
+    u.counters.onMs += elapsed;
+    u.counters.onMsBySource[u.onSource] += elapsed;
+    u.onSinceMs = now;
+    if (elapsed > 0) dirty = true;
+}
+
+void relay_usage_record(uint8_t target, bool on, ActuationSource source) {
+    if (target >= USAGE_TARGETS || source >= ACTUATION_SOURCE_COUNT) return;
+    uint64_t now = uptime_ms();
+
+    portENTER_CRITICAL(&usageMux);
+    RelayUsage &u = usage[target];
+    if (on && !u.isOn) {
+        u.counters.cycles++;
+        u.isOn = true;
+        u.onSource = source;
+        u.onSinceMs = now;
+        dirty = true;
+    } else if (!on && u.isOn) {
+        fold_running(u, now);
+        u.isOn = false;
+    }
+    portEXIT_CRITICAL(&usageMux);
+}
+
+static uint32_t record_crc(const UsageRecord &record) {
+    return crc32_le(0, (const uint8_t*)&record, offsetof(UsageRecord, crc));
+}
+
+// Suma lo guardado a lo ya anotado en RAM desde el arranque
+static void load_checkpoint() {
+    Preferences prefs;
+    if (!prefs.begin(RELAY_USAGE_NAMESPACE, true)) return;
+
+    static UsageRecord record;
+    size_t len = prefs.getBytes(RELAY_USAGE_KEY, &record, sizeof(record));
+    prefs.end();
+
+    if (len != sizeof(record) || record.version != RELAY_USAGE_VERSION) return;
+    if (record.crc != record_crc(record)) {
+        Serial.println("[USAGE] ✗ CRC inválido, los contadores empiezan de cero");
+        return;
+    }
+
+    portENTER_CRITICAL(&usageMux);
+    for (uint8_t t = 0; t < USAGE_TARGETS; t++) {
+        UsageCounters &c = usage[t].counters;
+        c.cycles += record.targets[t].cycles;
+        c.onMs += record.targets[t].onMs;
+        for (uint8_t s = 0; s < ACTUATION_SOURCE_COUNT; s++) {
+            c.onMsBySource[s] += record.targets[t].onMsBySource[s];
+        }
+    }
+    checkpoints = record.checkpoints;
+    portEXIT_CRITICAL(&usageMux);
+
+    serial_printf("[USAGE] ✓ Contadores restaurados (guardado #%lu)\n", (unsigned long)record.checkpoints);
+}
+
+// Copia coherente de todos los contadores con el tramo en curso ya sumado
+static void snapshot_counters(UsageCounters* out, bool* isOn, bool &wasDirty) {
+    uint64_t now = uptime_ms();
+    portENTER_CRITICAL(&usageMux);
+    for (uint8_t t = 0; t < USAGE_TARGETS; t++) {
+        if (usage[t].isOn) fold_running(usage[t], now);
+        out[t] = usage[t].counters;
+        isOn[t] = usage[t].isOn;
+    }
+    wasDirty = dirty;
+    dirty = false;
+    portEXIT_CRITICAL(&usageMux);
+}
+
+static bool write_checkpoint(const UsageCounters* counters) {
+    // Estático: ~260 bytes fuera de la pila de la tarea
+    static UsageRecord record;
+    memset(&record, 0, sizeof(record));       // Relleno a cero: entra en el CRC
+    record.version = RELAY_USAGE_VERSION;
+    record.checkpoints = checkpoints + 1;
+    memcpy(record.targets, counters, sizeof(record.targets));
+    record.crc = record_crc(record);
+
+    Preferences prefs;
+    if (!prefs.begin(RELAY_USAGE_NAMESPACE, false)) {
+        Serial.println("[USAGE] ✗ No se pudo abrir NVS");
+        return false;
+    }
+    size_t written = prefs.putBytes(RELAY_USAGE_KEY, &record, sizeof(record));
+    prefs.end();
+
+    if (written != sizeof(record)) {
+        Serial.println("[USAGE] ✗ Error escribiendo en NVS");
+        return false;
+    }
+    checkpoints = record.checkpoints;
+    serial_printf("[USAGE] ✓ Contadores guardados (guardado #%lu)\n", (unsigned long)checkpoints);
+    return true;
+}
+
+static void add_counters(JsonObject obj, const UsageCounters &c, bool on) {
+    obj["on"] = on;
+    obj["cycles"] = c.cycles;
+    obj["on_s"] = (uint32_t)(c.onMs / 1000);
+    JsonObject bySource = obj.createNestedObject("on_s_by_source");
+    for (uint8_t s = 0; s < ACTUATION_SOURCE_COUNT; s++) {
+        bySource[actuation_source_name((ActuationSource)s)] = (uint32_t)(c.onMsBySource[s] / 1000);
+    }
+}
+
+static void publish_usage(const UsageCounters* counters, const bool* isOn) {
+    StaticJsonDocument<1024> doc;
+    doc["uptime_ms"] = millis();
+    doc["checkpoints"] = checkpoints;
+
+    JsonArray zones = doc.createNestedArray("zones");
+    for (uint8_t t = 0; t < USAGE_TARGET_FAN; t++) {
+        JsonObject zone = zones.createNestedObject();
+        zone["zone"] = t + 1;
+        add_counters(zone, counters[t], isOn[t]);
+    }
+    add_counters(doc.createNestedObject("fan"), counters[USAGE_TARGET_FAN], isOn[USAGE_TARGET_FAN]);
+
+    mqtt_publish_json(TOPIC_USAGE_METRICS, doc);
+}
+
+// Publica cada RELAY_USAGE_REPORT_INTERVAL; guarda en flash como mucho cada
+// RELAY_USAGE_CHECKPOINT_MS y solo si algo cambió
+static void relayUsageTask(void *parameter) {
+    static UsageCounters counters[USAGE_TARGETS];
+    bool isOn[USAGE_TARGETS];
+    bool pendingSave = false;
+    unsigned long lastCheckpoint = millis();
+    TickType_t lastWake = xTaskGetTickCount();
+
+    while (true) {
+        vTaskDelayUntil(&lastWake, pdMS_TO_TICKS(RELAY_USAGE_REPORT_INTERVAL));
+
+        bool changed;
+        snapshot_counters(counters, isOn, changed);
+        pendingSave |= changed;
+
+        if (pendingSave && millis() - lastCheckpoint >= RELAY_USAGE_CHECKPOINT_MS) {
+            if (write_checkpoint(counters)) pendingSave = false;
+            lastCheckpoint = millis();
+        }
+
+        if (mqtt_is_connected()) publish_usage(counters, isOn);
+    }
+}
+
+void relay_usage_start() {
+    load_checkpoint();
+    task_plan_start(TASK_ROLE_RELAY_USAGE, relayUsageTask, NULL, NULL);
+}
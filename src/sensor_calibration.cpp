@@ -0,0 +1,78 @@
+// src/sensor_calibration.cpp
+#include "sensor_calibration.h"
+#include "serial_log.h"
+#include "config.h"
+#include <esp_adc_cal.h>
+#include <math.h>
+
+#define LUT_SEGMENT   (1 << SENSOR_LUT_SEGMENT_BITS)        // Cuentas por tramo
+#define LUT_KNOTS     ((ADC_MAX_VALUE + 1) / LUT_SEGMENT + 1)
+#define LUX_FRAC_BITS 4     // La tabla de lux guarda 1/16 de lux: en penumbra 1 lux es mucho
+
+static_assert((ADC_MAX_VALUE + 1) % LUT_SEGMENT == 0, "Los tramos deben cubrir el rango del ADC");
+static_assert((int64_t)LDR_LUX_MAX * (1 << LUX_FRAC_BITS) * LUT_SEGMENT < INT32_MAX,
+              "La interpolación de lux debe caber en 32 bits");
+
+// Valor convertido en cada nodo (raw = nodo · LUT_SEGMENT, el último en ADC_MAX_VALUE)
+static int32_t temperatureLut[LUT_KNOTS];
+static int32_t luxLut[LUT_KNOTS];          // lux << LUX_FRAC_BITS
+static const char* calibrationSource = "default_vref";
+
+static inline int32_t lut_lookup(const int32_t* lut, uint16_t raw) {
+    if (raw > ADC_MAX_VALUE) raw = ADC_MAX_VALUE;
+    uint32_t knot = raw >> SENSOR_LUT_SEGMENT_BITS;
+    int32_t frac = raw & (LUT_SEGMENT - 1);
+    int32_t base = lut[knot];
+    return base + (lut[knot + 1] - base) * frac / LUT_SEGMENT;
+}
+
+int32_t adc_to_millicelsius(uint16_t raw) {
+    return lut_lookup(temperatureLut, raw);
+}
+
+int32_t adc_to_lux(uint16_t raw) {
+    return (lut_lookup(luxLut, raw) + (1 << (LUX_FRAC_BITS - 1))) >> LUX_FRAC_BITS;
+}
+
+const char* sensor_calibration_source() {
+    return calibrationSource;
+}
+
+// Divisor: LDR_FIXED_RESISTOR_OHMS entre la alimentación y el pin, LDR a GND
+// (más oscuro = más cuentas). La potencia solo se calcula aquí, al arrancar.
+// Devuelve lux << LUX_FRAC_BITS.
+static int32_t ldr_lux_at(uint32_t millivolts) {
+    if (millivolts >= LDR_SUPPLY_MV) return 0;                          // LDR abierto: oscuridad total
+    if (millivolts == 0) return (int32_t)LDR_LUX_MAX << LUX_FRAC_BITS;  // LDR en corto: saturado
+
+    float ohms = (float)LDR_FIXED_RESISTOR_OHMS * millivolts / (LDR_SUPPLY_MV - millivolts);
+    float lux = 10.0f * powf((float)LDR_R10_OHMS / ohms, 100.0f / LDR_GAMMA_X100);
+    if (lux >= LDR_LUX_MAX) return (int32_t)LDR_LUX_MAX << LUX_FRAC_BITS;
+    return (int32_t)(lux * (1 << LUX_FRAC_BITS) + 0.5f);
+}
+
+void sensor_calibration_init() {
+    // analogRead() usa el ADC1 a 12 bits con atenuación de 11 dB
+    esp_adc_cal_characteristics_t adc;
+    esp_adc_cal_value_t source = esp_adc_cal_characterize(ADC_UNIT_1, ADC_ATTEN_DB_11, ADC_WIDTH_BIT_12,
+                                                          ADC_DEFAULT_VREF_MV, &adc);
+    switch (source) {
+        case ESP_ADC_CAL_VAL_EFUSE_TP:   calibrationSource = "efuse_tp";   break;
+        case ESP_ADC_CAL_VAL_EFUSE_VREF: calibrationSource = "efuse_vref"; break;
+        default:                         calibrationSource = "default_vref"; break;
+    }
+
+    for (uint32_t knot = 0; knot < LUT_KNOTS; knot++) {
+        uint32_t raw = knot * LUT_SEGMENT;
+        if (raw > ADC_MAX_VALUE) raw = ADC_MAX_VALUE;
+        uint32_t millivolts = esp_adc_cal_raw_to_voltage(raw, &adc);
+
+        temperatureLut[knot] = (int32_t)(millivolts * 1000 / TEMP_SENSOR_MV_PER_C);
+        luxLut[knot] = ldr_lux_at(millivolts);
+    }
+
+    serial_printf("[SENSORS] ✓ Tablas de conversión listas (%u nodos, calibración %s): %ld..%ld m°C, %ld..%ld lux\n",
+                  (unsigned)LUT_KNOTS, calibrationSource,
+                  (long)temperatureLut[0], (long)temperatureLut[LUT_KNOTS - 1],
+                  (long)(luxLut[LUT_KNOTS - 1] >> LUX_FRAC_BITS), (long)(luxLut[0] >> LUX_FRAC_BITS));
+}
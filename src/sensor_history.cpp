@@ -0,0 +1,293 @@
+// src/sensor_history.cpp
+#include "sensor_history.h"
+#include "serial_log.h"
+#include "mqtt_client.h"
+#include "config.h"
+#include <ArduinoJson.h>
+#include <esp_timer.h>
+
+#define HISTORY_ID_MAX_LEN   32
+
+// Tiempos con la base de 64 bits de esp_timer: millis() da la vuelta a los 49,7 días.
+// Segundos y milisegundos por separado: 8 bytes por muestra y sin vuelta en 136 años.
+struct RawSample {
+    uint32_t s;        // s desde el arranque
+    uint16_t ms;       // 0-999 (puede haber varias muestras por segundo)
+    int16_t value;
+};
+
+struct HistoryBucket {
+    uint32_t t;        // Inicio del intervalo (s)
+    int16_t min;
+    int16_t max;
+    int16_t avg;
+    uint16_t count;
+};
+
+// Intervalo en curso (aún no cerrado)
+struct HistoryAccumulator {
+    uint32_t start;
+    int32_t sum;
+    int16_t min;
+    int16_t max;
+    uint16_t count;
+};
+
+// Tiempo de ordenación: ms en las muestras crudas, s en los agregados
+static inline uint64_t item_time(const RawSample &sample) {
+    return (uint64_t)sample.s * 1000 + sample.ms;
+}
+
+static inline uint64_t item_time(const HistoryBucket &bucket) {
+    return bucket.t;
+}
+
+static inline uint64_t uptime_ms() {
+    return (uint64_t)esp_timer_get_time() / 1000;
+}
+
+// Anillo de tamaño fijo; at(0) es el elemento más antiguo
+template <typename T, uint16_t N>
+struct HistoryRing {
+    T items[N];
+    uint16_t head;     // Próxima posición de escritura
+    uint16_t count;
+
+    void push(const T &item) {
+        items[head] = item;
+        head = (head + 1) % N;
+        if (count < N) count++;
+    }
+
+    const T &at(uint16_t index) const {
+        return items[(head + N - count + index) % N];
+    }
+
+    // Primer índice con t >= minT (búsqueda binaria: los tiempos son crecientes)
+    uint16_t lower_bound(uint64_t minT) const {
+        uint16_t lo = 0, hi = count;
+        while (lo < hi) {
+            uint16_t mid = (lo + hi) / 2;
+            if (item_time(at(mid)) >= minT) hi = mid;
+            else lo = mid + 1;
+        }
+        return lo;
+    }
+};
+
+struct ChannelHistory {
+    HistoryRing<RawSample, HISTORY_RAW_SAMPLES> raw;
+    HistoryRing<HistoryBucket, HISTORY_1MIN_BUCKETS> minute;
+    HistoryRing<HistoryBucket, HISTORY_15MIN_BUCKETS> quarter;
+    HistoryAccumulator minuteAcc;
+    HistoryAccumulator quarterAcc;
+};
+
+static const char* CHANNEL_NAMES[SENSOR_CHANNEL_COUNT] = {"temperature", "ldr"};
+static const char* RES_NAMES[] = {"raw", "1m", "15m"};
+
+// Memoria fija: no hay reservas dinámicas después del arranque
+static ChannelHistory history[SENSOR_CHANNEL_COUNT];
+static SemaphoreHandle_t historyMutex = NULL;
+static StaticSemaphore_t historyMutexBuffer;
+
+void sensor_history_init() {
+    memset(history, 0, sizeof(history));
+    historyMutex = xSemaphoreCreateMutexStatic(&historyMutexBuffer);
+    serial_printf("[HISTORY] %u bytes reservados para %d canales\n",
+                  (unsigned)sizeof(history), SENSOR_CHANNEL_COUNT);
+}
+
+static void acc_add(HistoryAccumulator &acc, uint32_t start, int16_t min, int16_t max, int32_t sum, uint16_t count) {
+    if (acc.count == 0) {
+        acc.start = start;
+        acc.min = min;
+        acc.max = max;
+        acc.sum = 0;
+    } else {
+        if (min < acc.min) acc.min = min;
+        if (max > acc.max) acc.max = max;
+    }
+    acc.sum += sum;
+    acc.count += count;
+}
+
+static HistoryBucket acc_close(HistoryAccumulator &acc) {
+    HistoryBucket bucket;
+    bucket.t = acc.start;
+    bucket.min = acc.min;
+    bucket.max = acc.max;
+    bucket.avg = (int16_t)(acc.sum / acc.count);
+    bucket.count = acc.count;
+    acc.count = 0;
+    return bucket;
+}
+
+void sensor_history_add(SensorChannel channel, int16_t value) {
+    if (channel >= SENSOR_CHANNEL_COUNT || historyMutex == NULL) return;
+
+    uint64_t nowMs = uptime_ms();
+    uint32_t t = (uint32_t)(nowMs / 1000);
+    uint32_t minuteStart = t - (t % 60);
+    ChannelHistory &h = history[channel];
+
+    xSemaphoreTake(historyMutex, portMAX_DELAY);
+
+    RawSample sample = {t, (uint16_t)(nowMs % 1000), value};
+    h.raw.push(sample);
+
+    // Cambio de minuto: se cierra el agregado de 1 min y se pliega en el de 15 min
+    if (h.minuteAcc.count > 0 && h.minuteAcc.start != minuteStart) {
+        int32_t minuteSum = h.minuteAcc.sum;
+        HistoryBucket closed = acc_close(h.minuteAcc);
+        h.minute.push(closed);
+
+        uint32_t quarterStart = closed.t - (closed.t % 900);
+        if (h.quarterAcc.count > 0 && h.quarterAcc.start != quarterStart) {
+            h.quarter.push(acc_close(h.quarterAcc));
+        }
+        acc_add(h.quarterAcc, quarterStart, closed.min, closed.max, minuteSum, closed.count);
+    }
+    acc_add(h.minuteAcc, minuteStart, value, value, value, 1);
+
+    xSemaphoreGive(historyMutex);
+}
+
+// ============================
+// Consulta por MQTT
+// ============================
+
+struct HistoryChunk {
+    char buffer[HISTORY_CHUNK_MAX_BYTES];
+    size_t length;
+    uint16_t rows;
+};
+
+static void chunk_begin(HistoryChunk &chunk, const char* id, SensorChannel channel,
+                        HistoryResolution res, uint16_t index) {
+    int n = snprintf(chunk.buffer, sizeof(chunk.buffer),
+                     "{\"id\":\"%s\",\"ch\":\"%s\",\"res\":\"%s\",\"now\":%lu,\"chunk\":%u,\"fields\":%s,\"rows\":[",
+                     id, CHANNEL_NAMES[channel], RES_NAMES[res], (unsigned long)(uptime_ms() / 1000), index,
+                     res == HISTORY_RES_RAW ? "[\"t\",\"v\"]" : "[\"t\",\"min\",\"max\",\"avg\",\"n\"]");
+    chunk.length = (size_t)n;
+    chunk.rows = 0;
+}
+
+// Espacio reservado para el cierre: ],"last":false}
+#define CHUNK_FOOTER_RESERVE  20
+
+static bool chunk_append(HistoryChunk &chunk, const char* row, size_t rowLen) {
+    size_t needed = rowLen + (chunk.rows > 0 ? 1 : 0);
+    if (chunk.length + needed + CHUNK_FOOTER_RESERVE > sizeof(chunk.buffer)) return false;
+
+    if (chunk.rows > 0) chunk.buffer[chunk.length++] = ',';
+    memcpy(chunk.buffer + chunk.length, row, rowLen);
+    chunk.length += rowLen;
+    chunk.rows++;
+    return true;
+}
+
+static void chunk_send(HistoryChunk &chunk, bool last) {
+    int n = snprintf(chunk.buffer + chunk.length, sizeof(chunk.buffer) - chunk.length,
+                     "],\"last\":%s}", last ? "true" : "false");
+    chunk.length += n;
+    mqtt_publish(TOPIC_HISTORY_DATA, (const uint8_t*)chunk.buffer, chunk.length);
+}
+
+// Formatea la primera fila con cursor <= t <= to (en las unidades del anillo).
+// Devuelve su longitud (0 = no hay más) y el cursor para la siguiente.
+static size_t next_row(const ChannelHistory &h, HistoryResolution res, uint64_t cursor, uint64_t to,
+                       char* row, size_t rowSize, uint64_t &nextCursor) {
+    if (res == HISTORY_RES_RAW) {
+        uint16_t i = h.raw.lower_bound(cursor);
+        if (i >= h.raw.count || item_time(h.raw.at(i)) > to) return 0;
+        const RawSample &s = h.raw.at(i);
+        nextCursor = item_time(s) + 1;
+        return snprintf(row, rowSize, "[%llu,%d]", (unsigned long long)item_time(s), s.value);
+    }
+
+    const HistoryBucket* b = NULL;
+    if (res == HISTORY_RES_1MIN) {
+        uint16_t i = h.minute.lower_bound(cursor);
+        if (i < h.minute.count) b = &h.minute.at(i);
+    } else {
+        uint16_t i = h.quarter.lower_bound(cursor);
+        if (i < h.quarter.count) b = &h.quarter.at(i);
+    }
+    if (b == NULL || b->t > to) return 0;
+    nextCursor = b->t + 1;
+    return snprintf(row, rowSize, "[%lu,%d,%d,%d,%u]",
+                    (unsigned long)b->t, b->min, b->max, b->avg, b->count);
+}
+
+void handle_history_query(const uint8_t* payload, unsigned int length) {
+    StaticJsonDocument<256> doc;
+    if (deserializeJson(doc, payload, length)) {
+        Serial.println("[HISTORY] ✗ Consulta con JSON inválido");
+        return;
+    }
+
+    // El id se devuelve tal cual: se descartan caracteres que romperían el JSON
+    char id[HISTORY_ID_MAX_LEN + 1];
+    const char* rawId = doc["id"] | "";
+    size_t idLen = 0;
+    for (const char* p = rawId; *p && idLen < HISTORY_ID_MAX_LEN; p++) {
+        if (*p != '"' && *p != '\\' && (uint8_t)*p >= 0x20) id[idLen++] = *p;
+    }
+    id[idLen] = '\0';
+
+    const char* channelName = doc["channel"] | "";
+    int channel = -1;
+    for (int i = 0; i < SENSOR_CHANNEL_COUNT; i++) {
+        if (strcmp(channelName, CHANNEL_NAMES[i]) == 0) channel = i;
+    }
+    const char* resName = doc["res"] | "raw";
+    int res = -1;
+    for (int i = 0; i <= HISTORY_RES_15MIN; i++) {
+        if (strcmp(resName, RES_NAMES[i]) == 0) res = i;
+    }
+    if (channel < 0 || res < 0) {
+        serial_printf("[HISTORY] ✗ Canal o resolución inválidos (%s, %s)\n", channelName, resName);
+        return;
+    }
+
+    uint64_t from = doc["from"] | 0UL;
+    uint64_t to = doc["to"] | 0xFFFFFFFFUL;
+    const ChannelHistory &h = history[channel];
+
+    // Las muestras crudas van en ms; los agregados en s (en 64 bits no desborda)
+    uint64_t cursor = from;
+    if (res == HISTORY_RES_RAW) {
+        cursor = from * 1000;
+        to = to * 1000 + 999;
+    }
+
+    // Cursor por tiempo: si llegan muestras entre trozos no se repiten ni se saltan filas
+    uint16_t chunkIndex = 0;
+    uint32_t totalRows = 0;
+    HistoryChunk chunk;
+    char row[48];
+
+    chunk_begin(chunk, id, (SensorChannel)channel, (HistoryResolution)res, chunkIndex);
+
+    while (true) {
+        xSemaphoreTake(historyMutex, portMAX_DELAY);
+        uint64_t nextCursor = cursor;
+        size_t rowLen = next_row(h, (HistoryResolution)res, cursor, to, row, sizeof(row), nextCursor);
+        xSemaphoreGive(historyMutex);
+
+        if (rowLen == 0) break;
+
+        if (!chunk_append(chunk, row, rowLen)) {
+            chunk_send(chunk, false);
+            chunk_begin(chunk, id, (SensorChannel)channel, (HistoryResolution)res, ++chunkIndex);
+            chunk_append(chunk, row, rowLen);
+        }
+        cursor = nextCursor;
+        totalRows++;
+    }
+
+    chunk_send(chunk, true);
+    serial_printf("[HISTORY] ✓ Consulta '%s': %lu filas en %u trozos\n",
+                  id, (unsigned long)totalRows, chunkIndex + 1);
+}
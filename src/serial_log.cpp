@@ -0,0 +1,21 @@
+// src/serial_log.cpp
+#include "serial_log.h"
+#include "config.h"
+#include <stdarg.h>
+
+size_t serial_printf(const char* format, ...) {
+    char line[SERIAL_LOG_LINE_MAX];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    if (length < 0) return 0;
+
+    if ((size_t)length >= sizeof(line)) {
+        // Recortada: si el formato terminaba en salto de línea, se mantiene
+        length = sizeof(line) - 1;
+        size_t formatLength = strlen(format);
+        if (formatLength > 0 && format[formatLength - 1] == '\n') line[length - 1] = '\n';
+    }
+    return Serial.write((const uint8_t*)line, length);
+}
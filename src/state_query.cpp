@@ -0,0 +1,107 @@
+// src/state_query.cpp
+#include "state_query.h"
+#include "serial_log.h"
+#include "mqtt_client.h"
+#include "config.h"
+#include "light_controller.h"
+#include "adaptive_sampling.h"
+#include "json_formatter.h"
+#include "sensor_calibration.h"
+#include <ArduinoJson.h>
+
+static const char* query_type(TopicId topic) {
+    switch (topic) {
+        case TOPIC_LIGHTS_GET:  return "lights";
+        case TOPIC_FAN_GET:     return "fan";
+        case TOPIC_SENSORS_GET: return "sensors";
+        case TOPIC_MEMORY_GET:  return "memory";
+        case TOPIC_WIFI_GET:    return "wifi";
+        default:                return NULL;
+    }
+}
+
+// El topic de respuesta no puede llevar comodines ni estar vacío, ni caer bajo
+// DEVICE_TOPIC_PREFIX (salvo state/response): una respuesta publicada en
+// .../set o en un estado retenido la tomaríamos por un comando o un estado
+// nuestro. Tampoco en $SYS y demás topics reservados del broker.
+static bool valid_reply_topic(const char* topic) {
+    size_t len = strlen(topic);
+    if (len == 0 || len > STATE_REPLY_TOPIC_MAX) return false;
+    if (strpbrk(topic, "+#") != NULL || topic[0] == '$') return false;
+
+    static const char OWN_PREFIX[] = DEVICE_TOPIC_PREFIX "/";
+    bool own = strcmp(topic, DEVICE_TOPIC_PREFIX) == 0 ||
+               strncmp(topic, OWN_PREFIX, sizeof(OWN_PREFIX) - 1) == 0;
+    return !own || strcmp(topic, topic_path(TOPIC_STATE_RESPONSE)) == 0;
+}
+
+static void append_channel(JsonDocument &doc, const char* key, SensorChannel channel) {
+    ChannelSample sample = adaptive_sampling_get(channel);
+    JsonObject out = doc.createNestedObject(key);
+    if (sample.samples == 0) {
+        out["value"] = nullptr;
+        return;
+    }
+    out["value"] = sample.value;
+    out["raw"] = sample.raw;
+    if (channel == SENSOR_CHANNEL_TEMPERATURE) {
+        out["millicelsius"] = adc_to_millicelsius(sample.raw);
+    } else {
+        out["lux"] = adc_to_lux(sample.raw);
+    }
+    out["active"] = sample.active;
+    out["sample_interval_ms"] = sample.intervalMs;
+    out["timestamp"] = sample.timestampMs;
+}
+
+void handle_state_query(TopicId topic, const uint8_t* payload, unsigned int length) {
+    const char* type = query_type(topic);
+    if (type == NULL) return;
+
+    // Petición vacía = sin id y respuesta en state/response
+    StaticJsonDocument<256> request;
+    if (length > 0 && deserializeJson(request, payload, length)) {
+        serial_printf("[STATE] ✗ Consulta %s con JSON inválido\n", type);
+        return;
+    }
+
+    char id[STATE_QUERY_ID_MAX + 1];
+    strncpy(id, request["id"] | "", sizeof(id) - 1);
+    id[sizeof(id) - 1] = '\0';
+
+    const char* replyTo = request["reply_to"] | topic_path(TOPIC_STATE_RESPONSE);
+    if (!valid_reply_topic(replyTo)) {
+        serial_printf("[STATE] ✗ Topic de respuesta inválido: %s\n", replyTo);
+        return;
+    }
+
+    StaticJsonDocument<768> doc;
+    doc["id"] = id;
+    doc["type"] = type;
+    doc["uptime_ms"] = millis();
+
+    switch (topic) {
+        case TOPIC_LIGHTS_GET:
+            fill_lights_status(doc);
+            doc["mask"] = get_light_mask();
+            break;
+        case TOPIC_FAN_GET:
+            fill_fan_status(doc);
+            break;
+        case TOPIC_SENSORS_GET:
+            // value: centésimas de °C / cuentas ADC; además la conversión calibrada
+            append_channel(doc, "temperature", SENSOR_CHANNEL_TEMPERATURE);
+            append_channel(doc, "ldr", SENSOR_CHANNEL_LDR);
+            break;
+        case TOPIC_MEMORY_GET:
+            generate_memory_json(doc);
+            break;
+        case TOPIC_WIFI_GET:
+            generate_wifi_json(wifi_get_snapshot(), doc);
+            break;
+        default:
+            break;
+    }
+
+    mqtt_reply_json(replyTo, doc);
+}
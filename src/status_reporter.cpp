@@ -1,36 +1,90 @@
 #include "status_reporter.h"
+#include "serial_log.h"
 #include "mqtt_client.h"
 #include "config.h"
+#include "task_supervisor.h"
+#include "task_plan.h"
+#include "control_dispatcher.h"
+#include "device_state.h"
+#include "udp_control.h"
 #include <ArduinoJson.h>
 
+// Contadores de la tarea de control en system/diagnostics, solo si cambiaron
+static void report_control_stats() {
+    static unsigned long lastReport = 0;
+    static uint32_t reportedCount = 0;
+    static uint32_t reportedDropped = 0;
+    static uint32_t reportedUrgent = 0;
+    static uint32_t reportedUdp = 0;
+
+    unsigned long now = millis();
+    if (now - lastReport < CONTROL_REPORT_INTERVAL) return;
+
+    ControlLatencyStats stats = control_dispatcher_get_stats();
+    UdpControlStats udp = udp_control_get_stats();   // A cero sin UDP_CONTROL_ENABLED
+    if (stats.count == reportedCount && stats.dropped == reportedDropped &&
+        stats.urgentCount == reportedUrgent && udp.requests == reportedUdp) return;
+
+    StaticJsonDocument<512> doc;
+    JsonObject control = doc.createNestedObject("control");
+    control["applied"] = stats.count;
+    control["coalesced"] = stats.coalesced;
+    control["rate_limited"] = stats.rateLimited;
+    control["dropped"] = stats.dropped;
+    control["avg_us"] = stats.avgUs;
+    control["max_us"] = stats.maxUs;
+    control["preempted"] = stats.preempted;
+    JsonObject urgent = control.createNestedObject("urgent");
+    urgent["count"] = stats.urgentCount;
+    urgent["avg_us"] = stats.urgentAvgUs;
+    urgent["max_us"] = stats.urgentMaxUs;
+    urgent["over_target"] = stats.urgentOverTarget;
+#if UDP_CONTROL_ENABLED
+    JsonObject local = control.createNestedObject("udp");
+    local["requests"] = udp.requests;
+    local["rejected"] = udp.rejected;
+    local["avg_us"] = udp.avgUs;
+    local["max_us"] = udp.maxUs;
+#endif
+    doc["timestamp"] = now;
+
+    if (mqtt_publish_json(TOPIC_DIAGNOSTICS, doc)) {
+        lastReport = now;
+        reportedCount = stats.count;
+        reportedDropped = stats.dropped;
+        reportedUrgent = stats.urgentCount;
+        reportedUdp = udp.requests;
+    }
+}
+
 void statusReporterTask(void *parameter) {
+    SupervisedTaskId svId = supervisor_register("status_reporter", MQTT_HEARTBEAT_INTERVAL, false);
+
     while (true) {
+        supervisor_checkin(svId);
+
+        // El uptime en el documento consolidado hace de latido
+        device_state_set(STATE_UPTIME_S, millis() / 1000);
+
+#if DEVICE_STATE_LEGACY_TOPICS
         StaticJsonDocument<256> doc;
 
         doc["online"] = mqtt_is_connected();
         doc["timestamp"] = millis();
         doc["client_id"] = MQTT_CLIENT_ID;
 
-        String json;
-        serializeJsonPretty(doc, json);
-
-        Serial.println("[" MQTT_TOPIC_HEARTBEAT "]");
-        Serial.println(json);
+        serial_printf("[%s]\n", topic_path(TOPIC_HEARTBEAT));
+        serializeJsonPretty(doc, Serial);
+        Serial.println();
 
-        mqtt_publish(MQTT_TOPIC_HEARTBEAT, json);
+        mqtt_publish_json(TOPIC_HEARTBEAT, doc, true);
+#endif
+        report_control_stats();
 
         vTaskDelay(pdMS_TO_TICKS(MQTT_HEARTBEAT_INTERVAL));
     }
 }
 
 void start_status_reporter_task() {
-    xTaskCreatePinnedToCore(
-        statusReporterTask,
-        "StatusReporterTask",
-        4096,
-        NULL,
-        1,
-        NULL,
-        1
-    );
+    task_plan_start(TASK_ROLE_STATUS_REPORTER, statusReporterTask);
 }
@@ -0,0 +1,154 @@
+// src/task_plan.cpp
+#include "task_plan.h"
+#include "serial_log.h"
+
+// El inyector del benchmark ocupa el mismo sitio en ambos planes (el del callback
+// MQTT: núcleo 1, prioridad 1) para que solo cambie la colocación del resto.
+
+#if TASK_PLACEMENT_PLAN == TASK_PLAN_LEGACY
+
+// Colocación histórica, para comparar con el benchmark
+static constexpr TaskSpec TASK_PLAN[TASK_ROLE_COUNT] = {
+    // name                 stack  prio core heap
+    { "ControlTask",        4096,  1,   1, false },
+    { "SensorMonitorTask",  4096,  2,   0, false },
+    { "AutomationTask",     4096,  1,   0, false },
+    { "RelayStateStore",    3072,  1,   1, true  },
+    { "SupervisorTask",     4096,  3,   0, false },
+    { "WiFiInfoTask",       4096,  1,   1, false },
+    { "MemoryInfoTask",     4096,  1,   1, false },
+    { "StatusReporterTask", 4096,  1,   1, false },
+    { "TemperatureTask",    4096,  1,   1, false },
+    { "LDRTask",            4096,  1,   1, false },
+    { "AuditLogTask",       4096,  1,   1, true  },
+    { "DeviceStateTask",    4096,  1,   1, false },
+    { "RelayUsageTask",     4096,  1,   1, true  },
+    { "UdpControlTask",     3072,  3,   1, true  },
+    { "WiFiConnectTask",    3072,  2,   1, true  },
+    { "BenchLoadTask",      4096,  1,   1, false },
+    { "BenchDriverTask",    4096,  1,   1, false },
+    { "MicroBenchTask",     8192,  1,   1, false },
+};
+static const char* PLAN_NAME = "legacy";
+
+#else
+
+// Núcleo 1: control (comandos, automatización, muestreo) por encima de loop().
+// Núcleo 0: pila WiFi/LwIP, telemetría y supervisor.
+static constexpr TaskSpec TASK_PLAN[TASK_ROLE_COUNT] = {
+    // name                 stack  prio core heap
+    { "ControlTask",        4096,  5,   1, false },
+    { "SensorMonitorTask",  4096,  3,   1, false },
+    { "AutomationTask",     4096,  4,   1, false },
+    { "RelayStateStore",    3072,  1,   1, true  },
+    { "SupervisorTask",     4096,  3,   0, false },
+    { "WiFiInfoTask",       4096,  1,   0, false },
+    { "MemoryInfoTask",     4096,  1,   0, false },
+    { "StatusReporterTask", 4096,  1,   0, false },
+    { "TemperatureTask",    4096,  1,   0, false },
+    { "LDRTask",            4096,  1,   0, false },
+    { "AuditLogTask",       4096,  1,   0, true  },
+    { "DeviceStateTask",    4096,  1,   0, false },
+    { "RelayUsageTask",     4096,  1,   0, true  },
+    { "UdpControlTask",     3072,  3,   0, true  },
+    { "WiFiConnectTask",    3072,  2,   0, true  },
+    { "BenchLoadTask",      4096,  1,   0, false },
+    { "BenchDriverTask",    4096,  1,   1, false },
+    { "MicroBenchTask",     8192,  1,   1, false },
+};
+static const char* PLAN_NAME = "partitioned";
+
+#endif
+
+// heap = true: tareas que reservan por diseño y alloc_guard no cuenta
+// (RelayStateStore y RelayUsageTask escriben en NVS, AuditLogTask abre ficheros
+// de SPIFFS, UdpControlTask firma con mbedTLS y WiFiConnectTask arranca la
+// asociación WiFi). El resto no debe tocar el heap tras setup().
+
+// Tareas creadas (para saber si el código en curso es de la aplicación)
+static TaskHandle_t taskHandles[TASK_ROLE_COUNT] = {NULL};
+
+#if STATIC_ALLOCATION_MODE
+
+// Las tareas del benchmark van al final de la tabla y solo se reservan si se usan
+#if TASK_PLAN_BENCHMARK || BENCHMARK_MODE
+#define STATIC_TASK_ROLES  TASK_ROLE_COUNT
+#else
+#define STATIC_TASK_ROLES  TASK_ROLE_BENCHMARK_LOAD
+#endif
+
+constexpr uint32_t stack_total(uint8_t first, uint8_t end) {
+    return first >= end ? 0 : TASK_PLAN[first].stackSize + stack_total(first + 1, end);
+}
+
+// Pilas y TCB en memoria estática: ninguna tarea sale del heap
+static StackType_t stackArena[stack_total(0, STATIC_TASK_ROLES)] __attribute__((aligned(16)));
+static StaticTask_t taskBuffers[STATIC_TASK_ROLES];
+
+static StackType_t* stack_for(TaskRole role) {
+    return role < STATIC_TASK_ROLES ? stackArena + stack_total(0, role) : NULL;
+}
+
+#endif // STATIC_ALLOCATION_MODE
+
+const TaskSpec &task_plan_get(TaskRole role) {
+    return TASK_PLAN[role < TASK_ROLE_COUNT ? role : 0];
+}
+
+bool task_plan_start(TaskRole role, TaskFunction_t function, void* parameter, TaskHandle_t* handle) {
+    if (role >= TASK_ROLE_COUNT) return false;
+    const TaskSpec &spec = task_plan_get(role);
+
+#if STATIC_ALLOCATION_MODE
+    // En ESP-IDF StackType_t es un byte: stackSize va en bytes
+    StackType_t* stack = stack_for(role);
+    TaskHandle_t created = NULL;
+    if (stack != NULL && taskHandles[role] == NULL) {
+        created = xTaskCreateStaticPinnedToCore(
+            function,
+            spec.name,
+            spec.stackSize,
+            parameter,
+            spec.priority,
+            stack,
+            &taskBuffers[role],
+            spec.core
+        );
+    }
+    BaseType_t result = created != NULL ? pdPASS : pdFAIL;
+#else
+    TaskHandle_t created = NULL;
+    BaseType_t result = xTaskCreatePinnedToCore(
+        function,
+        spec.name,
+        spec.stackSize,
+        parameter,
+        spec.priority,
+        &created,
+        spec.core
+    );
+#endif
+
+    if (result != pdPASS) {
+        serial_printf("[TASK_PLAN] ✗ No se pudo crear %s\n", spec.name);
+        return false;
+    }
+    taskHandles[role] = created;
+    if (handle != NULL) *handle = created;
+
+    serial_printf("[TASK_PLAN] %s: núcleo %d, prioridad %u, pila %lu\n",
+                  spec.name, (int)spec.core, (unsigned)spec.priority, (unsigned long)spec.stackSize);
+    return true;
+}
+
+const char* task_plan_name() {
+    return PLAN_NAME;
+}
+
+bool task_plan_heap_guarded(TaskHandle_t task) {
+    if (task == NULL) return false;
+    for (uint8_t i = 0; i < TASK_ROLE_COUNT; i++) {
+        if (taskHandles[i] == task) return !TASK_PLAN[i].heapAllowed;
+    }
+    return false;
+}
@@ -0,0 +1,163 @@
+// src/task_supervisor.cpp
+#include "task_supervisor.h"
+#include "serial_log.h"
+#include "mqtt_client.h"
+#include "config.h"
+#include "task_plan.h"
+#include <ArduinoJson.h>
+#include <esp_task_wdt.h>
+
+struct SupervisedTask {
+    const char* name;
+    uint32_t periodMs;
+    bool critical;
+    uint32_t lastCheckin;
+    uint32_t misses;
+    uint32_t maxLatenessMs;
+    uint32_t reportedMisses;   // misses ya publicados
+    bool stalled;              // sin check-in desde hace más de lo tolerado
+};
+
+static SupervisedTask tasks[SUPERVISOR_MAX_TASKS];
+static uint8_t taskCount = 0;
+static portMUX_TYPE supervisorMux = portMUX_INITIALIZER_UNLOCKED;
+
+// Nombre de la tarea crítica que provocó el último reinicio (sobrevive al reset)
+static RTC_NOINIT_ATTR char lastStallName[16];
+static RTC_NOINIT_ATTR uint32_t lastStallMagic;
+#define STALL_MAGIC 0x5354414C  // "STAL"
+
+// Retraso permitido sobre el periodo antes de contar un incumplimiento
+static uint32_t allowed_lateness(const SupervisedTask &task) {
+    return task.periodMs * SUPERVISOR_TOLERANCE_PCT / 100 + SUPERVISOR_MIN_SLACK_MS;
+}
+
+SupervisedTaskId supervisor_register(const char* name, uint32_t periodMs, bool critical) {
+    SupervisedTaskId id = SUPERVISOR_INVALID_ID;
+
+    portENTER_CRITICAL(&supervisorMux);
+    if (taskCount < SUPERVISOR_MAX_TASKS) {
+        id = taskCount++;
+        SupervisedTask &task = tasks[id];
+        task.name = name;
+        task.periodMs = periodMs;
+        task.critical = critical;
+        task.lastCheckin = millis();
+        task.misses = 0;
+        task.maxLatenessMs = 0;
+        task.reportedMisses = 0;
+        task.stalled = false;
+    }
+    portEXIT_CRITICAL(&supervisorMux);
+
+    if (id == SUPERVISOR_INVALID_ID) {
+        serial_printf("[SUPERVISOR] ✗ Sin hueco para registrar %s\n", name);
+    }
+    return id;
+}
+
+void supervisor_checkin(SupervisedTaskId id) {
+    if (id >= taskCount) return;
+    uint32_t now = millis();
+
+    portENTER_CRITICAL(&supervisorMux);
+    SupervisedTask &task = tasks[id];
+    uint32_t interval = now - task.lastCheckin;
+    if (interval > task.periodMs) {
+        uint32_t lateness = interval - task.periodMs;
+        if (lateness > task.maxLatenessMs) task.maxLatenessMs = lateness;
+        // Si ya estaba marcada como atascada, el incumplimiento se contó en el supervisor
+        if (lateness > allowed_lateness(task) && !task.stalled) task.misses++;
+    }
+    task.lastCheckin = now;
+    task.stalled = false;
+    portEXIT_CRITICAL(&supervisorMux);
+}
+
+static void publish_violations(const SupervisedTask* snapshot, uint8_t count, uint32_t now) {
+    StaticJsonDocument<768> doc;
+    JsonArray list = doc.createNestedArray("violations");
+
+    for (uint8_t i = 0; i < count; i++) {
+        const SupervisedTask &task = snapshot[i];
+        if (task.misses == task.reportedMisses && !task.stalled) continue;
+
+        JsonObject entry = list.createNestedObject();
+        entry["task"] = task.name;
+        entry["period_ms"] = task.periodMs;
+        entry["misses"] = task.misses;
+        entry["max_late_ms"] = task.maxLatenessMs;
+        entry["silent_ms"] = now - task.lastCheckin;
+        entry["critical"] = task.critical;
+    }
+    if (list.size() == 0) return;
+
+    doc["timestamp"] = now;
+    if (!mqtt_publish_json(TOPIC_DIAGNOSTICS, doc)) return;
+
+    // Solo se dan por publicados si el mensaje salió
+    portENTER_CRITICAL(&supervisorMux);
+    for (uint8_t i = 0; i < count; i++) {
+        tasks[i].reportedMisses = snapshot[i].misses;
+    }
+    portEXIT_CRITICAL(&supervisorMux);
+}
+
+static void supervisorTask(void *parameter) {
+    // Watchdog hardware: este bucle lo alimenta mientras las tareas críticas respondan
+    esp_task_wdt_init(SUPERVISOR_WDT_TIMEOUT_S, true);
+    esp_task_wdt_add(NULL);
+
+    if (lastStallMagic == STALL_MAGIC) {
+        lastStallName[sizeof(lastStallName) - 1] = '\0';
+        serial_printf("[SUPERVISOR] Reinicio anterior por bloqueo de: %s\n", lastStallName);
+        lastStallMagic = 0;
+    }
+
+    SupervisedTask snapshot[SUPERVISOR_MAX_TASKS];
+
+    while (true) {
+        uint32_t now = millis();
+        bool criticalStall = false;
+        const char* stalledName = NULL;
+
+        portENTER_CRITICAL(&supervisorMux);
+        uint8_t count = taskCount;
+        for (uint8_t i = 0; i < count; i++) {
+            SupervisedTask &task = tasks[i];
+            uint32_t silent = now - task.lastCheckin;
+
+            // Tarea que no llega: cuenta como incumplimiento una vez por episodio
+            if (!task.stalled && silent > task.periodMs + allowed_lateness(task)) {
+                task.stalled = true;
+                task.misses++;
+            }
+            if (task.stalled && silent - task.periodMs > task.maxLatenessMs) {
+                task.maxLatenessMs = silent - task.periodMs;
+            }
+            if (task.critical && silent > SUPERVISOR_STALL_RESET_MS) {
+                criticalStall = true;
+                stalledName = task.name;
+            }
+            snapshot[i] = task;
+        }
+        portEXIT_CRITICAL(&supervisorMux);
+
+        publish_violations(snapshot, count, now);
+
+        if (criticalStall) {
+            // No se alimenta el watchdog: el reset llega en SUPERVISOR_WDT_TIMEOUT_S
+            serial_printf("[SUPERVISOR] ✗ Tarea crítica %s bloqueada, esperando al watchdog\n", stalledName);
+            strncpy(lastStallName, stalledName, sizeof(lastStallName) - 1);
+            lastStallMagic = STALL_MAGIC;
+        } else {
+            esp_task_wdt_reset();
+        }
+
+        vTaskDelay(pdMS_TO_TICKS(SUPERVISOR_CHECK_INTERVAL));
+    }
+}
+
+void start_supervisor_task() {
+    task_plan_start(TASK_ROLE_SUPERVISOR, supervisorTask);
+}
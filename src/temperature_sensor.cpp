@@ -1,41 +1,48 @@
 // src/temperature_sensor.cpp
 #include "temperature_sensor.h"
+#include "serial_log.h"
 #include "mqtt_client.h"
 #include "config.h"
+#include "task_plan.h"
+#include "adaptive_sampling.h"
+#include "device_state.h"
+#include "sensor_calibration.h"
 #include <ArduinoJson.h>
 
+// Publica la última muestra de sensorMonitorTask (no lee el ADC).
+// Con la señal plana publica cada TEMP_REPORT_IDLE_INTERVAL; al activarse el
+// canal el muestreador la despierta y pasa a TEMP_REPORT_INTERVAL.
 void temperatureTask(void *parameter) {
-    analogReadResolution(ADC_RESOLUTION_BITS);
+    adaptive_sampling_set_reporter(SENSOR_CHANNEL_TEMPERATURE, xTaskGetCurrentTaskHandle());
+
     while (true) {
-        int raw = analogRead(TEMP_SENSOR_PIN);
-        float voltage = (raw / float(ADC_MAX_VALUE)) * ADC_REF_VOLTAGE;
-        float temperatureC = voltage * 100.0;  // LM35: 10mV/°C
+        ChannelSample sample = adaptive_sampling_get(SENSOR_CHANNEL_TEMPERATURE);
 
-        StaticJsonDocument<128> doc;
-        doc["temperature_c"] = temperatureC;
-        doc["adc"] = raw;
-        doc["timestamp"] = millis();
+        if (sample.samples > 0) {
+            int32_t milli = adc_to_millicelsius(sample.raw);
+            device_state_set(STATE_TEMPERATURE, milli);
 
-        String json;
-        serializeJsonPretty(doc, json);
+#if DEVICE_STATE_LEGACY_TOPICS
+            StaticJsonDocument<160> doc;
+            doc["temperature_c"] = sample.value / 100.0;
+            doc["temperature_mc"] = milli;
+            doc["adc"] = sample.raw;
+            doc["sample_interval_ms"] = sample.intervalMs;
+            doc["timestamp"] = sample.timestampMs;
 
-        Serial.println("[" MQTT_TOPIC_TEMPERATURE "]");
-        Serial.println(json);
+            serial_printf("[%s]\n", topic_path(TOPIC_TEMPERATURE));
+            serializeJsonPretty(doc, Serial);
+            Serial.println();
 
-        mqtt_publish(MQTT_TOPIC_TEMPERATURE, json);
+            mqtt_publish_json(TOPIC_TEMPERATURE, doc, true);
+#endif
+        }
 
-        vTaskDelay(pdMS_TO_TICKS(TEMP_REPORT_INTERVAL));
+        uint32_t interval = sample.active ? TEMP_REPORT_INTERVAL : TEMP_REPORT_IDLE_INTERVAL;
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(interval));
     }
 }
 
 void start_temperature_task() {
-    xTaskCreatePinnedToCore(
-        temperatureTask,
-        "TemperatureTask",
-        4096,
-        NULL,
-        1,
-        NULL,
-        1
-    );
+    task_plan_start(TASK_ROLE_TEMPERATURE, temperatureTask);
 }
@@ -0,0 +1,399 @@
+// src/tls_transport.cpp
+#include "tls_transport.h"
+#include "serial_log.h"
+#include "config.h"
+#include "tls_ca_cert.h"
+#include <mbedtls/ctr_drbg.h>
+#include <mbedtls/entropy.h>
+#include <mbedtls/x509_crt.h>
+#include <mbedtls/error.h>
+#include <esp_attr.h>
+#include <esp_timer.h>
+#include <rom/crc.h>
+
+#if MQTT_USE_TLS
+
+#define TLS_SESSION_MAGIC  0x544C5331   // "TLS1"
+
+// ============================
+// Configuración compartida (una vez por arranque)
+// ============================
+static mbedtls_ssl_config conf;
+static mbedtls_entropy_context entropy;
+static mbedtls_ctr_drbg_context drbg;
+static mbedtls_x509_crt caChain;
+static bool configReady = false;
+
+// ============================
+// Caché de sesión: RAM + copia serializada en RTC
+// ============================
+struct TlsSessionRecord {
+    uint32_t magic;
+    uint16_t port;
+    uint16_t length;
+    char host[48];
+    uint8_t data[TLS_SESSION_CACHE_BYTES];
+    uint32_t crc;
+};
+
+static RTC_NOINIT_ATTR TlsSessionRecord rtcSession;
+
+static mbedtls_ssl_session cachedSession;
+static bool haveSession = false;
+static char cachedHost[48] = "";
+static uint16_t cachedPort = 0;
+
+static TlsHandshakeStats stats = {};
+
+static uint32_t session_crc(const TlsSessionRecord &record) {
+    return crc32_le(0, (const uint8_t*)&record, offsetof(TlsSessionRecord, crc));
+}
+
+static void log_mbedtls_error(const char* step, int ret) {
+    char text[96];
+    mbedtls_strerror(ret, text, sizeof(text));
+    serial_printf("[TLS] ✗ %s: -0x%04X %s\n", step, (unsigned)-ret, text);
+}
+
+static void forget_session() {
+    mbedtls_ssl_session_free(&cachedSession);
+    mbedtls_ssl_session_init(&cachedSession);
+    haveSession = false;
+    rtcSession.magic = 0;
+}
+
+// Recupera la sesión guardada en RTC antes del reinicio, si es válida
+static void restore_rtc_session() {
+    if (rtcSession.magic != TLS_SESSION_MAGIC ||
+        rtcSession.length > sizeof(rtcSession.data) ||
+        rtcSession.crc != session_crc(rtcSession)) {
+        rtcSession.magic = 0;
+        return;
+    }
+    if (mbedtls_ssl_session_load(&cachedSession, rtcSession.data, rtcSession.length) != 0) {
+        forget_session();
+        return;
+    }
+    strlcpy(cachedHost, rtcSession.host, sizeof(cachedHost));
+    cachedPort = rtcSession.port;
+    haveSession = true;
+    stats.sessionFromRtc = true;
+    serial_printf("[TLS] ✓ Sesión recuperada de RTC (%s:%u)\n", cachedHost, cachedPort);
+}
+
+static void store_session(mbedtls_ssl_context &ssl, const char* host, uint16_t port) {
+    mbedtls_ssl_session_free(&cachedSession);
+    mbedtls_ssl_session_init(&cachedSession);
+    if (mbedtls_ssl_get_session(&ssl, &cachedSession) != 0) {
+        forget_session();
+        return;
+    }
+    haveSession = true;
+    strlcpy(cachedHost, host, sizeof(cachedHost));
+    cachedPort = port;
+
+    size_t length = 0;
+    if (mbedtls_ssl_session_save(&cachedSession, rtcSession.data, sizeof(rtcSession.data), &length) != 0) {
+        // Sin copia en RTC la sesión sigue valiendo para reconexiones sin reinicio
+        rtcSession.magic = 0;
+        Serial.println("[TLS] ⚠ Sesión demasiado grande para RTC, solo se cachea en RAM");
+        return;
+    }
+    rtcSession.port = port;
+    rtcSession.length = (uint16_t)length;
+    memset(rtcSession.host, 0, sizeof(rtcSession.host));
+    strlcpy(rtcSession.host, host, sizeof(rtcSession.host));
+    rtcSession.magic = TLS_SESSION_MAGIC;
+    rtcSession.crc = session_crc(rtcSession);
+}
+
+static bool ensure_config() {
+    if (configReady) return true;
+
+    static const char caPem[] = MQTT_TLS_CA_CERT;
+    if (sizeof(caPem) <= 1 && !MQTT_TLS_INSECURE) {
+        static bool reported = false;
+        if (!reported) Serial.println("[TLS] ✗ Sin CA configurada (tls_ca_cert.h): no se conecta al broker");
+        reported = true;
+        return false;
+    }
+
+    mbedtls_ssl_config_init(&conf);
+    mbedtls_entropy_init(&entropy);
+    mbedtls_ctr_drbg_init(&drbg);
+    mbedtls_x509_crt_init(&caChain);
+    mbedtls_ssl_session_init(&cachedSession);
+
+    int ret = mbedtls_ctr_drbg_seed(&drbg, mbedtls_entropy_func, &entropy,
+                                    (const unsigned char*)MQTT_CLIENT_ID, strlen(MQTT_CLIENT_ID));
+    if (ret != 0) {
+        log_mbedtls_error("Semilla DRBG", ret);
+        return false;
+    }
+
+    ret = mbedtls_ssl_config_defaults(&conf, MBEDTLS_SSL_IS_CLIENT,
+                                      MBEDTLS_SSL_TRANSPORT_STREAM, MBEDTLS_SSL_PRESET_DEFAULT);
+    if (ret != 0) {
+        log_mbedtls_error("Configuración", ret);
+        return false;
+    }
+
+    if (sizeof(caPem) > 1) {
+        // mbedtls exige el terminador nulo dentro de la longitud en PEM
+        ret = mbedtls_x509_crt_parse(&caChain, (const unsigned char*)caPem, sizeof(caPem));
+        if (ret != 0) {
+            log_mbedtls_error("CA del broker", ret);
+            return false;
+        }
+        mbedtls_ssl_conf_ca_chain(&conf, &caChain, NULL);
+        mbedtls_ssl_conf_authmode(&conf, MBEDTLS_SSL_VERIFY_REQUIRED);
+    } else {
+        mbedtls_ssl_conf_authmode(&conf, MBEDTLS_SSL_VERIFY_NONE);
+        Serial.println("[TLS] ⚠ Sin CA y MQTT_TLS_INSECURE=1: no se verifica el broker");
+    }
+
+    mbedtls_ssl_conf_rng(&conf, mbedtls_ctr_drbg_random, &drbg);
+    mbedtls_ssl_conf_session_tickets(&conf, MBEDTLS_SSL_SESSION_TICKETS_ENABLED);
+
+    restore_rtc_session();
+    configReady = true;
+    return true;
+}
+
+// ============================
+// Client
+// ============================
+TlsSessionClient::TlsSessionClient()
+    : serverName(NULL), sslReady(false), established(false), peeked(-1), heapLow(0) {
+}
+
+void TlsSessionClient::track_heap() {
+    uint32_t freeNow = ESP.getFreeHeap();
+    if (freeNow < heapLow) heapLow = freeNow;
+}
+
+// El socket es no bloqueante desde el punto de vista de mbedTLS: sin datos se
+// devuelve WANT_READ y el bucle de handshake / lectura decide si espera
+int TlsSessionClient::bio_send(void* ctx, const unsigned char* buf, size_t len) {
+    TlsSessionClient* self = (TlsSessionClient*)ctx;
+    self->track_heap();
+    size_t written = self->tcp.write(buf, len);
+    if (written > 0) return (int)written;
+    return self->tcp.connected() ? MBEDTLS_ERR_SSL_WANT_WRITE : MBEDTLS_ERR_NET_SEND_FAILED;
+}
+
+int TlsSessionClient::bio_recv(void* ctx, unsigned char* buf, size_t len) {
+    TlsSessionClient* self = (TlsSessionClient*)ctx;
+    self->track_heap();
+    if (self->tcp.available() <= 0) {
+        return self->tcp.connected() ? MBEDTLS_ERR_SSL_WANT_READ : MBEDTLS_ERR_NET_RECV_FAILED;
+    }
+    int n = self->tcp.read(buf, len);
+    return n > 0 ? n : MBEDTLS_ERR_SSL_WANT_READ;
+}
+
+int TlsSessionClient::connect(IPAddress ip, uint16_t port) {
+    return connect(ip.toString().c_str(), port);
+}
+
+int TlsSessionClient::connect(const char* host, uint16_t port) {
+    stop();
+    if (!ensure_config()) return 0;
+
+    if (!tcp.connect(host, port)) {
+        stats.failures++;
+        return 0;
+    }
+
+    // El heap de referencia se toma antes de reservar los buffers de registro
+    uint32_t heapBefore = ESP.getFreeHeap();
+    heapLow = heapBefore;
+    int64_t startUs = esp_timer_get_time();
+
+    mbedtls_ssl_init(&ssl);
+    sslReady = true;
+
+    // mbedTLS 2.x compara este nombre con el CN y los SAN DNS, no con los SAN de IP
+    const char* expectedName = serverName != NULL ? serverName : host;
+    static bool warnedIpName = false;
+    IPAddress literal;
+    if (!warnedIpName && sizeof(MQTT_TLS_CA_CERT) > 1 && literal.fromString(expectedName)) {
+        serial_printf("[TLS] ⚠ Broker por IP (%s): el certificado debe llevarla como CN o SAN DNS "
+                      "(los SAN de IP no se comprueban); ver MQTT_TLS_SERVER_NAME\n", expectedName);
+        warnedIpName = true;
+    }
+
+    int ret = mbedtls_ssl_setup(&ssl, &conf);
+    if (ret == 0) ret = mbedtls_ssl_set_hostname(&ssl, expectedName);
+    if (ret != 0) {
+        log_mbedtls_error("Preparando sesión", ret);
+        stats.failures++;
+        teardown();
+        return 0;
+    }
+    mbedtls_ssl_set_bio(&ssl, this, bio_send, bio_recv, NULL);
+
+    bool offered = haveSession && cachedPort == port && strcmp(cachedHost, host) == 0 &&
+                   mbedtls_ssl_set_session(&ssl, &cachedSession) == 0;
+
+    while ((ret = mbedtls_ssl_handshake(&ssl)) != 0) {
+        if (ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) {
+            log_mbedtls_error("Handshake", ret);
+            break;
+        }
+        if (esp_timer_get_time() - startUs > (int64_t)MQTT_TLS_HANDSHAKE_TIMEOUT_MS * 1000) {
+            ret = MBEDTLS_ERR_SSL_TIMEOUT;
+            Serial.println("[TLS] ✗ Handshake: tiempo agotado");
+            break;
+        }
+        track_heap();
+        vTaskDelay(1);
+    }
+    track_heap();
+
+    if (ret != 0) {
+        stats.failures++;
+        // Una sesión rechazada no provoca fallo (el servidor hace handshake
+        // completo), pero si el error llega tras ofrecerla no se vuelve a usar
+        if (offered) forget_session();
+        teardown();
+        return 0;
+    }
+
+    // Reanudada = mismo secreto maestro que la sesión ofrecida. Vale tanto
+    // para ID de sesión como para tickets (el ID de un ticket es aleatorio)
+    bool resumed = offered && memcmp(ssl.session->master, cachedSession.master,
+                                     sizeof(cachedSession.master)) == 0;
+
+    stats.lastHandshakeMs = (uint32_t)((esp_timer_get_time() - startUs) / 1000);
+    stats.lastPeakHeapBytes = heapBefore - heapLow;
+    stats.lastResumed = resumed;
+    if (resumed) stats.resumedHandshakes++;
+    else stats.fullHandshakes++;
+
+    // También tras reanudar: el servidor puede haber renovado el ticket
+    store_session(ssl, host, port);
+    established = true;
+
+    serial_printf("[TLS] ✓ %s con %s:%u en %lu ms (pico de heap %lu bytes)\n",
+                  resumed ? "Sesión reanudada" : "Handshake completo", host, port,
+                  (unsigned long)stats.lastHandshakeMs, (unsigned long)stats.lastPeakHeapBytes);
+    return 1;
+}
+
+size_t TlsSessionClient::write(uint8_t b) {
+    return write(&b, 1);
+}
+
+size_t TlsSessionClient::write(const uint8_t* buf, size_t size) {
+    if (!established) return 0;
+
+    size_t sent = 0;
+    int64_t startUs = esp_timer_get_time();
+    while (sent < size) {
+        int ret = mbedtls_ssl_write(&ssl, buf + sent, size - sent);
+        if (ret > 0) {
+            sent += ret;
+            continue;
+        }
+        if ((ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) ||
+            esp_timer_get_time() - startUs > (int64_t)MQTT_SOCKET_TIMEOUT_S * 1000000) {
+            stop();
+            break;
+        }
+        vTaskDelay(1);
+    }
+    return sent;
+}
+
+int TlsSessionClient::available() {
+    if (!established) return 0;
+
+    int pending = peeked >= 0 ? 1 : 0;
+    // Lectura de 0 bytes: procesa los registros recibidos sin consumir datos
+    int ret = mbedtls_ssl_read(&ssl, NULL, 0);
+    if (ret < 0 && ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) {
+        stop();
+        return pending;
+    }
+    return (int)mbedtls_ssl_get_bytes_avail(&ssl) + pending;
+}
+
+int TlsSessionClient::read() {
+    uint8_t b;
+    return read(&b, 1) == 1 ? b : -1;
+}
+
+int TlsSessionClient::read(uint8_t* buf, size_t size) {
+    if (size == 0) return 0;
+
+    size_t offset = 0;
+    if (peeked >= 0) {
+        buf[0] = (uint8_t)peeked;
+        peeked = -1;
+        offset = 1;
+        if (size == 1) return 1;
+    }
+    if (!established) return offset > 0 ? (int)offset : -1;
+
+    int ret = mbedtls_ssl_read(&ssl, buf + offset, size - offset);
+    if (ret > 0) return ret + (int)offset;
+    if (ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) {
+        // 0 o PEER_CLOSE_NOTIFY: el broker cerró la sesión
+        stop();
+    }
+    return offset > 0 ? (int)offset : -1;
+}
+
+int TlsSessionClient::peek() {
+    if (peeked < 0) {
+        uint8_t b;
+        if (read(&b, 1) == 1) peeked = b;
+    }
+    return peeked;
+}
+
+void TlsSessionClient::flush() {
+}
+
+void TlsSessionClient::stop() {
+    if (established) {
+        mbedtls_ssl_close_notify(&ssl);
+        established = false;
+    }
+    teardown();
+    peeked = -1;
+}
+
+// Libera los buffers de registro (~2 x 16 KB) en cuanto se cierra la sesión
+void TlsSessionClient::teardown() {
+    if (sslReady) {
+        mbedtls_ssl_free(&ssl);
+        sslReady = false;
+    }
+    established = false;
+    tcp.stop();
+}
+
+uint8_t TlsSessionClient::connected() {
+    if (!established) return 0;
+    return (tcp.connected() || available() > 0) ? 1 : 0;
+}
+
+const TlsHandshakeStats& tls_transport_get_stats() {
+    return stats;
+}
+
+void tls_transport_fill_status(JsonDocument &doc) {
+    JsonObject tls = doc.createNestedObject("tls");
+    tls["handshake_ms"] = stats.lastHandshakeMs;
+    tls["peak_heap_bytes"] = stats.lastPeakHeapBytes;
+    tls["resumed"] = stats.lastResumed;
+    tls["full_handshakes"] = stats.fullHandshakes;
+    tls["resumed_handshakes"] = stats.resumedHandshakes;
+    tls["failures"] = stats.failures;
+    tls["session_cached"] = haveSession;
+    tls["session_from_rtc"] = stats.sessionFromRtc;
+}
+
+#endif // MQTT_USE_TLS
@@ -0,0 +1,11 @@
+// src/topics.cpp
+#include "topics.h"
+
+TopicId topic_lookup_inbound(const char* path) {
+    for (uint8_t i = 0; i < TOPIC_COUNT; i++) {
+        if (TOPICS[i].inbound && strcmp(TOPICS[i].path, path) == 0) {
+            return (TopicId)i;
+        }
+    }
+    return TOPIC_INVALID;
+}
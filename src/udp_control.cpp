@@ -0,0 +1,215 @@
+// src/udp_control.cpp
+#include "udp_control.h"
+#include "serial_log.h"
+#include "control_dispatcher.h"
+#include "light_controller.h"
+#include "task_plan.h"
+#include "topics.h"
+#include "config.h"
+#include <lwip/sockets.h>
+#include <mbedtls/md.h>
+#include <esp_system.h>
+
+#define UDP_CONTROL_DATAGRAM_MAX  (UDP_CONTROL_HEADER + UDP_CONTROL_TOPIC_MAX + CONTROL_PAYLOAD_MAX + UDP_CONTROL_MAC_SIZE)
+#define UDP_REPLAY_WINDOW         32   // Secuencias recordadas por debajo de la más alta (máscara de 32 bits)
+
+static int sock = -1;
+static uint32_t session = 0;
+
+// Ventana anti-repetición de la sesión (solo la toca la tarea UDP)
+static uint32_t highestSeq = 0;
+static uint32_t seenMask = 0;      // bit i = highestSeq - i ya recibida
+
+static portMUX_TYPE statsMux = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t requestCount = 0;
+static uint32_t rejectedCount = 0;
+static uint32_t ackMaxUs = 0;
+static uint64_t ackSumUs = 0;
+
+static inline uint32_t read_le32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline void write_le32(uint8_t* p, uint32_t value) {
+    p[0] = value;
+    p[1] = value >> 8;
+    p[2] = value >> 16;
+    p[3] = value >> 24;
+}
+
+static bool compute_mac(const uint8_t* data, size_t length, uint8_t* mac) {
+    const mbedtls_md_info_t* info = mbedtls_md_info_from_type(MBEDTLS_MD_SHA256);
+    return mbedtls_md_hmac(info, (const unsigned char*)UDP_CONTROL_KEY, sizeof(UDP_CONTROL_KEY) - 1,
+                           data, length, mac) == 0;
+}
+
+// Comparación en tiempo constante (no revela cuántos bytes coinciden)
+static bool mac_matches(const uint8_t* a, const uint8_t* b) {
+    uint8_t diff = 0;
+    for (uint8_t i = 0; i < UDP_CONTROL_MAC_SIZE; i++) diff |= a[i] ^ b[i];
+    return diff == 0;
+}
+
+// Acepta cada seq una sola vez, con margen para datagramas desordenados
+static bool accept_seq(uint32_t seq) {
+    if (seq == 0) return false;
+    if (seq > highestSeq) {
+        uint32_t shift = seq - highestSeq;
+        seenMask = shift >= UDP_REPLAY_WINDOW ? 0 : seenMask << shift;
+        seenMask |= 1;
+        highestSeq = seq;
+        return true;
+    }
+    uint32_t age = highestSeq - seq;
+    if (age >= UDP_REPLAY_WINDOW || (seenMask & (1UL << age))) return false;
+    seenMask |= 1UL << age;
+    return true;
+}
+
+static void send_ack(const sockaddr_in &to, UdpAckStatus status, uint32_t seq, bool pending) {
+    uint8_t ack[UDP_CONTROL_ACK_SIZE] = {0};
+    FanState fan = get_fan_state();
+
+    ack[0] = UDP_CONTROL_MAGIC;
+    ack[1] = UDP_CONTROL_VERSION;
+    ack[2] = status;
+    ack[3] = get_light_mask();
+    ack[4] = (fan.isOn ? 0x01 : 0) | (fan.autoMode ? 0x02 : 0);
+    ack[5] = pending ? 1 : 0;
+    write_le32(ack + 8, session);
+    write_le32(ack + 12, seq);
+    if (!compute_mac(ack, 16, ack + 16)) return;
+
+    sendto(sock, ack, sizeof(ack), 0, (const sockaddr*)&to, sizeof(to));
+}
+
+static void count_request(bool rejected, uint32_t elapsedUs) {
+    portENTER_CRITICAL(&statsMux);
+    requestCount++;
+    if (rejected) rejectedCount++;
+    ackSumUs += elapsedUs;
+    if (elapsedUs > ackMaxUs) ackMaxUs = elapsedUs;
+    portEXIT_CRITICAL(&statsMux);
+}
+
+// Valida, entrega a la tarea de control y confirma. Devuelve el estado enviado
+// (o UDP_ACK_BAD_FORMAT si el datagrama se ignora sin responder).
+static UdpAckStatus handle_datagram(const uint8_t* data, size_t length, uint32_t receivedUs, const sockaddr_in &from) {
+    if (length < UDP_CONTROL_HEADER + UDP_CONTROL_MAC_SIZE || data[0] != UDP_CONTROL_MAGIC) {
+        return UDP_ACK_BAD_FORMAT;
+    }
+
+    // Sin firma válida no hay respuesta (no se confirma a desconocidos que hay alguien escuchando)
+    size_t signedLength = length - UDP_CONTROL_MAC_SIZE;
+    uint8_t mac[UDP_CONTROL_MAC_SIZE];
+    if (!compute_mac(data, signedLength, mac) || !mac_matches(mac, data + signedLength)) {
+        return UDP_ACK_BAD_FORMAT;
+    }
+
+    uint8_t topicLength = data[2];
+    uint32_t requestSession = read_le32(data + 4);
+    uint32_t seq = read_le32(data + 8);
+
+    UdpAckStatus status;
+    if (data[1] != UDP_CONTROL_VERSION || topicLength > UDP_CONTROL_TOPIC_MAX ||
+        (size_t)UDP_CONTROL_HEADER + topicLength > signedLength) {
+        status = UDP_ACK_BAD_FORMAT;
+    } else if (requestSession != session) {
+        status = UDP_ACK_BAD_SESSION;
+    } else if (!accept_seq(seq)) {
+        status = UDP_ACK_REPLAY;
+    } else if (topicLength == 0) {
+        status = UDP_ACK_OK;       // Solo el estado
+    } else {
+        // Ruta completa, como la recibiría el callback MQTT
+        char path[sizeof(DEVICE_TOPIC_PREFIX) + 1 + UDP_CONTROL_TOPIC_MAX];
+        memcpy(path, DEVICE_TOPIC_PREFIX "/", sizeof(DEVICE_TOPIC_PREFIX));
+        memcpy(path + sizeof(DEVICE_TOPIC_PREFIX), data + UDP_CONTROL_HEADER, topicLength);
+        path[sizeof(DEVICE_TOPIC_PREFIX) + topicLength] = '\0';
+
+        TopicId topic = topic_lookup_inbound(path);
+        const uint8_t* payload = data + UDP_CONTROL_HEADER + topicLength;
+        unsigned int payloadLength = signedLength - UDP_CONTROL_HEADER - topicLength;
+        ControlTicket ticket;
+
+        if (topic == TOPIC_INVALID || !control_dispatcher_handles(topic)) {
+            status = UDP_ACK_BAD_TOPIC;
+        } else if (!control_dispatcher_submit(topic, payload, payloadLength, receivedUs, &ticket)) {
+            status = UDP_ACK_REJECTED;
+        } else {
+            bool pending = false;
+            bool done = control_dispatcher_wait_processed(ticket, UDP_CONTROL_ACK_WAIT_MS, &pending);
+            send_ack(from, done ? UDP_ACK_OK : UDP_ACK_QUEUED, seq, pending);
+            return done ? UDP_ACK_OK : UDP_ACK_QUEUED;
+        }
+    }
+
+    send_ack(from, status, seq, false);
+    return status;
+}
+
+static void udpControlTask(void *parameter) {
+    // Buffer estático: la tarea es la única lectora del socket
+    static uint8_t datagram[UDP_CONTROL_DATAGRAM_MAX];
+
+    while (true) {
+        sockaddr_in from;
+        socklen_t fromLength = sizeof(from);
+        int length = recvfrom(sock, datagram, sizeof(datagram), 0, (sockaddr*)&from, &fromLength);
+        if (length <= 0) {
+            vTaskDelay(pdMS_TO_TICKS(100));
+            continue;
+        }
+
+        uint32_t receivedUs = micros();
+        UdpAckStatus status = handle_datagram(datagram, length, receivedUs, from);
+        bool rejected = status != UDP_ACK_OK && status != UDP_ACK_QUEUED;
+        count_request(rejected, micros() - receivedUs);
+
+        if (rejected && status != UDP_ACK_BAD_SESSION) {
+            serial_printf("[UDP] ✗ Petición rechazada de %s (estado %u)\n", inet_ntoa(from.sin_addr), status);
+        }
+    }
+}
+
+void udp_control_start() {
+#if UDP_CONTROL_ENABLED
+    // Sesión nueva en cada arranque: lo capturado antes no sirve después de reiniciar
+    do {
+        session = esp_random();
+    } while (session == 0);
+
+    sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (sock < 0) {
+        Serial.println("[UDP] ✗ No se pudo crear el socket");
+        return;
+    }
+
+    sockaddr_in local = {};
+    local.sin_family = AF_INET;
+    local.sin_port = htons(UDP_CONTROL_PORT);
+    local.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (bind(sock, (const sockaddr*)&local, sizeof(local)) != 0) {
+        serial_printf("[UDP] ✗ No se pudo escuchar en el puerto %u\n", UDP_CONTROL_PORT);
+        close(sock);
+        sock = -1;
+        return;
+    }
+
+    if (task_plan_start(TASK_ROLE_UDP_CONTROL, udpControlTask, NULL, NULL)) {
+        serial_printf("[UDP] ✓ Control local en el puerto %u (sesión %08lX)\n",
+                      UDP_CONTROL_PORT, (unsigned long)session);
+    }
+#endif
+}
+
+UdpControlStats udp_control_get_stats() {
+    UdpControlStats stats;
+    portENTER_CRITICAL(&statsMux);
+    stats.requests = requestCount;
+    stats.rejected = rejectedCount;
+    stats.avgUs = requestCount > 0 ? (uint32_t)(ackSumUs / requestCount) : 0;
+    stats.maxUs = ackMaxUs;
+    portEXIT_CRITICAL(&statsMux);
+    return stats;
+}
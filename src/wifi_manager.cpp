@@ -1,43 +1,351 @@
 #include "wifi_manager.h"
+#include "serial_log.h"
 #include "config.h"
+#include "task_plan.h"
+#include <Preferences.h>
 
-void wifi_init() {
-    WiFi.mode(WIFI_STA);
-    WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
+// ============================
+// Caché de reasociación rápida (NVS)
+// ============================
+#define WIFI_CACHE_NAMESPACE   "wifi"
+#define WIFI_CACHE_KEY         "fast"
+#define WIFI_CACHE_MAGIC       0x57464331  // "WFC1"
+#define WIFI_MAX_CALLBACKS     4
+
+// Peticiones a la tarea de conexión (bits de notificación)
+#define WIFI_REQUEST_RECONNECT  0x01
+#define WIFI_REQUEST_DHCP       0x02
+
+struct WifiCache {
+    uint32_t magic;
+    uint8_t bssid[6];
+    uint8_t channel;
+    uint8_t hasIp;
+    uint32_t ip;
+    uint32_t gateway;
+    uint32_t subnet;
+    uint32_t dns;
+};
+
+static WifiCache cache = {};
+static bool cacheValid = false;
 
-    Serial.print("Conectando a WiFi");
+// Estado de conexión (modificado desde la tarea de eventos WiFi)
+static volatile bool connected = false;
+static volatile bool everConnected = false;
+static bool attemptFast = false;
+static volatile bool staticIpInUse = false;   // La conexión actual usa la IP cacheada
+static uint8_t fastFails = 0;
+static uint8_t pendingBssid[6] = {0};
+static uint8_t pendingChannel = 0;
+static uint8_t pendingSsid[32] = {0};
+static uint8_t pendingSsidLen = 0;
 
-    // Esperar conexión
-    int retries = 0;
-    while (WiFi.status() != WL_CONNECTED && retries < 20) {
-        delay(500);
-        Serial.print(".");
-        retries++;
+// Backoff de reconexión: el temporizador solo avisa a la tarea de conexión
+static TaskHandle_t connectTask = NULL;
+static TimerHandle_t reconnectTimer = NULL;
+static StaticTimer_t reconnectTimerBuffer;
+static uint32_t reconnectDelay = WIFI_RECONNECT_MIN_DELAY;
+
+// Medición de tiempos
+static unsigned long initStartedAt = 0;
+static unsigned long disconnectedAt = 0;
+static WifiConnectStats stats = {0, 0, 0, false};
+
+// Snapshot compartido entre la tarea de eventos WiFi y los lectores
+static portMUX_TYPE snapshotMux = portMUX_INITIALIZER_UNLOCKED;
+static WifiSnapshot snapshot = {false, "", "0.0.0.0", "", 0, 0};
+static int32_t rssiSmoothedX16 = 0;   // RSSI * 16 (media exponencial en punto fijo)
+static bool rssiSeeded = false;
+
+static wifi_state_callback_t callbacks[WIFI_MAX_CALLBACKS] = {NULL};
+static int callbackCount = 0;
+
+static void notify_state(bool isConnected) {
+    for (int i = 0; i < callbackCount; i++) {
+        callbacks[i](isConnected);
     }
+}
 
-    if (WiFi.status() == WL_CONNECTED) {
-        Serial.println("\n Conectado a WiFi");
+static void format_ip(char* out, size_t len, uint32_t addr) {
+    // lwIP guarda la IP en orden de red: el primer octeto es el byte bajo
+    snprintf(out, len, "%u.%u.%u.%u",
+             (unsigned)(addr & 0xFF), (unsigned)((addr >> 8) & 0xFF),
+             (unsigned)((addr >> 16) & 0xFF), (unsigned)((addr >> 24) & 0xFF));
+}
+
+static void snapshot_set_connected(const uint8_t* ssid, uint8_t ssidLen, uint32_t ip) {
+    char ipText[16];
+    format_ip(ipText, sizeof(ipText), ip);
+    if (ssidLen > 32) ssidLen = 32;
+
+    portENTER_CRITICAL(&snapshotMux);
+    snapshot.connected = true;
+    memcpy(snapshot.ssid, ssid, ssidLen);
+    snapshot.ssid[ssidLen] = '\0';
+    memcpy(snapshot.ip, ipText, sizeof(snapshot.ip));
+    snapshot.identityVersion++;
+    portEXIT_CRITICAL(&snapshotMux);
+
+    rssiSeeded = false;   // Nueva asociación: el RSSI anterior no sirve
+}
+
+static void snapshot_set_disconnected() {
+    portENTER_CRITICAL(&snapshotMux);
+    snapshot.connected = false;
+    snapshot.ssid[0] = '\0';
+    strcpy(snapshot.ip, "0.0.0.0");
+    snapshot.rssi = 0;
+    snapshot.identityVersion++;
+    portEXIT_CRITICAL(&snapshotMux);
+}
+
+static void load_cache() {
+    Preferences prefs;
+    if (!prefs.begin(WIFI_CACHE_NAMESPACE, true)) return;
+
+    if (prefs.getBytesLength(WIFI_CACHE_KEY) == sizeof(WifiCache)) {
+        prefs.getBytes(WIFI_CACHE_KEY, &cache, sizeof(WifiCache));
+        cacheValid = (cache.magic == WIFI_CACHE_MAGIC && cache.channel != 0);
+    }
+    prefs.end();
+
+    if (cacheValid) {
+        serial_printf("[WIFI] Caché NVS: BSSID %02X:%02X:%02X:%02X:%02X:%02X, canal %d\n",
+                      cache.bssid[0], cache.bssid[1], cache.bssid[2],
+                      cache.bssid[3], cache.bssid[4], cache.bssid[5], cache.channel);
+    }
+}
+
+// Solo escribe en flash si algo cambió respecto a lo guardado
+static void save_cache(const WifiCache& fresh) {
+    if (cacheValid && memcmp(&cache, &fresh, sizeof(WifiCache)) == 0) return;
+
+    Preferences prefs;
+    if (!prefs.begin(WIFI_CACHE_NAMESPACE, false)) return;
+    prefs.putBytes(WIFI_CACHE_KEY, &fresh, sizeof(WifiCache));
+    prefs.end();
+
+    cache = fresh;
+    cacheValid = true;
+    Serial.println("[WIFI] Caché de reasociación actualizada en NVS");
+}
+
+static void invalidate_cache() {
+    cacheValid = false;
+    Preferences prefs;
+    if (prefs.begin(WIFI_CACHE_NAMESPACE, false)) {
+        prefs.remove(WIFI_CACHE_KEY);
+        prefs.end();
+    }
+}
+
+static void begin_connection() {
+    attemptFast = cacheValid && fastFails < WIFI_FAST_CONNECT_MAX_FAILS;
+    staticIpInUse = false;
+
+#if WIFI_CACHE_IP_ENABLED
+    if (attemptFast && cache.hasIp) {
+        WiFi.config(IPAddress(cache.ip), IPAddress(cache.gateway),
+                    IPAddress(cache.subnet), IPAddress(cache.dns));
+        staticIpInUse = true;
+    } else {
+        // IP 0.0.0.0 reactiva DHCP
+        WiFi.config(IPAddress((uint32_t)0), IPAddress((uint32_t)0), IPAddress((uint32_t)0));
+    }
+#endif
+
+    if (attemptFast) {
+        // Canal y BSSID conocidos: el driver no necesita escanear
+        WiFi.begin(WIFI_SSID, WIFI_PASSWORD, cache.channel, cache.bssid);
     } else {
-        Serial.println("\n No se pudo conectar a WiFi");
+        WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
+    }
+}
+
+// Corre en la tarea de servicio de temporizadores: nada de llamadas al driver aquí
+static void reconnect_timer_callback(TimerHandle_t timer) {
+    if (connectTask != NULL) xTaskNotify(connectTask, WIFI_REQUEST_RECONNECT, eSetBits);
+}
+
+// Sin broker con la IP cacheada: puede que la IP ya no sea válida en la red.
+// Se olvida (BSSID y canal se conservan) y se reasocia pidiendo DHCP.
+static void drop_cached_ip() {
+    if (!staticIpInUse) return;
+    staticIpInUse = false;
+
+    if (cacheValid && cache.hasIp) {
+        WifiCache fresh = cache;
+        fresh.hasIp = 0;
+        save_cache(fresh);
+    }
+    Serial.println("[WIFI] ⚠ Broker inaccesible con la IP cacheada, reconectando por DHCP");
+    WiFi.disconnect();   // El evento de desconexión programa el reintento
+}
+
+static void wifiConnectTask(void *parameter) {
+    while (true) {
+        uint32_t requests = 0;
+        xTaskNotifyWait(0, UINT32_MAX, &requests, portMAX_DELAY);
+
+        if (requests & WIFI_REQUEST_DHCP) {
+            if (connected) drop_cached_ip();
+        } else if ((requests & WIFI_REQUEST_RECONNECT) && !connected) {
+            serial_printf("[WIFI] Reintentando conexión (%s)...\n",
+                          cacheValid && fastFails < WIFI_FAST_CONNECT_MAX_FAILS ? "rápida" : "escaneo");
+            begin_connection();
+        }
+    }
+}
+
+static void schedule_reconnect() {
+    if (reconnectTimer == NULL) return;
+
+    xTimerChangePeriod(reconnectTimer, pdMS_TO_TICKS(reconnectDelay), 0);
+
+    reconnectDelay *= 2;
+    if (reconnectDelay > WIFI_RECONNECT_MAX_DELAY) {
+        reconnectDelay = WIFI_RECONNECT_MAX_DELAY;
     }
 }
 
+static void wifi_event_handler(WiFiEvent_t event, WiFiEventInfo_t info) {
+    switch (event) {
+        case ARDUINO_EVENT_WIFI_STA_CONNECTED:
+            memcpy(pendingBssid, info.wifi_sta_connected.bssid, sizeof(pendingBssid));
+            pendingChannel = info.wifi_sta_connected.channel;
+            pendingSsidLen = info.wifi_sta_connected.ssid_len;
+            if (pendingSsidLen > sizeof(pendingSsid)) pendingSsidLen = sizeof(pendingSsid);
+            memcpy(pendingSsid, info.wifi_sta_connected.ssid, pendingSsidLen);
+            break;
+
+        case ARDUINO_EVENT_WIFI_STA_GOT_IP: {
+            unsigned long now = millis();
+            bool wasFast = attemptFast;
+
+            connected = true;
+            fastFails = 0;
+            reconnectDelay = WIFI_RECONNECT_MIN_DELAY;
+
+            stats.fastConnect = wasFast;
+            if (!everConnected) {
+                stats.coldBootMs = now - initStartedAt;
+                serial_printf("[WIFI] ✓ Conectado en %lu ms (arranque, %s)\n",
+                              (unsigned long)stats.coldBootMs, wasFast ? "rápida" : "escaneo");
+            } else {
+                stats.lastReassocMs = now - disconnectedAt;
+                stats.reconnectCount++;
+                serial_printf("[WIFI] ✓ Reasociado en %lu ms (%s)\n",
+                              (unsigned long)stats.lastReassocMs, wasFast ? "rápida" : "escaneo");
+            }
+            everConnected = true;
+
+            snapshot_set_connected(pendingSsid, pendingSsidLen, info.got_ip.ip_info.ip.addr);
+
+            WifiCache fresh = {};
+            fresh.magic = WIFI_CACHE_MAGIC;
+            memcpy(fresh.bssid, pendingBssid, sizeof(fresh.bssid));
+            fresh.channel = pendingChannel;
+            fresh.hasIp = 1;
+            fresh.ip = info.got_ip.ip_info.ip.addr;
+            fresh.gateway = info.got_ip.ip_info.gw.addr;
+            fresh.subnet = info.got_ip.ip_info.netmask.addr;
+            fresh.dns = (uint32_t)WiFi.dnsIP();
+            save_cache(fresh);
+
+            notify_state(true);
+            break;
+        }
+
+        case ARDUINO_EVENT_WIFI_STA_DISCONNECTED:
+            if (connected) {
+                connected = false;
+                disconnectedAt = millis();
+                snapshot_set_disconnected();
+                serial_printf("[WIFI] ✗ Conexión perdida (razón %d)\n",
+                              info.wifi_sta_disconnected.reason);
+                notify_state(false);
+            } else if (attemptFast) {
+                fastFails++;
+                if (fastFails >= WIFI_FAST_CONNECT_MAX_FAILS) {
+                    Serial.println("[WIFI] Datos cacheados no válidos, volviendo a escaneo completo");
+                    invalidate_cache();
+                }
+            }
+            schedule_reconnect();
+            break;
+
+        default:
+            break;
+    }
+}
+
+void wifi_init() {
+    initStartedAt = millis();
+
+    WiFi.persistent(false);        // Credenciales desde config.h, no reescribir flash
+    WiFi.setAutoReconnect(false);  // La reconexión la gestiona este módulo
+    WiFi.mode(WIFI_STA);
+    WiFi.onEvent(wifi_event_handler);
+
+    // La MAC no cambia: se lee una vez
+    uint8_t mac[6];
+    WiFi.macAddress(mac);
+    snprintf(snapshot.mac, sizeof(snapshot.mac), "%02X:%02X:%02X:%02X:%02X:%02X",
+             mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+
+    reconnectTimer = xTimerCreateStatic("WiFiReconnect", pdMS_TO_TICKS(WIFI_RECONNECT_MIN_DELAY),
+                                        pdFALSE, NULL, reconnect_timer_callback, &reconnectTimerBuffer);
+    task_plan_start(TASK_ROLE_WIFI_CONNECT, wifiConnectTask, NULL, &connectTask);
+
+    load_cache();
+
+    serial_printf("[WIFI] Conectando a %s (%s)...\n", WIFI_SSID, cacheValid ? "rápida" : "escaneo");
+    begin_connection();
+}
+
+void wifi_register_state_callback(wifi_state_callback_t callback) {
+    if (callback == NULL || callbackCount >= WIFI_MAX_CALLBACKS) return;
+    callbacks[callbackCount++] = callback;
+}
+
 bool wifi_is_connected() {
-    return WiFi.status() == WL_CONNECTED;
+    return connected;
 }
 
-std::string wifi_get_ssid() {
-    return WiFi.SSID().c_str();
+void wifi_report_broker_unreachable() {
+#if WIFI_CACHE_IP_ENABLED
+    if (connected && staticIpInUse && connectTask != NULL) {
+        xTaskNotify(connectTask, WIFI_REQUEST_DHCP, eSetBits);
+    }
+#endif
 }
 
-std::string wifi_get_ip() {
-    return WiFi.localIP().toString().c_str();
+WifiConnectStats wifi_get_connect_stats() {
+    return stats;
 }
 
-std::string wifi_get_mac() {
-    return WiFi.macAddress().c_str();
+WifiSnapshot wifi_get_snapshot() {
+    portENTER_CRITICAL(&snapshotMux);
+    WifiSnapshot copy = snapshot;
+    portEXIT_CRITICAL(&snapshotMux);
+    return copy;
 }
 
-int wifi_get_rssi() {
-    return WiFi.RSSI();
-}
\ No newline at end of file
+void wifi_sample_rssi() {
+    if (!connected) return;
+
+    int32_t sampleX16 = (int32_t)WiFi.RSSI() * 16;
+    if (!rssiSeeded) {
+        rssiSmoothedX16 = sampleX16;
+        rssiSeeded = true;
+    } else {
+        // alfa = 1/WIFI_RSSI_SMOOTHING
+        rssiSmoothedX16 += (sampleX16 - rssiSmoothedX16) / WIFI_RSSI_SMOOTHING;
+    }
+
+    int smoothed = (rssiSmoothedX16 - 8) / 16;   // Redondeo (RSSI siempre negativo)
+    portENTER_CRITICAL(&snapshotMux);
+    snapshot.rssi = smoothed;
+    portEXIT_CRITICAL(&snapshotMux);
+}
@@ -0,0 +1,32 @@
+// test/host/bench_baseline_host.h
+// Generado con `make -C test/host baseline` (bench_hot_paths --record): no editar a mano.
+#ifndef BENCH_BASELINE_HOST_H
+#define BENCH_BASELINE_HOST_H
+
+// ============================
+// Referencias de bench_hot_paths (ns por llamada, mediana)
+// ============================
+// Se tomaron en una máquina concreta: en otra, volver a tomarlas antes de
+// comparar un cambio. Los casos JSON solo se comparan con la misma biblioteca.
+
+#define HOST_BENCH_TOLERANCE_PCT  50
+#define HOST_BENCH_TOLERANCE_NS   5     // Holgura mínima (casos de pocos ns)
+#define HOST_BASELINE_JSON        "none"
+
+#define HOST_BASELINE_GENERATE_WIFI_JSON       2.3
+#define HOST_BASELINE_GENERATE_MEMORY_JSON     46.4
+#define HOST_BASELINE_LIGHT_ON                 204.0
+#define HOST_BASELINE_LIGHT_OFF                217.9
+#define HOST_BASELINE_LIGHT_TOGGLE             182.4
+#define HOST_BASELINE_LIGHTS_ALL_ON            189.2
+#define HOST_BASELINE_LIGHTS_ALL_OFF           185.8
+#define HOST_BASELINE_SCENARIO                 223.7
+#define HOST_BASELINE_FAN_ON                   169.2
+#define HOST_BASELINE_FAN_OFF                  167.9
+#define HOST_BASELINE_PUBLISH_ALL_LIGHTS       71.2
+#define HOST_BASELINE_ADC_TO_MILLICELSIUS      195.8
+#define HOST_BASELINE_ADC_TO_LUX               243.6
+#define HOST_BASELINE_TEMPERATURE_AUTOMATION   46.6
+#define HOST_BASELINE_LDR_AUTOMATION           2.8
+
+#endif // BENCH_BASELINE_HOST_H
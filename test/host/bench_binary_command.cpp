@@ -0,0 +1,85 @@
+// test/host/bench_binary_command.cpp
+// Coste de interpretar un comando: trama binaria de 8 bytes frente al JSON
+// equivalente, tal como lo hacen binary_command_parse() y handle_light_message()
+// (StaticJsonDocument<256> + parse_light_command). En ambos casos se copia
+// antes el payload, como hace la tarea de control con cada mensaje.
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "binary_command.h"
+#include "light_controller.h"
+#include "host_bench.h"
+
+#define BATCH  20000
+
+struct ParseCase {
+    const char* name;
+    const char* json;
+    BinaryCommand binary;
+};
+
+static const ParseCase CASES[] = {
+    { "zone_on",     "{\"command\":\"ON\"}",     { BIN_OP_ZONES_ON,     0x01, BIN_FAN_UNCHANGED, 1 } },
+    { "zone_off",    "{\"command\":\"off\"}",    { BIN_OP_ZONES_OFF,    0x02, BIN_FAN_UNCHANGED, 2 } },
+    { "zone_toggle", "{\"command\":\"TOGGLE\"}", { BIN_OP_ZONES_TOGGLE, 0x04, BIN_FAN_UNCHANGED, 3 } },
+    { "set_mask_fan", "{\"command\":\"ON\",\"source\":\"dashboard\",\"fan\":\"ON\"}",
+                                                 { BIN_OP_SET_MASK,     0x0F, BIN_FAN_ON,        4 } },
+};
+
+static volatile uint32_t sink = 0;
+
+int main() {
+    uint8_t scratch[64];
+    double totalBinary = 0;
+    double totalJson = 0;
+    int failures = 0;
+
+    for (size_t c = 0; c < sizeof(CASES) / sizeof(CASES[0]); c++) {
+        const ParseCase &test = CASES[c];
+        uint8_t frame[BINARY_COMMAND_SIZE];
+        binary_command_encode(test.binary, frame);
+        size_t jsonLength = strlen(test.json);
+
+        // Comprobación previa: los dos formatos dicen lo mismo
+        BinaryCommand decoded;
+        if (binary_command_parse(frame, sizeof(frame), decoded) != BIN_PARSE_OK ||
+            decoded.opcode != test.binary.opcode || decoded.zoneMask != test.binary.zoneMask ||
+            decoded.seq != test.binary.seq) {
+            printf("{\"case\":\"%s\",\"error\":\"binary_roundtrip\"}\n", test.name);
+            failures++;
+            continue;
+        }
+
+        double binaryNs = host_median_ns([&]() {
+            memcpy(scratch, frame, sizeof(frame));
+            BinaryCommand command;
+            if (binary_command_parse(scratch, sizeof(frame), command) == BIN_PARSE_OK) sink += command.zoneMask;
+        }, BATCH);
+
+        double jsonNs = host_median_ns([&]() {
+            memcpy(scratch, test.json, jsonLength);
+            StaticJsonDocument<256> doc;
+            if (!deserializeJson(doc, scratch, jsonLength)) sink += parse_light_command(doc["command"] | "");
+        }, BATCH);
+
+        totalBinary += binaryNs;
+        totalJson += jsonNs;
+        printf("{\"case\":\"%s\",\"binary_ns\":%.1f,\"json_ns\":%.1f,\"json_bytes\":%u,\"binary_bytes\":%u}\n",
+               test.name, binaryNs, jsonNs, (unsigned)jsonLength, (unsigned)BINARY_COMMAND_SIZE);
+    }
+
+    // Tramas inválidas: se rechazan sin leer fuera del buffer
+    uint8_t bad[BINARY_COMMAND_SIZE] = { BINARY_COMMAND_MAGIC, 0x7F, 0, BIN_FAN_UNCHANGED, 0, 0, 0, 0 };
+    BinaryCommand ignored;
+    if (binary_command_parse(bad, sizeof(bad), ignored) != BIN_PARSE_BAD_OPCODE ||
+        binary_command_parse(bad, sizeof(bad) - 1, ignored) != BIN_PARSE_BAD_LENGTH ||
+        binary_command_parse(NULL, sizeof(bad), ignored) != BIN_PARSE_BAD_LENGTH) {
+        printf("{\"case\":\"invalid_frames\",\"error\":\"not_rejected\"}\n");
+        failures++;
+    }
+
+    size_t count = sizeof(CASES) / sizeof(CASES[0]);
+    printf("{\"bench\":\"binary_vs_json\",\"binary_ns\":%.1f,\"json_ns\":%.1f,\"ratio\":%.1f,\"result\":\"%s\"}\n",
+           totalBinary / count, totalJson / count, totalBinary > 0 ? totalJson / totalBinary : 0.0,
+           failures == 0 ? "pass" : "fail");
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,268 @@
+// test/host/bench_hot_paths.cpp
+// Los casos del micro-benchmark (src/micro_benchmark.cpp) medidos en el PC:
+// JSON de WiFi y memoria, handle_light_message por tipo de comando (las
+// escenas se ejecutan enteras con el reloj simulado), la publicación de todas
+// las luces, la conversión de sensores (lotes de MICRO_BENCH_BATCH) y las
+// comprobaciones de automatización en la banda intermedia.
+//
+// Cada caso se mide con y sin su preparación y se resta: ns de lo medido.
+// La mediana se compara con bench_baseline_host.h; por encima de
+// HOST_BENCH_TOLERANCE_PCT (y de HOST_BENCH_TOLERANCE_NS) el caso falla.
+// Las referencias de los casos que pasan por ArduinoJson solo valen con la
+// misma biblioteca con la que se tomaron (HOST_BASELINE_JSON): con otra, el
+// caso falla hasta volver a tomarlas.
+//
+//   bench_hot_paths            mide y compara
+//   bench_hot_paths --record   mide y escribe bench_baseline_host.h por stdout
+//                              (make baseline)
+//
+// Además falla si un caso deja de medir lo que dice: la conversión se sale de
+// rango o la automatización actúa donde no debe.
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "json_formatter.h"
+#include "light_controller.h"
+#include "sensor_calibration.h"
+#include "config.h"
+#include "host_stubs.h"
+#include "host_bench.h"
+#include "bench_baseline_host.h"
+
+#define BATCH  2000
+
+#ifdef ARDUINOJSON_VERSION
+#define JSON_LIBRARY  "ArduinoJson " ARDUINOJSON_VERSION
+#else
+#define JSON_LIBRARY  "none"
+#endif
+
+struct HostCase {
+    const char* name;
+    const char* macro;       // Nombre de su referencia en bench_baseline_host.h
+    double baseline;         // ns (mediana)
+    bool json;               // Pasa por ArduinoJson
+    void (*prepare)();       // Puede ser NULL
+    void (*run)();
+};
+
+static volatile int32_t sink = 0;
+static StaticJsonDocument<384> wifiDoc;
+static StaticJsonDocument<512> memoryDoc;
+static const WifiSnapshot WIFI = { true, "auditorio", "192.168.1.40", "24:6F:28:AA:BB:CC", -61, 3 };
+static uint8_t payload[64];
+static unsigned int payloadLength = 0;
+
+// deserializeJson modifica el buffer: cada llamada parte de una copia nueva
+static void set_payload(const char* json) {
+    payloadLength = strlen(json);
+    memcpy(payload, json, payloadLength);
+}
+
+// Una escena arrancada se ejecuta entera, como en la tarea de control
+static void finish_scene() {
+    uint32_t wait;
+    while ((wait = scene_run_due()) != SCENE_IDLE) host_advance_ms(wait);
+}
+
+// ---- JSON ----
+static void prepare_wifi_json()   { wifiDoc.clear(); }
+static void run_wifi_json()       { generate_wifi_json(WIFI, wifiDoc); }
+static void prepare_memory_json() { memoryDoc.clear(); }
+static void run_memory_json()     { generate_memory_json(memoryDoc); }
+
+// ---- handle_light_message por tipo de comando ----
+static void prepare_light_on() {
+    turn_off_light(1);
+    set_payload("{\"command\":\"ON\"}");
+}
+static void prepare_light_off() {
+    turn_on_light(1);
+    set_payload("{\"command\":\"OFF\"}");
+}
+static void prepare_light_toggle() { set_payload("{\"command\":\"TOGGLE\"}"); }
+static void run_light() { handle_light_message(TOPIC_LIGHT_1_SET, payload, payloadLength); }
+
+static void prepare_all_on() {
+    apply_light_mask(0x00);
+    set_payload("{\"command\":\"ON\"}");
+}
+static void prepare_all_off() {
+    apply_light_mask(0x0F);
+    set_payload("{\"command\":\"OFF\"}");
+}
+static void run_all() {
+    handle_light_message(TOPIC_LIGHT_ALL_SET, payload, payloadLength);
+    finish_scene();
+}
+
+static void prepare_scenario() {
+    apply_light_mask(0x0F);
+    set_payload("{\"scenario\":\"stage_only\"}");
+}
+static void run_scenario_message() {
+    handle_light_message(TOPIC_SCENARIO_SET, payload, payloadLength);
+    finish_scene();
+}
+
+static void prepare_fan_on() {
+    turn_off_fan();
+    set_payload("{\"command\":\"ON\"}");
+}
+static void prepare_fan_off() {
+    turn_on_fan();
+    set_payload("{\"command\":\"OFF\"}");
+}
+static void run_fan() { handle_light_message(TOPIC_FAN_SET, payload, payloadLength); }
+
+// ---- Publicación ----
+static void run_publish_all_lights() { publish_all_lights_status(); }
+
+// ---- Conversión de sensores ----
+static void run_adc_temperature() {
+    int32_t acc = 0;
+    for (uint16_t i = 0; i < MICRO_BENCH_BATCH; i++) acc += adc_to_millicelsius(i * (ADC_MAX_VALUE / MICRO_BENCH_BATCH));
+    sink = acc;
+}
+static void run_adc_lux() {
+    int32_t acc = 0;
+    for (uint16_t i = 0; i < MICRO_BENCH_BATCH; i++) acc += adc_to_lux(i * (ADC_MAX_VALUE / MICRO_BENCH_BATCH));
+    sink = acc;
+}
+
+// ---- Automatización (banda intermedia) ----
+static void run_temperature_automation() { check_temperature_automation(17500); }
+static void run_ldr_automation() { check_ldr_automation(ADC_MAX_VALUE / 2); }
+
+#define CASE(name, macro, json, prepare, run)  { name, #macro, macro, json, prepare, run }
+
+static const HostCase CASES[] = {
+    CASE("generate_wifi_json",     HOST_BASELINE_GENERATE_WIFI_JSON,     true,  prepare_wifi_json,    run_wifi_json),
+    CASE("generate_memory_json",   HOST_BASELINE_GENERATE_MEMORY_JSON,   true,  prepare_memory_json,  run_memory_json),
+    CASE("light_on",               HOST_BASELINE_LIGHT_ON,               true,  prepare_light_on,     run_light),
+    CASE("light_off",              HOST_BASELINE_LIGHT_OFF,              true,  prepare_light_off,    run_light),
+    CASE("light_toggle",           HOST_BASELINE_LIGHT_TOGGLE,           true,  prepare_light_toggle, run_light),
+    CASE("lights_all_on",          HOST_BASELINE_LIGHTS_ALL_ON,          true,  prepare_all_on,       run_all),
+    CASE("lights_all_off",         HOST_BASELINE_LIGHTS_ALL_OFF,         true,  prepare_all_off,      run_all),
+    CASE("scenario",               HOST_BASELINE_SCENARIO,               true,  prepare_scenario,     run_scenario_message),
+    CASE("fan_on",                 HOST_BASELINE_FAN_ON,                 true,  prepare_fan_on,       run_fan),
+    CASE("fan_off",                HOST_BASELINE_FAN_OFF,                true,  prepare_fan_off,      run_fan),
+    CASE("publish_all_lights",     HOST_BASELINE_PUBLISH_ALL_LIGHTS,     true,  NULL,                 run_publish_all_lights),
+    CASE("adc_to_millicelsius",    HOST_BASELINE_ADC_TO_MILLICELSIUS,    false, NULL,                 run_adc_temperature),
+    CASE("adc_to_lux",             HOST_BASELINE_ADC_TO_LUX,             false, NULL,                 run_adc_lux),
+    CASE("temperature_automation", HOST_BASELINE_TEMPERATURE_AUTOMATION, false, NULL,                 run_temperature_automation),
+    CASE("ldr_automation",         HOST_BASELINE_LDR_AUTOMATION,         false, NULL,                 run_ldr_automation),
+};
+
+#define CASE_COUNT  (sizeof(CASES) / sizeof(CASES[0]))
+
+// ns de run(): (preparación + caso) - preparación sola
+static double measure(const HostCase &test) {
+    const HostCase* c = &test;
+    double total = host_median_ns([c]() {
+        if (c->prepare != NULL) c->prepare();
+        c->run();
+    }, BATCH);
+    if (c->prepare == NULL) return total;
+    double prepareOnly = host_median_ns([c]() { c->prepare(); }, BATCH);
+    return total > prepareOnly ? total - prepareOnly : 0;
+}
+
+static const char* classify(const HostCase &test, double ns) {
+    if (test.baseline <= 0) return "missing_baseline";
+    if (test.json && strcmp(JSON_LIBRARY, HOST_BASELINE_JSON) != 0) return "other_json";
+    double limit = test.baseline * (100 + HOST_BENCH_TOLERANCE_PCT) / 100;
+    if (limit < test.baseline + HOST_BENCH_TOLERANCE_NS) limit = test.baseline + HOST_BENCH_TOLERANCE_NS;
+    return ns > limit ? "regression" : "pass";
+}
+
+static void record(const double* results) {
+    printf("// test/host/bench_baseline_host.h\n"
+           "// Generado con `make -C test/host baseline` (bench_hot_paths --record): no editar a mano.\n"
+           "#ifndef BENCH_BASELINE_HOST_H\n"
+           "#define BENCH_BASELINE_HOST_H\n\n"
+           "// ============================\n"
+           "// Referencias de bench_hot_paths (ns por llamada, mediana)\n"
+           "// ============================\n"
+           "// Se tomaron en una máquina concreta: en otra, volver a tomarlas antes de\n"
+           "// comparar un cambio. Los casos JSON solo se comparan con la misma biblioteca.\n\n"
+           "#define HOST_BENCH_TOLERANCE_PCT  %d\n"
+           "#define HOST_BENCH_TOLERANCE_NS   %d     // Holgura mínima (casos de pocos ns)\n"
+           "#define HOST_BASELINE_JSON        \"%s\"\n\n",
+           HOST_BENCH_TOLERANCE_PCT, HOST_BENCH_TOLERANCE_NS, JSON_LIBRARY);
+    for (size_t i = 0; i < CASE_COUNT; i++) {
+        printf("#define %-38s %.1f\n", CASES[i].macro, results[i]);
+    }
+    printf("\n#endif // BENCH_BASELINE_HOST_H\n");
+}
+
+// La tabla recorre todo el rango: temperatura creciente, lux decreciente
+static bool conversions_in_range() {
+    int32_t lastTemp = adc_to_millicelsius(0);
+    int32_t lastLux = adc_to_lux(0);
+    for (uint32_t raw = 1; raw <= ADC_MAX_VALUE; raw++) {
+        int32_t temp = adc_to_millicelsius(raw);
+        int32_t lux = adc_to_lux(raw);
+        if (temp < lastTemp || lux > lastLux || lux < 0 || lux > LDR_LUX_MAX) return false;
+        lastTemp = temp;
+        lastLux = lux;
+    }
+    return lastTemp > 0;
+}
+
+// En la banda intermedia la automatización comprueba sin actuar
+static bool automation_idle() {
+    HostCounters before = hostCounters;
+    run_temperature_automation();
+    run_ldr_automation();
+    return hostCounters.relayWrites == before.relayWrites && hostCounters.sceneRequests == before.sceneRequests &&
+           hostCounters.fanRequests == before.fanRequests && hostCounters.publishes == before.publishes;
+}
+
+int main(int argc, char** argv) {
+    bool recording = argc > 1 && strcmp(argv[1], "--record") == 0;
+    int failures = 0;
+
+    light_controller_setup();
+    sensor_calibration_init();
+    host_advance_ms(60000);   // Fuera de la ventana de control manual del ventilador
+
+    if (!conversions_in_range()) {
+        fprintf(stderr, "{\"case\":\"adc_conversion\",\"error\":\"fuera de rango o no monótona\"}\n");
+        failures++;
+    }
+    if (!automation_idle()) {
+        fprintf(stderr, "{\"case\":\"automation\",\"error\":\"actuó en la banda intermedia\"}\n");
+        failures++;
+    }
+
+    double results[CASE_COUNT];
+    uint16_t regressions = 0;
+    uint16_t unreferenced = 0;
+    for (size_t i = 0; i < CASE_COUNT; i++) {
+        results[i] = measure(CASES[i]);
+        if (recording) continue;
+
+        const char* status = classify(CASES[i], results[i]);
+        if (strcmp(status, "regression") == 0) regressions++;
+        if (strcmp(status, "missing_baseline") == 0 || strcmp(status, "other_json") == 0) unreferenced++;
+        printf("{\"case\":\"%s\",\"ns\":%.1f,\"baseline\":%.1f,\"status\":\"%s\"}\n",
+               CASES[i].name, results[i], CASES[i].baseline, status);
+    }
+
+    if (recording) {
+        if (failures > 0) return 1;   // No se toman referencias de casos que no miden lo que dicen
+        record(results);
+        return 0;
+    }
+
+    bool pass = failures == 0 && regressions == 0 && unreferenced == 0;
+    printf("{\"bench\":\"hot_paths\",\"cases\":%u,\"regressions\":%u,\"unreferenced\":%u,\"failures\":%d,"
+           "\"tolerance_pct\":%d,\"json\":\"%s\",\"result\":\"%s\"}\n",
+           (unsigned)CASE_COUNT, regressions, unreferenced, failures, HOST_BENCH_TOLERANCE_PCT, JSON_LIBRARY,
+           pass ? "pass" : "fail");
+    if (unreferenced > 0) {
+        fprintf(stderr, "bench_hot_paths: %u casos sin referencia válida (biblioteca JSON %s, referencias con %s): "
+                        "make -C test/host baseline\n", unreferenced, JSON_LIBRARY, HOST_BASELINE_JSON);
+    }
+    return pass ? 0 : 1;
+}
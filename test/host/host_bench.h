@@ -0,0 +1,38 @@
+// test/host/host_bench.h
+#ifndef HOST_BENCH_H
+#define HOST_BENCH_H
+
+#include <stdint.h>
+#include <time.h>
+#include <algorithm>
+
+// ============================
+// Medida de tiempo en el PC
+// ============================
+// Un caso se mide HOST_BENCH_SAMPLES veces; cada muestra ejecuta el caso
+// `batch` veces seguidas y se divide (una sola llamada dura menos que la
+// resolución del reloj). Se informa la mediana en ns por llamada.
+
+#define HOST_BENCH_SAMPLES  31
+
+static inline uint64_t host_now_ns() {
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+template <typename Fn>
+static double host_median_ns(Fn fn, uint32_t batch) {
+    uint64_t samples[HOST_BENCH_SAMPLES];
+    for (uint32_t i = 0; i < batch; i++) fn();   // Calentamiento (cachés, predictor)
+
+    for (uint32_t s = 0; s < HOST_BENCH_SAMPLES; s++) {
+        uint64_t start = host_now_ns();
+        for (uint32_t i = 0; i < batch; i++) fn();
+        samples[s] = host_now_ns() - start;
+    }
+    std::sort(samples, samples + HOST_BENCH_SAMPLES);
+    return (double)samples[HOST_BENCH_SAMPLES / 2] / batch;
+}
+
+#endif // HOST_BENCH_H
@@ -0,0 +1,176 @@
+// test/host/host_rtos.cpp
+// FreeRTOS sobre hilos POSIX para los programas compilados con HOST_RTOS = 1
+// (ver stubs/freertos_host.h) y task_plan_start, que crea un hilo por tarea.
+#include <Arduino.h>
+#include <errno.h>
+#include <time.h>
+#include "task_plan.h"
+
+struct HostTask {
+    pthread_mutex_t lock;
+    pthread_cond_t notified;
+    uint32_t notifyValue;
+    TaskFunction_t function;
+    void* parameter;
+};
+
+// Cada hilo tiene su tarea; los que no creó task_plan_start la reciben al usarla
+static __thread HostTask* currentTask = NULL;
+
+static HostTask* task_new(TaskFunction_t function, void* parameter) {
+    HostTask* task = new HostTask;
+    pthread_mutex_init(&task->lock, NULL);
+    pthread_cond_init(&task->notified, NULL);
+    task->notifyValue = 0;
+    task->function = function;
+    task->parameter = parameter;
+    return task;
+}
+
+// Instante absoluto (CLOCK_REALTIME, el de pthread_cond_timedwait) dentro de ticks ms
+static timespec deadline_in(TickType_t ticks) {
+    timespec at;
+    clock_gettime(CLOCK_REALTIME, &at);
+    at.tv_sec += ticks / 1000;
+    at.tv_nsec += (long)(ticks % 1000) * 1000000L;
+    if (at.tv_nsec >= 1000000000L) {
+        at.tv_sec++;
+        at.tv_nsec -= 1000000000L;
+    }
+    return at;
+}
+
+// Espera en cond (con lock tomado) hasta que ready() o venza ticks. false = venció.
+template <typename Ready>
+static bool wait_until(pthread_cond_t* cond, pthread_mutex_t* lock, TickType_t ticks, Ready ready) {
+    if (ticks == portMAX_DELAY) {
+        while (!ready()) pthread_cond_wait(cond, lock);
+        return true;
+    }
+    timespec at = deadline_in(ticks);
+    while (!ready()) {
+        if (pthread_cond_timedwait(cond, lock, &at) == ETIMEDOUT) return ready();
+    }
+    return true;
+}
+
+// ---- Tareas ----
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+    if (currentTask == NULL) currentTask = task_new(NULL, NULL);
+    return currentTask;
+}
+
+TickType_t xTaskGetTickCount() {
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (TickType_t)(now.tv_sec * 1000 + now.tv_nsec / 1000000);
+}
+
+void vTaskDelay(TickType_t ticks) {
+    timespec pause = { (time_t)(ticks / 1000), (long)(ticks % 1000) * 1000000L };
+    nanosleep(&pause, NULL);
+}
+
+void xTaskNotifyGive(TaskHandle_t handle) {
+    HostTask* task = (HostTask*)handle;
+    if (task == NULL) return;
+    pthread_mutex_lock(&task->lock);
+    task->notifyValue++;
+    pthread_cond_signal(&task->notified);
+    pthread_mutex_unlock(&task->lock);
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticks) {
+    HostTask* task = (HostTask*)xTaskGetCurrentTaskHandle();
+    pthread_mutex_lock(&task->lock);
+    wait_until(&task->notified, &task->lock, ticks, [task]() { return task->notifyValue > 0; });
+    uint32_t value = task->notifyValue;
+    if (value > 0) task->notifyValue = clearOnExit ? 0 : value - 1;
+    pthread_mutex_unlock(&task->lock);
+    return value;
+}
+
+static void* task_entry(void* argument) {
+    currentTask = (HostTask*)argument;
+    currentTask->function(currentTask->parameter);
+    return NULL;
+}
+
+bool task_plan_start(TaskRole role, TaskFunction_t function, void* parameter, TaskHandle_t* handle) {
+    HostTask* task = task_new(function, parameter);
+    if (handle != NULL) *handle = task;   // Antes de arrancar: la tarea puede usarlo enseguida
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, task_entry, task) != 0) {
+        if (handle != NULL) *handle = NULL;
+        return false;
+    }
+    pthread_detach(thread);
+    return true;
+}
+
+// ---- Colas ----
+QueueHandle_t xQueueCreateStatic(UBaseType_t length, UBaseType_t itemSize, uint8_t* storage, StaticQueue_t* buffer) {
+    pthread_mutex_init(&buffer->lock, NULL);
+    pthread_cond_init(&buffer->changed, NULL);
+    buffer->storage = storage;
+    buffer->itemSize = itemSize;
+    buffer->length = length;
+    buffer->head = 0;
+    buffer->count = 0;
+    return buffer;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t ticks) {
+    pthread_mutex_lock(&queue->lock);
+    bool room = wait_until(&queue->changed, &queue->lock, ticks, [queue]() { return queue->count < queue->length; });
+    if (room) {
+        UBaseType_t tail = (queue->head + queue->count) % queue->length;
+        memcpy(queue->storage + tail * queue->itemSize, item, queue->itemSize);
+        queue->count++;
+        pthread_cond_broadcast(&queue->changed);
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return room ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void* item, TickType_t ticks) {
+    pthread_mutex_lock(&queue->lock);
+    bool ready = wait_until(&queue->changed, &queue->lock, ticks, [queue]() { return queue->count > 0; });
+    if (ready) {
+        memcpy(item, queue->storage + queue->head * queue->itemSize, queue->itemSize);
+        queue->head = (queue->head + 1) % queue->length;
+        queue->count--;
+        pthread_cond_broadcast(&queue->changed);
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return ready ? pdTRUE : pdFALSE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+    pthread_mutex_lock(&queue->lock);
+    UBaseType_t count = queue->count;
+    pthread_mutex_unlock(&queue->lock);
+    return count;
+}
+
+// ---- Mutex ----
+SemaphoreHandle_t xSemaphoreCreateMutexStatic(StaticSemaphore_t* buffer) {
+    pthread_mutex_init(buffer, NULL);
+    return buffer;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t mutex, TickType_t ticks) {
+    if (ticks == portMAX_DELAY) return pthread_mutex_lock(mutex) == 0 ? pdTRUE : pdFALSE;
+
+    TickType_t start = xTaskGetTickCount();
+    while (pthread_mutex_trylock(mutex) != 0) {
+        if (xTaskGetTickCount() - start >= ticks) return pdFALSE;
+        vTaskDelay(1);
+    }
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t mutex) {
+    return pthread_mutex_unlock(mutex) == 0 ? pdTRUE : pdFALSE;
+}
@@ -0,0 +1,120 @@
+// test/host/host_stubs.cpp
+// Sustitutos en el PC de lo que los módulos probados llaman fuera de sí mismos:
+// reloj, GPIO, MQTT, NVS y el resto de tareas del firmware.
+#include <Arduino.h>
+#include <SPIFFS.h>
+#include <time.h>
+#include "mqtt_client.h"
+#include "relay_state_store.h"
+#include "control_dispatcher.h"
+#include "device_state.h"
+#include "relay_usage.h"
+#include "audit_log.h"
+#include "wifi_manager.h"
+#include "host_stubs.h"
+
+bool host_serial_echo = false;
+HostSerial Serial;
+EspClass ESP;
+HostSpiffs SPIFFS;
+
+HostCounters hostCounters = {};
+LightCommand hostRequestedFan = LIGHT_CMD_NONE;
+
+// ---- Reloj ----
+static unsigned long simulatedMs = 0;
+
+static uint64_t monotonic_us() {
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000ULL + now.tv_nsec / 1000;
+}
+
+unsigned long micros() {
+    return (unsigned long)(monotonic_us() + (uint64_t)simulatedMs * 1000);
+}
+
+unsigned long millis() {
+    return (unsigned long)(monotonic_us() / 1000 + simulatedMs);
+}
+
+void delay(unsigned long ms) {
+    host_advance_ms(ms);
+}
+
+void host_advance_ms(unsigned long ms) {
+    simulatedMs += ms;
+}
+
+// ---- GPIO ----
+void pinMode(uint8_t pin, uint8_t mode) {
+}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+    hostCounters.relayWrites++;
+}
+
+// ---- MQTT: serializa como el firmware, sin red ----
+static uint8_t publishBuffer[MQTT_OUTBOUND_PAYLOAD_MAX];
+
+bool mqtt_publish(TopicId id, const char* payload) {
+    return mqtt_publish(id, (const uint8_t*)payload, strlen(payload));
+}
+
+bool mqtt_publish(TopicId id, const uint8_t* payload, size_t length) {
+    if (length > sizeof(publishBuffer)) return false;
+    memcpy(publishBuffer, payload, length);
+    hostCounters.publishes++;
+    return true;
+}
+
+bool mqtt_publish_json(TopicId id, const JsonDocument& doc, bool pretty) {
+    size_t length = pretty ? serializeJsonPretty(doc, (char*)publishBuffer, sizeof(publishBuffer))
+                           : serializeJson(doc, (char*)publishBuffer, sizeof(publishBuffer));
+    hostCounters.publishes++;
+    return length > 0;
+}
+
+bool mqtt_is_connected() {
+    return true;
+}
+
+// ---- Persistencia y resto de tareas ----
+bool relay_state_store_load(RelayStateSnapshot &snapshot) {
+    return false;
+}
+
+void relay_state_store_start() {
+}
+
+void relay_state_store_request_save(const RelayStateSnapshot &snapshot) {
+}
+
+#if !HOST_RTOS   // Con HOST_RTOS se enlaza la tarea de control de verdad
+void control_dispatcher_request_scene(Scenario scenario, ActuationSource source) {
+    hostCounters.sceneRequests++;
+}
+
+// Sin tarea de control: la prueba que quiera el efecto aplica hostRequestedFan
+void control_dispatcher_request_fan(LightCommand command, ActuationSource source) {
+    hostCounters.fanRequests++;
+    hostRequestedFan = command;
+}
+#endif
+
+void device_state_set(StateField field, int32_t value) {
+}
+
+void device_state_set_text(StateField field, const char* text) {
+}
+
+void relay_usage_record(uint8_t target, bool on, ActuationSource source) {
+}
+
+void audit_log_record(ActuationSource source, uint8_t target, bool state) {
+}
+
+WifiConnectStats wifi_get_connect_stats() {
+    WifiConnectStats stats = {1830, 412, 3, true};
+    return stats;
+}
@@ -0,0 +1,19 @@
+// test/host/host_stubs.h
+#ifndef HOST_STUBS_H
+#define HOST_STUBS_H
+
+#include <Arduino.h>
+#include "light_controller.h"
+
+// Lo que los sustitutos de host_stubs.cpp han visto pasar
+struct HostCounters {
+    uint32_t relayWrites;      // digitalWrite
+    uint32_t publishes;        // mqtt_publish / mqtt_publish_json
+    uint32_t sceneRequests;    // control_dispatcher_request_scene
+    uint32_t fanRequests;      // control_dispatcher_request_fan
+};
+
+extern HostCounters hostCounters;
+extern LightCommand hostRequestedFan;   // Última control_dispatcher_request_fan sin aplicar
+
+#endif // HOST_STUBS_H
@@ -0,0 +1,99 @@
+// test/host/stubs/Arduino.h
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+// ============================
+// Arduino mínimo para compilar módulos del firmware en el PC (g++)
+// ============================
+// Solo lo que usan los módulos que enlazan las pruebas de test/host. El
+// puerto serie formatea igual que en el ESP32 pero descarta la salida salvo
+// con host_serial_echo = true.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <strings.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <math.h>
+
+typedef uint8_t byte;
+
+#define HIGH    1
+#define LOW     0
+#define INPUT   0
+#define OUTPUT  1
+
+extern bool host_serial_echo;
+
+class Print {
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t* buffer, size_t size) {
+        for (size_t i = 0; i < size; i++) write(buffer[i]);
+        return size;
+    }
+    size_t write(const char* text) { return write((const uint8_t*)text, strlen(text)); }
+    size_t print(const char* text) { return write(text); }
+    size_t print(long value) { return printf("%ld", value); }
+    size_t println(const char* text = "") { return write(text) + write("\n"); }
+    size_t println(long value) { return printf("%ld\n", value); }
+    size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3))) {
+        char line[256];
+        va_list args;
+        va_start(args, format);
+        int length = vsnprintf(line, sizeof(line), format, args);
+        va_end(args);
+        if (length < 0) return 0;
+        if ((size_t)length >= sizeof(line)) length = sizeof(line) - 1;
+        return write((const uint8_t*)line, length);
+    }
+};
+
+class HostSerial : public Print {
+public:
+    void begin(unsigned long) {}
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t* buffer, size_t size) override {
+        if (host_serial_echo) fwrite(buffer, 1, size, stdout);
+        return size;
+    }
+    using Print::write;
+};
+
+extern HostSerial Serial;
+
+// Reloj del PC (monótono); host_advance_ms() lo adelanta para simular tiempo
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void host_advance_ms(unsigned long ms);
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+
+struct EspClass {
+    uint32_t getHeapSize()    { return 327680; }
+    uint32_t getFreeHeap()    { return 180000; }
+    uint32_t getMinFreeHeap() { return 170000; }
+    uint32_t getMaxAllocHeap() { return 110000; }
+};
+extern EspClass ESP;
+
+#if HOST_RTOS
+// FreeRTOS con hilos: tarea de control y UDP de verdad (host_rtos.cpp)
+#include "freertos_host.h"
+#else
+// FreeRTOS: solo los avisos entre tareas (no hay otras tareas en el PC)
+typedef void* TaskHandle_t;
+static inline void xTaskNotifyGive(TaskHandle_t task) {}
+
+#define portMUX_TYPE                  int
+#define portMUX_INITIALIZER_UNLOCKED  0
+#define portENTER_CRITICAL(mux)       ((void)(mux))
+#define portEXIT_CRITICAL(mux)        ((void)(mux))
+#endif
+
+#endif // HOST_ARDUINO_H
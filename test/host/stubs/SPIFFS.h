@@ -0,0 +1,15 @@
+// test/host/stubs/SPIFFS.h
+#ifndef HOST_SPIFFS_H
+#define HOST_SPIFFS_H
+
+#include <Arduino.h>
+
+// Sistema de ficheros montado con ocupación fija (solo para los informes de memoria)
+struct HostSpiffs {
+    bool begin(bool formatOnFail = false) { return true; }
+    size_t totalBytes() { return 1378241; }
+    size_t usedBytes()  { return 251; }
+};
+extern HostSpiffs SPIFFS;
+
+#endif // HOST_SPIFFS_H
@@ -0,0 +1,8 @@
+// test/host/stubs/WiFi.h
+#ifndef HOST_WIFI_H
+#define HOST_WIFI_H
+
+// wifi_manager.h solo necesita los tipos de Arduino en el PC
+#include <Arduino.h>
+
+#endif // HOST_WIFI_H
@@ -0,0 +1,52 @@
+// test/host/stubs/esp_adc_cal.h
+#ifndef HOST_ESP_ADC_CAL_H
+#define HOST_ESP_ADC_CAL_H
+
+#include <stdint.h>
+
+// ============================
+// Caracterización del ADC1 (modelo para el PC)
+// ============================
+// Sustituye a la de ESP-IDF con una curva fija del rango de 11 dB: recta con
+// offset (≈142 mV en 0 cuentas, ≈0,8 mV por cuenta, escalada por Vref) y la
+// compresión de la parte alta del rango a partir de ~2,6 V. No son las tablas
+// de IDF, pero tiene su forma: offset, pendiente y curvatura arriba.
+// host_adc_millivolts() da la tensión exacta (double) para comparar con ella.
+
+typedef enum { ADC_UNIT_1 = 1 } adc_unit_t;
+typedef enum { ADC_ATTEN_DB_11 = 3 } adc_atten_t;
+typedef enum { ADC_WIDTH_BIT_12 = 3 } adc_bits_width_t;
+
+typedef enum {
+    ESP_ADC_CAL_VAL_EFUSE_VREF = 0,
+    ESP_ADC_CAL_VAL_EFUSE_TP,
+    ESP_ADC_CAL_VAL_DEFAULT_VREF
+} esp_adc_cal_value_t;
+
+typedef struct {
+    uint32_t vref;
+} esp_adc_cal_characteristics_t;
+
+#define HOST_ADC_BEND_RAW  3000     // A partir de aquí la curva se comprime
+
+static inline double host_adc_millivolts(uint32_t raw, uint32_t vref) {
+    double mv = 142.0 + 0.79 * raw;
+    if (raw > HOST_ADC_BEND_RAW) {
+        double over = raw - HOST_ADC_BEND_RAW;
+        mv -= over * over * 0.00018;
+    }
+    return mv * vref / 1100.0;
+}
+
+static inline esp_adc_cal_value_t esp_adc_cal_characterize(adc_unit_t unit, adc_atten_t atten, adc_bits_width_t width,
+                                                           uint32_t defaultVref, esp_adc_cal_characteristics_t* chars) {
+    chars->vref = defaultVref;
+    return ESP_ADC_CAL_VAL_DEFAULT_VREF;
+}
+
+// Como en IDF: mV enteros
+static inline uint32_t esp_adc_cal_raw_to_voltage(uint32_t raw, const esp_adc_cal_characteristics_t* chars) {
+    return (uint32_t)(host_adc_millivolts(raw, chars->vref) + 0.5);
+}
+
+#endif // HOST_ESP_ADC_CAL_H
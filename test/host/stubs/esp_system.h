@@ -0,0 +1,19 @@
+// test/host/stubs/esp_system.h
+#ifndef HOST_ESP_SYSTEM_H
+#define HOST_ESP_SYSTEM_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+// Generador del hardware: en el PC, /dev/urandom
+static inline uint32_t esp_random() {
+    uint32_t value = 0;
+    FILE* source = fopen("/dev/urandom", "rb");
+    if (source != NULL) {
+        if (fread(&value, sizeof(value), 1, source) != 1) value = 0;
+        fclose(source);
+    }
+    return value;
+}
+
+#endif // HOST_ESP_SYSTEM_H
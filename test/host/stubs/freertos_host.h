@@ -0,0 +1,66 @@
+// test/host/stubs/freertos_host.h
+#ifndef HOST_FREERTOS_H
+#define HOST_FREERTOS_H
+
+// ============================
+// FreeRTOS sobre hilos POSIX (solo con HOST_RTOS = 1)
+// ============================
+// Lo que usan la tarea de control y la de UDP: tareas con su notificación,
+// colas estáticas, mutex y secciones críticas. Un tick es 1 ms de reloj real
+// (host_advance_ms no adelanta los ticks). Lo implementa host_rtos.cpp.
+
+#include <stdint.h>
+#include <pthread.h>
+
+typedef uint32_t TickType_t;
+typedef int32_t BaseType_t;
+typedef uint32_t UBaseType_t;
+typedef void (*TaskFunction_t)(void*);
+typedef void* TaskHandle_t;
+
+#define pdTRUE             1
+#define pdFALSE            0
+#define pdPASS             pdTRUE
+#define portMAX_DELAY      0xFFFFFFFFUL
+#define pdMS_TO_TICKS(ms)  ((TickType_t)(ms))
+
+// ---- Tareas ----
+TaskHandle_t xTaskGetCurrentTaskHandle();
+TickType_t xTaskGetTickCount();
+void vTaskDelay(TickType_t ticks);
+void xTaskNotifyGive(TaskHandle_t task);
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticks);
+
+// ---- Colas (copia por valor, FIFO) ----
+struct HostQueue {
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    uint8_t* storage;
+    UBaseType_t itemSize;
+    UBaseType_t length;
+    UBaseType_t head;
+    UBaseType_t count;
+};
+typedef HostQueue StaticQueue_t;
+typedef HostQueue* QueueHandle_t;
+
+QueueHandle_t xQueueCreateStatic(UBaseType_t length, UBaseType_t itemSize, uint8_t* storage, StaticQueue_t* buffer);
+BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t ticks);
+BaseType_t xQueueReceive(QueueHandle_t queue, void* item, TickType_t ticks);
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue);
+
+// ---- Mutex ----
+typedef pthread_mutex_t StaticSemaphore_t;
+typedef pthread_mutex_t* SemaphoreHandle_t;
+
+SemaphoreHandle_t xSemaphoreCreateMutexStatic(StaticSemaphore_t* buffer);
+BaseType_t xSemaphoreTake(SemaphoreHandle_t mutex, TickType_t ticks);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t mutex);
+
+// ---- Secciones críticas: un mutex por portMUX ----
+#define portMUX_TYPE                  pthread_mutex_t
+#define portMUX_INITIALIZER_UNLOCKED  PTHREAD_MUTEX_INITIALIZER
+#define portENTER_CRITICAL(mux)       pthread_mutex_lock(mux)
+#define portEXIT_CRITICAL(mux)        pthread_mutex_unlock(mux)
+
+#endif // HOST_FREERTOS_H
@@ -0,0 +1,11 @@
+// test/host/stubs/lwip/sockets.h
+#ifndef HOST_LWIP_SOCKETS_H
+#define HOST_LWIP_SOCKETS_H
+
+// Sockets de lwIP: en el PC, los de POSIX (misma API BSD)
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+#endif // HOST_LWIP_SOCKETS_H
@@ -0,0 +1,26 @@
+// test/host/stubs/mbedtls/md.h
+#ifndef HOST_MBEDTLS_MD_H
+#define HOST_MBEDTLS_MD_H
+
+#include <stddef.h>
+
+// ============================
+// mbedtls_md mínimo: solo HMAC-SHA256 (host_mbedtls.cpp)
+// ============================
+
+typedef enum {
+    MBEDTLS_MD_NONE = 0,
+    MBEDTLS_MD_SHA256 = 6
+} mbedtls_md_type_t;
+
+struct mbedtls_md_info_t {
+    mbedtls_md_type_t type;
+};
+
+const mbedtls_md_info_t* mbedtls_md_info_from_type(mbedtls_md_type_t type);
+
+// 0 = correcto; output recibe 32 bytes
+int mbedtls_md_hmac(const mbedtls_md_info_t* info, const unsigned char* key, size_t keyLength,
+                    const unsigned char* input, size_t inputLength, unsigned char* output);
+
+#endif // HOST_MBEDTLS_MD_H
@@ -0,0 +1,98 @@
+// test/host/test_adaptive_sampling.cpp
+// El muestreo adaptativo frente al ruido del ADC: una señal plana con ruido
+// de lectura no debe activar el canal, un cambio real sí, y al volver a estar
+// plana el canal debe bajar hasta su intervalo máximo. El ruido es
+// pseudoaleatorio con semilla fija (mismo resultado en cada ejecución).
+#include <Arduino.h>
+#include "adaptive_sampling.h"
+#include "config.h"
+
+#define NOISE_COUNTS   8          // ± cuentas por lectura (peor caso esperado)
+#define MV_PER_COUNT_X100  81     // 3300 mV / 4095 cuentas, atenuación 11 dB
+
+static uint32_t rng = 12345;
+
+static int32_t noise_counts() {
+    rng = rng * 1103515245UL + 12345;
+    return (int32_t)((rng >> 16) % (2 * NOISE_COUNTS + 1)) - NOISE_COUNTS;
+}
+
+// Valor del canal para una señal "level" más el ruido de una lectura
+static int16_t reading(SensorChannel channel, int32_t level) {
+    if (channel == SENSOR_CHANNEL_TEMPERATURE) {
+        // LM35: 10 mV/°C -> 1 mV = 10 centésimas de °C
+        return (int16_t)(level + noise_counts() * MV_PER_COUNT_X100 / 10);
+    }
+    return (int16_t)(level + noise_counts());
+}
+
+struct Phase {
+    uint32_t samples;
+    uint32_t activeSamples;
+    uint32_t lastInterval;
+};
+
+// Muestrea al ritmo que pide el propio canal
+static Phase run(SensorChannel channel, uint32_t &nowMs, uint32_t durationMs,
+                 int32_t fromLevel, int32_t toLevel) {
+    Phase phase = {0, 0, 0};
+    uint32_t start = nowMs;
+    while (nowMs - start < durationMs) {
+        int32_t level = fromLevel + (int32_t)((int64_t)(toLevel - fromLevel) * (nowMs - start) / durationMs);
+        phase.lastInterval = adaptive_sampling_update(channel, nowMs, reading(channel, level), 0);
+        if (adaptive_sampling_get(channel).active) phase.activeSamples++;
+        phase.samples++;
+        nowMs += phase.lastInterval;
+    }
+    return phase;
+}
+
+static int check(const char* name, bool ok, const Phase &phase) {
+    printf("{\"case\":\"%s\",\"samples\":%u,\"active\":%u,\"interval_ms\":%u,\"result\":\"%s\"}\n",
+           name, (unsigned)phase.samples, (unsigned)phase.activeSamples, (unsigned)phase.lastInterval,
+           ok ? "pass" : "fail");
+    return ok ? 0 : 1;
+}
+
+static int test_channel(SensorChannel channel, const char* label, int32_t level, int32_t step,
+                        uint32_t rampMs, uint32_t maxMs) {
+    char name[48];
+    uint32_t now = 0;
+    int failures = 0;
+
+    // Arranque: la media se asienta; no se comprueba
+    run(channel, now, 60000, level, level);
+
+    Phase flat = run(channel, now, 3600000, level, level);
+    snprintf(name, sizeof(name), "%s_noise_only", label);
+    failures += check(name, flat.activeSamples == 0 && flat.lastInterval == maxMs, flat);
+
+    // Un cambio real se detecta como muy tarde en la muestra siguiente (un intervalo máximo)
+    Phase ramp = run(channel, now, rampMs, level, level + step);
+    Phase hold = run(channel, now, maxMs, level + step, level + step);
+    ramp.samples += hold.samples;
+    ramp.activeSamples += hold.activeSamples;
+    ramp.lastInterval = hold.lastInterval;
+    snprintf(name, sizeof(name), "%s_real_change", label);
+    failures += check(name, ramp.activeSamples > 0, ramp);
+
+    // Tras el cambio, plana otra vez: en 5 min debe haber vuelto al máximo
+    Phase settle = run(channel, now, 300000, level + step, level + step);
+    snprintf(name, sizeof(name), "%s_backs_off", label);
+    failures += check(name, settle.lastInterval == maxMs && !adaptive_sampling_get(channel).active, settle);
+    return failures;
+}
+
+int main() {
+    adaptive_sampling_init();
+
+    int failures = 0;
+    // 25 °C; sube 3 °C en 20 s (puerta abierta, equipo encendido)
+    failures += test_channel(SENSOR_CHANNEL_TEMPERATURE, "temperature", 2500, 300, 20000, TEMP_SAMPLE_MAX_MS);
+    // Sala a media luz; se encienden las luces (+1500 cuentas en 2 s)
+    failures += test_channel(SENSOR_CHANNEL_LDR, "ldr", 1800, 1500, 2000, LDR_SAMPLE_MAX_MS);
+
+    printf("{\"test\":\"adaptive_sampling\",\"noise_counts\":%d,\"failures\":%d,\"result\":\"%s\"}\n",
+           NOISE_COUNTS, failures, failures == 0 ? "pass" : "fail");
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,153 @@
+// test/host/test_alloc_day.cpp
+// Un día simulado de los bucles de control y telemetría sin tocar el heap:
+// comandos JSON y binarios, escenas, automatización y los informes de wifi,
+// memoria, luces y ventilador, al ritmo del firmware. malloc/calloc/realloc se
+// sustituyen por versiones que cuentan; tras la primera hora (arranque de
+// ArduinoJson, stdio) el contador no debe moverse.
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "light_controller.h"
+#include "binary_command.h"
+#include "json_formatter.h"
+#include "mqtt_client.h"
+#include "topics.h"
+#include "host_stubs.h"
+
+#define SIM_SECONDS         86400
+#define WARMUP_SECONDS      3600
+#define COMMAND_EVERY_S     10
+#define TELEMETRY_EVERY_S   5
+#define SCENE_EVERY_S       900
+
+// ---- Recuento de reservas (sustituye a las de glibc en todo el programa) ----
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+}
+
+static bool counting = false;
+static uint32_t allocations = 0;
+
+extern "C" void* malloc(size_t size) {
+    if (counting) allocations++;
+    return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t count, size_t size) {
+    if (counting) allocations++;
+    return __libc_calloc(count, size);
+}
+
+extern "C" void* realloc(void* ptr, size_t size) {
+    if (counting) allocations++;
+    return __libc_realloc(ptr, size);
+}
+
+// ---- Tráfico ----
+struct TextCommand {
+    TopicId topic;
+    const char* json;
+};
+
+static const TextCommand COMMANDS[] = {
+    { TOPIC_LIGHT_1_SET,   "{\"command\":\"ON\"}" },
+    { TOPIC_LIGHT_2_SET,   "{\"command\":\"TOGGLE\"}" },
+    { TOPIC_LIGHT_3_SET,   "{\"command\":\"off\"}" },
+    { TOPIC_LIGHT_ALL_SET, "{\"command\":\"ON\"}" },
+    { TOPIC_FAN_SET,       "{\"command\":\"ON\"}" },
+    { TOPIC_LIGHT_ALL_SET, "{\"command\":\"OFF\"}" },
+    { TOPIC_FAN_SET,       "{\"command\":\"OFF\"}" },
+    { TOPIC_LIGHT_4_SET,   "{\"command\":\"TOGGLE\",\"source\":\"dashboard\"}" },
+};
+#define COMMAND_COUNT  (sizeof(COMMANDS) / sizeof(COMMANDS[0]))
+
+static const BinaryCommand BINARY_COMMANDS[] = {
+    { BIN_OP_ZONES_ON,     0x03, BIN_FAN_UNCHANGED, 1 },
+    { BIN_OP_ZONES_TOGGLE, 0x0C, BIN_FAN_UNCHANGED, 2 },
+    { BIN_OP_SET_MASK,     0x05, BIN_FAN_ON,        3 },
+    { BIN_OP_ZONES_OFF,    0x0F, BIN_FAN_UNCHANGED, 4 },
+};
+#define BINARY_COUNT  (sizeof(BINARY_COMMANDS) / sizeof(BINARY_COMMANDS[0]))
+
+// La tarea de control copia cada payload a su mensaje antes de atenderlo
+static void run_command(uint32_t second) {
+    static uint8_t payload[CONTROL_PAYLOAD_MAX];
+    uint32_t index = second / COMMAND_EVERY_S;
+
+    if (index % 3 == 2) {
+        BinaryCommand command = BINARY_COMMANDS[index % BINARY_COUNT];
+        command.seq = (uint16_t)index;
+        binary_command_encode(command, payload);
+        handle_binary_command(payload, BINARY_COMMAND_SIZE);
+    } else {
+        const TextCommand &command = COMMANDS[index % COMMAND_COUNT];
+        size_t length = strlen(command.json);
+        memcpy(payload, command.json, length);
+        handle_light_message(command.topic, payload, length);
+    }
+}
+
+// Escena completa, con el reloj avanzando lo que pide cada paso
+static void run_scene(uint32_t second) {
+    static const Scenario SCENES[] = { SCENARIO_STAGE_ONLY, SCENARIO_HALLWAYS_ONLY, SCENARIO_ALL_ON, SCENARIO_EMERGENCY };
+    scene_start(SCENES[(second / SCENE_EVERY_S) % 4], ACTUATION_SCENE);
+    uint32_t wait;
+    while ((wait = scene_run_due()) != SCENE_IDLE) host_advance_ms(wait);
+}
+
+// Temperatura y luz recorren el día: la automatización cruza sus umbrales
+static void run_automation(uint32_t second) {
+    uint32_t phase = second % 86400;
+    int32_t swing = phase < 43200 ? (int32_t)phase : (int32_t)(86400 - phase);   // 0 .. 43200
+    check_temperature_automation(16000 + swing * 16000 / 43200);                  // 16 .. 32 °C
+    check_ldr_automation(200 + swing * 3600 / 43200);
+
+    // La orden del ventilador la aplica la tarea de control
+    if (hostRequestedFan != LIGHT_CMD_NONE) {
+        apply_fan_command(hostRequestedFan, ACTUATION_AUTOMATION);
+        publish_fan_status();
+        hostRequestedFan = LIGHT_CMD_NONE;
+    }
+}
+
+static void run_telemetry(const WifiSnapshot &wifi) {
+    StaticJsonDocument<384> wifiDoc;
+    generate_wifi_json(wifi, wifiDoc);
+    mqtt_publish_json(TOPIC_WIFI_STATUS, wifiDoc, true);
+
+    StaticJsonDocument<512> memoryDoc;
+    generate_memory_json(memoryDoc);
+    mqtt_publish_json(TOPIC_SYSTEM_MEMORY, memoryDoc, true);
+
+    publish_all_lights_status();
+    publish_fan_status();
+}
+
+static void simulate_second(uint32_t second, const WifiSnapshot &wifi) {
+    if (second % COMMAND_EVERY_S == 0) run_command(second);
+    if (second % SCENE_EVERY_S == SCENE_EVERY_S / 2) run_scene(second);
+    if (second % (AUTOMATION_CHECK_INTERVAL / 1000) == 0) run_automation(second);
+    if (second % TELEMETRY_EVERY_S == 0) run_telemetry(wifi);
+    host_advance_ms(1000);
+}
+
+int main() {
+    WifiSnapshot wifi = { true, "auditorio", "192.168.1.40", "24:6F:28:AA:BB:CC", -61, 3 };
+    printf("{\"case\":\"simulated_day\",\"start\":true}\n");   // stdio reserva su buffer aquí
+
+    light_controller_setup();
+
+    counting = true;
+    for (uint32_t s = 0; s < WARMUP_SECONDS; s++) simulate_second(s, wifi);
+    uint32_t warmup = allocations;
+    for (uint32_t s = WARMUP_SECONDS; s < SIM_SECONDS; s++) simulate_second(s, wifi);
+    counting = false;
+
+    uint32_t steady = allocations - warmup;
+    printf("{\"case\":\"simulated_day\",\"sim_s\":%u,\"relay_writes\":%u,\"publishes\":%u,"
+           "\"allocs_first_hour\":%u,\"allocs_after\":%u,\"result\":\"%s\"}\n",
+           (unsigned)SIM_SECONDS, (unsigned)hostCounters.relayWrites, (unsigned)hostCounters.publishes,
+           (unsigned)warmup, (unsigned)steady, steady == 0 ? "pass" : "fail");
+    return steady == 0 ? 0 : 1;
+}
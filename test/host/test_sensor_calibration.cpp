@@ -0,0 +1,97 @@
+// test/host/test_sensor_calibration.cpp
+// Tablas de conversión de sensor_calibration frente a las curvas de referencia
+// calculadas en double para cada una de las 4096 cuentas, con la misma
+// caracterización del ADC (stubs/esp_adc_cal.h), y coste por muestra.
+//   Temperatura: LM35, error máximo en m°C.
+//   LDR: error relativo donde la referencia está entre LUX_CHECK_MIN y
+//   LDR_LUX_MAX; por debajo, el absoluto (el 2 % de 5 lux no llega a 1 lux
+//   y el resultado es entero).
+#include <Arduino.h>
+#include <esp_adc_cal.h>
+#include "sensor_calibration.h"
+#include "config.h"
+#include "host_bench.h"
+
+#define TEMP_MAX_ERROR_MC      100     // ~1 cuenta del ADC de señal del LM35
+#define LUX_CHECK_MIN          50      // Por debajo se mira el error absoluto
+#define LUX_MAX_ERROR_PCT      2.0
+#define LUX_MAX_ERROR_ABS      1.0     // lux, por debajo de LUX_CHECK_MIN
+#define MAX_NS_PER_SAMPLE      20.0    // Holgado: una búsqueda y una interpolación
+#define BATCH                  (ADC_MAX_VALUE + 1)
+
+static volatile int32_t sink = 0;
+
+static double reference_millicelsius(double millivolts) {
+    return millivolts * 1000.0 / TEMP_SENSOR_MV_PER_C;
+}
+
+static double reference_lux(double millivolts) {
+    if (millivolts >= LDR_SUPPLY_MV) return 0;
+    if (millivolts <= 0) return LDR_LUX_MAX;
+    double ohms = (double)LDR_FIXED_RESISTOR_OHMS * millivolts / (LDR_SUPPLY_MV - millivolts);
+    double lux = 10.0 * pow((double)LDR_R10_OHMS / ohms, 100.0 / LDR_GAMMA_X100);
+    return lux > LDR_LUX_MAX ? LDR_LUX_MAX : lux;
+}
+
+static bool report(const char* name, const char* unit, double maxError, uint32_t worstRaw, double limit, double ns) {
+    bool ok = maxError <= limit;
+    printf("{\"case\":\"%s\",\"max_error_%s\":%.2f,\"worst_raw\":%u,\"limit\":%.2f,\"ns_per_sample\":%.1f,\"result\":\"%s\"}\n",
+           name, unit, maxError, (unsigned)worstRaw, limit, ns, ok && ns <= MAX_NS_PER_SAMPLE ? "pass" : "fail");
+    return ok && ns <= MAX_NS_PER_SAMPLE;
+}
+
+int main() {
+    sensor_calibration_init();
+    esp_adc_cal_characteristics_t adc;
+    esp_adc_cal_characterize(ADC_UNIT_1, ADC_ATTEN_DB_11, ADC_WIDTH_BIT_12, ADC_DEFAULT_VREF_MV, &adc);
+    int failures = 0;
+
+    // ---- Temperatura ----
+    double tempError = 0;
+    uint32_t tempWorst = 0;
+    for (uint32_t raw = 0; raw <= ADC_MAX_VALUE; raw++) {
+        double error = fabs(adc_to_millicelsius(raw) - reference_millicelsius(host_adc_millivolts(raw, adc.vref)));
+        if (error > tempError) {
+            tempError = error;
+            tempWorst = raw;
+        }
+    }
+    double tempNs = host_median_ns([]() {
+        int32_t acc = 0;
+        for (uint32_t raw = 0; raw <= ADC_MAX_VALUE; raw++) acc += adc_to_millicelsius(raw);
+        sink = acc;
+    }, 20) / BATCH;
+    if (!report("temperature", "mc", tempError, tempWorst, TEMP_MAX_ERROR_MC, tempNs)) failures++;
+
+    // ---- LDR: relativo en el rango útil, absoluto en la oscuridad ----
+    double luxErrorPct = 0;
+    double luxErrorAbs = 0;
+    uint32_t luxWorstPct = 0;
+    uint32_t luxWorstAbs = 0;
+    for (uint32_t raw = 0; raw <= ADC_MAX_VALUE; raw++) {
+        double reference = reference_lux(host_adc_millivolts(raw, adc.vref));
+        if (reference >= LDR_LUX_MAX) continue;     // Saturado: la tabla recorta igual
+        double error = fabs(adc_to_lux(raw) - reference);
+        if (reference >= LUX_CHECK_MIN) {
+            double pct = error * 100.0 / reference;
+            if (pct > luxErrorPct) {
+                luxErrorPct = pct;
+                luxWorstPct = raw;
+            }
+        } else if (error > luxErrorAbs) {
+            luxErrorAbs = error;
+            luxWorstAbs = raw;
+        }
+    }
+    double luxNs = host_median_ns([]() {
+        int32_t acc = 0;
+        for (uint32_t raw = 0; raw <= ADC_MAX_VALUE; raw++) acc += adc_to_lux(raw);
+        sink = acc;
+    }, 20) / BATCH;
+    if (!report("lux", "pct", luxErrorPct, luxWorstPct, LUX_MAX_ERROR_PCT, luxNs)) failures++;
+    if (!report("lux_dark", "lux", luxErrorAbs, luxWorstAbs, LUX_MAX_ERROR_ABS, luxNs)) failures++;
+
+    printf("{\"test\":\"sensor_calibration\",\"knots\":%d,\"failures\":%d,\"result\":\"%s\"}\n",
+           (ADC_MAX_VALUE + 1) / (1 << SENSOR_LUT_SEGMENT_BITS) + 1, failures, failures == 0 ? "pass" : "fail");
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,36 @@
+// test/host/udp_control_host.cpp
+// El control UDP del firmware en el PC: udp_control, la tarea de control y
+// light_controller sobre sockets POSIX e hilos (HOST_RTOS). Escucha
+// UDP_CONTROL_PORT durante los segundos indicados y termina con una línea
+// JSON de lo que atendió; `make run` lo maneja con tools/udp_client.py.
+//
+//   udp_control_host [segundos]
+#include <Arduino.h>
+#include <unistd.h>
+#include "light_controller.h"
+#include "control_dispatcher.h"
+#include "udp_control.h"
+#include "config.h"
+
+int main(int argc, char** argv) {
+    unsigned seconds = argc > 1 ? (unsigned)atoi(argv[1]) : 10;
+    host_serial_echo = true;   // Mensajes [UDP] / [CONTROL] como en el monitor serie
+
+    light_controller_setup();
+    control_dispatcher_start();
+    udp_control_start();
+    fflush(stdout);
+
+    sleep(seconds);
+
+    UdpControlStats udp = udp_control_get_stats();
+    ControlLatencyStats control = control_dispatcher_get_stats();
+    FanState fan = get_fan_state();
+    printf("{\"case\":\"udp_control_host\",\"port\":%u,\"requests\":%lu,\"rejected\":%lu,\"ack_avg_us\":%lu,"
+           "\"ack_max_us\":%lu,\"commands\":%lu,\"dropped\":%lu,\"zones\":%u,\"fan_on\":%s}\n",
+           UDP_CONTROL_PORT, (unsigned long)udp.requests, (unsigned long)udp.rejected, (unsigned long)udp.avgUs,
+           (unsigned long)udp.maxUs, (unsigned long)control.count, (unsigned long)control.dropped,
+           get_light_mask(), fan.isOn ? "true" : "false");
+    fflush(stdout);
+    return udp.requests > 0 ? 0 : 1;
+}
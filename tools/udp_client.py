@@ -0,0 +1,182 @@
+#!/usr/bin/env python3
+# tools/udp_client.py
+# Cliente del control local por UDP (ver include/udp_control.h): firma cada
+# petición con HMAC-SHA256, adopta la sesión del dispositivo y mide la ida y
+# vuelta (envío -> confirmación recibida) de cada comando.
+#
+#   python3 tools/udp_client.py 192.168.1.40 --key "cambia-esta-clave-compartida" \
+#       --topic auditorium/lights/1/set --payload '{"command":"TOGGLE"}' --count 200
+#
+# Sin --topic solo consulta el estado. Al final escribe una línea JSON con los
+# estados recibidos y la RTT (min, mediana, p95, max en ms); termina con código
+# distinto de 0 si alguna petición se perdió o fue rechazada. La sesión es del
+# dispositivo, no del cliente: si otro cliente ya la usó, al conectar se salta
+# por encima de sus seq. Dos clientes a la vez se rechazan entre sí (replay).
+
+import argparse
+import hashlib
+import hmac
+import json
+import socket
+import struct
+import sys
+import time
+
+MAGIC = 0xC7
+VERSION = 1
+MAC_SIZE = 32
+ACK_SIZE = 16 + MAC_SIZE
+
+STATUS_NAMES = ["ok", "queued", "bad_session", "replay", "bad_topic", "rejected", "bad_format"]
+STATUS_OK, STATUS_QUEUED, STATUS_BAD_SESSION, STATUS_REPLAY = 0, 1, 2, 3
+REPLAY_WINDOW = 32   # UDP_REPLAY_WINDOW del firmware
+
+
+def build_request(key, session, seq, topic, payload):
+    header = struct.pack("<BBBBII", MAGIC, VERSION, len(topic), 0, session, seq)
+    body = header + topic + payload
+    return body + hmac.new(key, body, hashlib.sha256).digest()
+
+
+def parse_ack(key, data):
+    """Devuelve (status, mask, fan, pending, session, seq) o None si no es válida."""
+    if len(data) != ACK_SIZE or data[0] != MAGIC or data[1] != VERSION:
+        return None
+    expected = hmac.new(key, data[:16], hashlib.sha256).digest()
+    if not hmac.compare_digest(expected, data[16:]):
+        return None
+    status, mask, fan, pending = data[2], data[3], data[4], data[5]
+    session, seq = struct.unpack_from("<II", data, 8)
+    return status, mask, fan, pending, session, seq
+
+
+class Client:
+    def __init__(self, host, port, key, timeout):
+        self.address = (host, port)
+        self.key = key
+        self.session = 0
+        self.seq = 0
+        self.sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        self.sock.settimeout(timeout)
+
+    def request(self, topic=b"", payload=b""):
+        """Envía una petición y espera su confirmación. Devuelve (ack, rtt_ms) o (None, None)."""
+        self.seq += 1
+        datagram = build_request(self.key, self.session, self.seq, topic, payload)
+        start = time.perf_counter()
+        self.sock.sendto(datagram, self.address)
+
+        # Descarta confirmaciones atrasadas de peticiones anteriores
+        while True:
+            try:
+                data, _ = self.sock.recvfrom(256)
+            except socket.timeout:
+                return None, None
+            ack = parse_ack(self.key, data)
+            if ack is not None and ack[5] == self.seq:
+                return ack, (time.perf_counter() - start) * 1000.0
+
+    def adopt_session(self, ack):
+        # Sesión nueva (primer contacto o reinicio): seq vuelve a empezar
+        self.session = ack[4]
+        self.seq = 0
+
+    def connect(self, attempts=3):
+        jump = REPLAY_WINDOW
+        while attempts > 0:
+            ack, _ = self.request()
+            if ack is not None and ack[0] == STATUS_REPLAY and self.seq + jump < 2 ** 32:
+                # Otro cliente usó ya la sesión: saltos crecientes hasta pasar su seq más alta
+                self.seq += jump
+                jump *= 2
+                continue
+            attempts -= 1
+            if ack is None:
+                continue
+            if ack[0] == STATUS_BAD_SESSION:
+                self.adopt_session(ack)
+                continue
+            if ack[0] == STATUS_OK:
+                return ack
+        return None
+
+
+def percentile(sorted_values, fraction):
+    if not sorted_values:
+        return None
+    index = min(len(sorted_values) - 1, int(round(fraction * (len(sorted_values) - 1))))
+    return sorted_values[index]
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Control local por UDP: envía comandos firmados y mide la RTT")
+    parser.add_argument("host", help="IP del dispositivo")
+    parser.add_argument("--port", type=int, default=4210, help="UDP_CONTROL_PORT (4210)")
+    parser.add_argument("--key", required=True, help="UDP_CONTROL_KEY del firmware")
+    parser.add_argument("--topic", default="", help="ruta sin el prefijo, p. ej. auditorium/lights/1/set")
+    parser.add_argument("--payload", default="", help="payload JSON (o vacío para el binario con --hex)")
+    parser.add_argument("--hex", default="", help="payload en hexadecimal (trama binaria)")
+    parser.add_argument("--count", type=int, default=1, help="peticiones a enviar")
+    parser.add_argument("--interval", type=float, default=0.05, help="segundos entre peticiones")
+    parser.add_argument("--timeout", type=float, default=0.5, help="segundos de espera por confirmación")
+    args = parser.parse_args()
+
+    key = args.key.encode()
+    topic = args.topic.encode()
+    payload = bytes.fromhex(args.hex) if args.hex else args.payload.encode()
+
+    client = Client(args.host, args.port, key, args.timeout)
+    if client.connect() is None:
+        print(json.dumps({"tool": "udp_client", "error": "sin respuesta o clave distinta"}))
+        return 1
+
+    rtts = []
+    statuses = {}
+    lost = 0
+    pending = 0
+    sessions = 1
+    for i in range(args.count):
+        ack, rtt = client.request(topic, payload)
+        if ack is not None and ack[0] == STATUS_BAD_SESSION:
+            # El dispositivo se reinició: se adopta la sesión y se repite
+            client.adopt_session(ack)
+            sessions += 1
+            ack, rtt = client.request(topic, payload)
+        if ack is None:
+            lost += 1
+        else:
+            name = STATUS_NAMES[ack[0]] if ack[0] < len(STATUS_NAMES) else str(ack[0])
+            statuses[name] = statuses.get(name, 0) + 1
+            rtts.append(rtt)
+            if ack[3]:
+                pending += 1
+            if args.count == 1:
+                print(json.dumps({"status": name, "zones": ack[1], "fan_on": bool(ack[2] & 1),
+                                  "fan_auto": bool(ack[2] & 2), "pending": bool(ack[3]),
+                                  "rtt_ms": round(rtt, 2)}))
+        if i + 1 < args.count:
+            time.sleep(args.interval)
+
+    rtts.sort()
+    failed = lost + sum(n for s, n in statuses.items() if s not in ("ok", "queued"))
+    summary = {
+        "tool": "udp_client",
+        "sent": args.count,
+        "lost": lost,
+        "statuses": statuses,
+        "pending": pending,
+        "sessions": sessions,
+        "rtt_ms": {
+            "min": round(rtts[0], 2) if rtts else None,
+            "median": round(percentile(rtts, 0.5), 2) if rtts else None,
+            "p95": round(percentile(rtts, 0.95), 2) if rtts else None,
+            "max": round(rtts[-1], 2) if rtts else None,
+        },
+        "result": "pass" if failed == 0 else "fail",
+    }
+    print(json.dumps(summary))
+    return 0 if failed == 0 else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())